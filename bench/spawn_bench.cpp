@@ -0,0 +1,184 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   spawn_bench.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+    spawn_bench
+
+    Latence de lancement d'un CGI selon la mémoire résidente du serveur :
+    fork() + execve() (ancien chemin) contre posix_spawn() (CgiProcess).
+    Le process grossit par paliers (pages réellement touchées, comme des
+    caches remplis), puis lance ITER fois /bin/true avec stdin / stdout
+    sur des pipes, et attend chaque enfant.
+
+        make bench
+        ./bench/spawn_bench [iterations] [MiB ...]   (défaut : 200 0 64 256 1024)
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+namespace
+{
+	static const char *TARGET = "/bin/true";
+
+	static double nowUs()
+	{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return static_cast<double>(ts.tv_sec) * 1e6 +
+		       static_cast<double>(ts.tv_nsec) / 1e3;
+	}
+
+	static void waitChild(pid_t pid)
+	{
+		int status;
+		while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+			;
+	}
+
+	static bool launchFork(int in, int out)
+	{
+		char *argv[] = { const_cast<char *>(TARGET), 0 };
+		pid_t pid = fork();
+		if (pid < 0)
+			return false;
+		if (pid == 0)
+		{
+			dup2(in, STDIN_FILENO);
+			dup2(out, STDOUT_FILENO);
+			execve(TARGET, argv, environ);
+			_exit(127);
+		}
+		waitChild(pid);
+		return true;
+	}
+
+	static bool launchSpawn(int in, int out)
+	{
+		char *argv[] = { const_cast<char *>(TARGET), 0 };
+		posix_spawn_file_actions_t actions;
+		pid_t pid;
+
+		if (posix_spawn_file_actions_init(&actions) != 0)
+			return false;
+		posix_spawn_file_actions_adddup2(&actions, in, STDIN_FILENO);
+		posix_spawn_file_actions_adddup2(&actions, out, STDOUT_FILENO);
+		int err = posix_spawn(&pid, TARGET, &actions, NULL, argv, environ);
+		posix_spawn_file_actions_destroy(&actions);
+		if (err != 0)
+			return false;
+		waitChild(pid);
+		return true;
+	}
+
+	// Moyenne en µs par lancement (pipes recréés à chaque fois, comme un CGI)
+	static double measure(bool (*launch)(int, int), int iterations)
+	{
+		double total = 0;
+		for (int i = 0; i < iterations; ++i)
+		{
+			int inPipe[2];
+			int outPipe[2];
+			if (pipe(inPipe) < 0 || pipe(outPipe) < 0)
+			{
+				std::cerr << "pipe(): " << std::strerror(errno) << std::endl;
+				std::exit(1);
+			}
+
+			double start = nowUs();
+			if (!launch(inPipe[0], outPipe[1]))
+			{
+				std::cerr << "launch failed: " << std::strerror(errno) << std::endl;
+				std::exit(1);
+			}
+			total += nowUs() - start;
+
+			close(inPipe[0]);
+			close(inPipe[1]);
+			close(outPipe[0]);
+			close(outPipe[1]);
+		}
+		return total / iterations;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int iterations = 200;
+	std::vector<std::size_t> steps;
+
+	if (argc > 1)
+		iterations = std::atoi(argv[1]);
+	for (int i = 2; i < argc; ++i)
+		steps.push_back(static_cast<std::size_t>(std::atol(argv[i])));
+	if (iterations <= 0)
+		iterations = 200;
+	if (steps.empty())
+	{
+		steps.push_back(0);
+		steps.push_back(64);
+		steps.push_back(256);
+		steps.push_back(1024);
+	}
+
+	std::vector<char *> blocks;
+	std::size_t held = 0;
+	const std::size_t MiB = 1024 * 1024;
+
+	std::cout << "launch + wait of " << TARGET << ", " << iterations
+	          << " iterations per step\n\n"
+	          << std::setw(10) << "RSS (MiB)"
+	          << std::setw(18) << "fork+execve (us)"
+	          << std::setw(18) << "posix_spawn (us)"
+	          << std::setw(10) << "ratio" << "\n";
+
+	for (std::size_t s = 0; s < steps.size(); ++s)
+	{
+		// Mémoire réellement résidente : chaque page est écrite
+		while (held < steps[s])
+		{
+			char *block = static_cast<char *>(std::malloc(MiB));
+			if (!block)
+			{
+				std::cerr << "out of memory at " << held << " MiB" << std::endl;
+				return 1;
+			}
+			std::memset(block, 1, MiB);
+			blocks.push_back(block);
+			++held;
+		}
+
+		double forkUs = measure(&launchFork, iterations);
+		double spawnUs = measure(&launchSpawn, iterations);
+
+		std::cout << std::setw(10) << held
+		          << std::setw(18) << std::fixed << std::setprecision(1) << forkUs
+		          << std::setw(18) << spawnUs
+		          << std::setw(9) << std::setprecision(2) << forkUs / spawnUs << "x"
+		          << "\n" << std::flush;
+	}
+
+	for (std::size_t i = 0; i < blocks.size(); ++i)
+		std::free(blocks[i]);
+	return 0;
+}
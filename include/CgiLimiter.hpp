@@ -0,0 +1,130 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CgiLimiter.hpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef CGILIMITER_HPP
+# define CGILIMITER_HPP
+
+# include <deque>
+# include <vector>
+# include <cstddef>
+
+# include "Mutex.hpp"
+
+struct CgiJob;
+class WebServer;
+
+/*
+    CgiCounters
+
+    Compteurs d'une location cgi pour tout le process (tous les reactors),
+    lus par la page cgi_status. Mis à jour par __sync_* : pas de lock.
+*/
+struct CgiCounters
+{
+	volatile long running;    // scripts lancés, pas encore terminés
+	volatile long queued;     // requêtes dans une file d'admission
+	volatile long started;    // scripts lancés depuis le démarrage
+	volatile long rejected;   // 503 : file pleine
+	volatile long timedOut;   // 503 : trop longtemps dans la file
+
+	CgiCounters();
+
+	static void add(volatile long &counter, long delta);
+	static long get(volatile long &counter);
+};
+
+/*
+    CgiLimiter
+
+    Admission des scripts d'une location cgi pour tout le process
+    (cgi_max_concurrency, cgi_queue_size, cgi_queue_timeout) :
+
+      - au plus max scripts en cours (0 : illimité) ; au-delà, la requête
+        attend son tour dans une file FIFO bornée ;
+      - file pleine, ou attente plus longue que cgi_queue_timeout : 503
+        avec Retry-After (voir retryAfter()) ;
+      - worker_threads N : un seul limiter par location, partagé par les
+        reactors sous lock. Chaque requête en file garde sa boucle
+        (owner) : elle seule touche au job. Une place libérée par un
+        reactor admet la tête de file, quelle que soit sa boucle ;
+        l'appelant réveille alors cette boucle, qui lance le script
+        (takeAdmitted()).
+
+    Les échéances de la file sont lues par boucle (nextDeadline(),
+    expire()) : toutes les requêtes attendent le même temps, la
+    première d'une boucle expire avant ses suivantes.
+*/
+
+class CgiLimiter
+{
+public:
+	enum Admission
+	{
+		RUN,      // place libre : le script part (compté en cours)
+		QUEUED,   // en file, lancé par sa boucle une fois admis
+		FULL      // file pleine : refusé (compté)
+	};
+
+	CgiLimiter(std::size_t maxRunning, std::size_t queueSize,
+	           unsigned long queueTimeoutMs, CgiCounters *counters);
+	~CgiLimiter();
+
+	// Toutes les places sont prises et la file est pleine (lecture sans
+	// garantie : le verdict est celui de enter()).
+	bool saturated();
+	void reject();
+
+	Admission enter(CgiJob *job, WebServer *owner, unsigned long now);
+
+	// Un script admis est terminé (ou n'a pas pu être lancé) ; la tête
+	// de file prend la place : sa boucle est rendue (à réveiller), sinon
+	// NULL.
+	WebServer *finished();
+	// Job détruit avant son lancement (en file, ou admis mais pas encore
+	// repris) ; même retour que finished() si sa place est rendue.
+	WebServer *remove(CgiJob *job);
+
+	// Jobs de owner admis depuis la file : ils partent (déjà comptés).
+	void takeAdmitted(WebServer *owner, std::vector<CgiJob *> &out);
+	// Premier job de owner en file depuis trop longtemps (retiré et
+	// compté), sinon NULL.
+	CgiJob *expire(WebServer *owner, unsigned long now);
+	// Échéance du premier job de owner en file (0 s'il n'y en a pas).
+	unsigned long nextDeadline(WebServer *owner);
+
+	// Secondes conseillées au client refusé.
+	unsigned long retryAfter() const;
+
+private:
+	CgiLimiter(const CgiLimiter &);
+	CgiLimiter &operator=(const CgiLimiter &);
+
+	struct Waiting
+	{
+		CgiJob        *job;
+		WebServer     *owner;
+		unsigned long  deadline;
+	};
+
+	WebServer *admitHead();
+
+	std::size_t         _maxRunning;
+	std::size_t         _queueSize;
+	unsigned long       _queueTimeout;  // ms
+	Mutex               _mutex;         // tout ce qui suit
+	std::size_t         _running;       // admis compris
+	std::deque<Waiting> _queue;
+	std::vector<Waiting> _admitted;     // admis, pas encore repris
+	CgiCounters        *_counters;
+};
+
+#endif // CGILIMITER_HPP
@@ -0,0 +1,72 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CgiOutput.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef CGIOUTPUT_HPP
+# define CGIOUTPUT_HPP
+
+# include <string>
+# include <map>
+# include <cstddef>
+
+/*
+    CgiOutput
+
+    Sortie d'un programme CGI en cours de lecture, quelle que soit sa
+    source : script lancé en local (CgiProcess) ou application FastCGI
+    (FastCgiRequest). La classe dérivée remplit _output et passe _eof à
+    true à la fin ; la boucle n'utilise que cette interface pour
+    streamer ou construire la réponse :
+
+      - parseHeaders() extrait le bloc de headers CGI (Status:,
+        Content-Type:...) dès qu'il est complet, puis takeOutput() rend
+        le body au fur et à mesure ;
+      - parseOutput() découpe d'un coup une sortie déjà complète.
+*/
+
+class CgiOutput
+{
+public:
+	typedef std::map<std::string, std::string> HeaderMap;
+
+	CgiOutput();
+	virtual ~CgiOutput();
+
+	bool outputDone() const;
+	std::size_t buffered() const;
+
+	// Bloc de headers complet en tête du buffer : il est retiré et
+	// parsé (status 200 par défaut). false s'il n'est pas encore arrivé.
+	bool parseHeaders(int &status, std::string &reason, HeaderMap &headers);
+	// Octets de body lus jusqu'ici (le buffer est vidé par swap).
+	void takeOutput(std::string &out);
+
+	// Le programme s'est terminé normalement (sinon le motif est loggé).
+	virtual bool succeeded() const = 0;
+
+	// Sortie complète d'un programme terminé normalement : status,
+	// headers et body (la sortie est reprise par swap). false sinon.
+	bool parseOutput(int &status, std::string &reason,
+	                 HeaderMap &headers, std::string &body);
+
+	const std::string &scriptPath() const;
+
+protected:
+	std::string _output;      // stdout accumulé
+	bool        _eof;
+	std::string _scriptPath;
+
+private:
+	CgiOutput(const CgiOutput &);
+	CgiOutput &operator=(const CgiOutput &);
+};
+
+#endif // CGIOUTPUT_HPP
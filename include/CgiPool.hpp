@@ -0,0 +1,101 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CgiPool.hpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef CGIPOOL_HPP
+# define CGIPOOL_HPP
+
+# include <string>
+# include <vector>
+# include <deque>
+# include <cstddef>
+# include <sys/types.h> // pid_t
+
+# include "FastCgiConnection.hpp"
+
+struct CgiJob;
+
+/*
+    CgiPool
+
+    Interpréteurs lancés d'avance pour une location "cgi" (cgi_pool N) :
+    chaque worker exécute le runner (cgi_pool_runner) avec l'interpréteur
+    de la location et sert les scripts les uns après les autres, sans
+    fork + execve + imports à chaque requête.
+
+      - canal : une socketpair passée au worker en fd 0, sur laquelle
+        circulent des records FastCGI (FastCgiConnection::adopt()) : la
+        boucle les lit comme une connexion fastcgi_pass ;
+      - un worker ne sert qu'une requête à la fois : au plus N scripts
+        tournent en même temps, les requêtes suivantes attendent dans la
+        file (FIFO) qu'un worker se libère ;
+      - recyclage : après cgi_pool_max_requests requêtes, ou quand le
+        worker meurt, dépasse le timeout CGI ou perd son client en cours
+        de script (il est alors tué, le script ne peut pas être arrêté
+        autrement).
+
+    Un pool par location et par boucle d'événements (reactor) : pas de
+    lock. Le destructeur tue et réape les workers restants.
+*/
+
+class CgiPool
+{
+public:
+	CgiPool(const std::string &interpreter, const std::string &runner,
+	        std::size_t size, std::size_t maxRequests);
+	~CgiPool();
+
+	// Nouveau worker (socketpair + fork + execve) ; NULL si échec ou si
+	// le pool est plein. L'appelant inscrit la connexion dans la boucle.
+	FastCgiConnection *spawn();
+	bool full() const;
+
+	// Worker au repos, sinon NULL.
+	FastCgiConnection *acquire();
+	// Une requête part sur conn (compte pour cgi_pool_max_requests).
+	void assign(FastCgiConnection *conn);
+	// conn a servi toutes ses requêtes : à recycler.
+	bool exhausted(FastCgiConnection *conn) const;
+	// Tue et réape le worker (l'appelant l'a retiré de la boucle). true
+	// s'il avait servi des requêtes : il vaut la peine d'être remplacé
+	// (un worker qui meurt dès son lancement ne l'est qu'à la demande).
+	bool retire(FastCgiConnection *conn);
+
+	// Requêtes en attente d'un worker.
+	void enqueue(CgiJob *job);
+	CgiJob *dequeue();         // NULL si la file est vide
+	std::size_t queued() const;
+	void remove(CgiJob *job);  // job détruit avant d'avoir été servi
+
+private:
+	CgiPool(const CgiPool &);
+	CgiPool &operator=(const CgiPool &);
+
+	struct Worker
+	{
+		FastCgiConnection *conn;
+		pid_t              pid;
+		std::size_t        served;
+	};
+
+	std::vector<Worker>::iterator findWorker(FastCgiConnection *conn);
+	static void reap(pid_t pid);
+
+	std::string          _interpreter;
+	std::string          _runner;
+	std::size_t          _size;
+	std::size_t          _maxRequests;   // 0 : illimité
+
+	std::vector<Worker>  _workers;
+	std::deque<CgiJob *> _queue;
+};
+
+#endif // CGIPOOL_HPP
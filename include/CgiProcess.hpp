@@ -0,0 +1,100 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CgiProcess.hpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef CGIPROCESS_HPP
+# define CGIPROCESS_HPP
+
+# include <string>
+# include <vector>
+# include <cstddef>
+# include <sys/types.h> // pid_t
+
+# include "CgiOutput.hpp"
+
+/*
+    CgiProcess
+
+    Un script CGI lancé (posix_spawn), piloté sans jamais bloquer par
+    la boucle d'événements :
+
+      - stdin / stdout du script sont des pipes non bloquants (et
+        close-on-exec côté serveur) ; la boucle les surveille et appelle
+        writeInput() / readOutput() quand ils sont prêts ;
+      - la fin du process est détectée par un pidfd (Linux >= 5.3),
+        lisible quand l'enfant se termine : reap() fait alors un
+        waitpid(WNOHANG). Sans pidfd, exitFd() vaut -1 et l'appelant
+        réessaie reap() plus tard (timer) ;
+      - la sortie lue est découpée par CgiOutput (headers, body).
+        readOutput() s'arrête à une limite : l'appelant ne lit pas plus
+        vite que le client ne reçoit.
+
+    Le destructeur tue (SIGKILL) et réape un script encore en vie, et
+    ferme les fds restants : l'appelant les retire du Poller avant.
+*/
+
+class CgiProcess : public CgiOutput
+{
+public:
+	enum ReadResult
+	{
+		READ_WAIT,   // pipe vide (EAGAIN) : attendre EV_READ
+		READ_MORE,   // limite atteinte : il peut rester des octets
+		READ_EOF     // sortie terminée (ou erreur de lecture)
+	};
+
+	CgiProcess();
+	~CgiProcess();
+
+	// Lance interpreter (vide : le script lui-même) sur scriptPath, dans
+	// le dossier du script. input (body POST) est pris par swap.
+	bool start(const std::string &interpreter,
+	           const std::string &scriptPath,
+	           const std::vector<std::string> &env,
+	           std::string &input);
+
+	int inputFd() const;    // stdin du script, -1 une fois fermé
+	int outputFd() const;   // stdout du script, ouvert jusqu'à la destruction
+	int exitFd() const;     // pidfd, -1 si indisponible
+
+	// Écrit le body jusqu'à EAGAIN ; true quand stdin peut être fermé
+	// (tout écrit, ou le script a fermé son stdin).
+	bool writeInput();
+	void closeInput();
+
+	// Lit stdout jusqu'à EAGAIN, EOF, ou limit octets en buffer.
+	ReadResult readOutput(std::size_t limit);
+
+	// waitpid(WNOHANG) ; true si le process est terminé.
+	bool reap();
+	bool exited() const;
+	// Terminé par exit(0) (sinon le motif est loggé).
+	bool succeeded() const;
+
+	void kill();
+
+private:
+	CgiProcess(const CgiProcess &);
+	CgiProcess &operator=(const CgiProcess &);
+
+	pid_t       _pid;
+	int         _in;
+	int         _out;
+	int         _exitFd;
+
+	std::string _input;       // body à écrire sur stdin
+	std::size_t _inputOff;
+
+	bool        _exited;
+	int         _status;      // status de waitpid()
+};
+
+#endif // CGIPROCESS_HPP
@@ -0,0 +1,75 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Compressor.hpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef COMPRESSOR_HPP
+# define COMPRESSOR_HPP
+
+# include <string>
+# include <cstddef>
+# include <zlib.h>
+
+/*
+    Compressor
+
+    Compression gzip / deflate (zlib) en flux : les octets sont donnés
+    morceau par morceau avec update(), le résultat compressé est ajouté
+    à out au fur et à mesure ; finish() termine le flux (trailer gzip).
+
+        Compressor z(Compressor::GZIP, 6);
+        std::string out;
+        z.update(data, len, out);   // autant de fois que nécessaire
+        z.flush(out);               // optionnel : vide le compresseur
+        z.finish(out);
+
+    compress() fait tout en un appel pour un buffer complet.
+
+    Formats (Content-Encoding) :
+      - GZIP    : "gzip"    (en-tête + CRC32 gzip)
+      - DEFLATE : "deflate" (flux zlib, RFC 1950, ce qu'attendent les
+                  navigateurs pour "deflate")
+*/
+
+class Compressor
+{
+public:
+	enum Format
+	{
+		GZIP,
+		DEFLATE
+	};
+
+	Compressor(Format format, int level);
+	~Compressor();
+
+	// false si zlib a échoué (le flux est alors inutilisable).
+	bool update(const char *data, std::size_t len, std::string &out);
+	bool flush(std::string &out);
+	bool finish(std::string &out);
+
+	static bool compress(Format format, int level,
+	                     const std::string &in, std::string &out);
+
+	// Valeur du header Content-Encoding
+	static const char *encodingName(Format format);
+
+private:
+	Compressor(const Compressor &);
+	Compressor &operator=(const Compressor &);
+
+	bool run(const char *data, std::size_t len, int flush, std::string &out);
+
+	z_stream _zs;
+	bool     _ok;
+	bool     _finished;
+};
+
+#endif // COMPRESSOR_HPP
@@ -31,8 +31,36 @@
       - redirect (3xx) par location
       - upload_store (dossier d'upload) par location
       - cgi .ext /path/to/interpreter; par location
+      - cgi_pool N; cgi_pool_runner /path; cgi_pool_max_requests N;
+        par location (interpréteurs préforkés, voir CgiPool)
+      - cgi_max_concurrency N; cgi_queue_size N; cgi_queue_timeout S;
+        par location (admission des scripts, voir CgiLimiter)
+      - cgi_status on|off; par location (compteurs des locations cgi)
+      - fastcgi_pass unix:/path | host:port; par location (application
+        FastCGI, connexions persistantes)
+      - proxy_pass http://host[:port][/uri] | unix:/path; par location
+        (reverse proxy HTTP/1.1, connexions keep-alive vers le backend)
+      - proxy_pass http://<upstream>[/uri]; / fastcgi_pass <upstream>;
+        (groupe de serveurs, voir UpstreamConfig)
+      - gzip_static on|off; par location (sert file.gz si présent)
+      - compress on|off; compress_types ...; compress_min_length N;
+        compress_level 1-9; par location (gzip / deflate à la volée)
 
     + host <hostname>;   (ajouté pour les virtual hosts HTTP)
+    + keepalive_timeout <secondes>; / keepalive_requests <n>;
+    + pipeline_max_requests <n>;  (requêtes pipelinées en attente max)
+
+    Directives globales (hors de tout bloc server) :
+      - event_backend epoll|poll;
+      - worker_processes N|auto;
+      - worker_threads N|auto;
+      - accept_budget N;
+      - sendfile_max_chunk SIZE;
+      - open_file_cache N|off;
+      - open_file_cache_inactive / open_file_cache_valid SECONDES;
+      - open_file_cache_min_uses N;
+      - response_cache SIZE|off; / response_cache_max_entry SIZE;
+      - upstream <nom> { server ...; least_conn; | hash ...; }
 */
 
 # include <string>
@@ -55,6 +83,21 @@
             redirect 301 /new-path/;
             upload_store ./www/uploads;
             cgi .py /usr/bin/python3;
+            # cgi_pool 4;                    # interpréteurs préforkés
+            # cgi_pool_runner ./tests_webserv/cgi_pool/runner.py;
+            # cgi_pool_max_requests 500;     # recyclage (0 = jamais)
+            # cgi_max_concurrency 8;         # scripts en même temps (0 = illimité)
+            # cgi_queue_size 32;             # requêtes en attente, puis 503
+            # cgi_queue_timeout 10;          # attente max (s), puis 503
+            # cgi_status on;                 # (autre location) page des compteurs
+            # fastcgi_pass 127.0.0.1:9000;   # (ou unix:/run/app.sock)
+            # proxy_pass http://127.0.0.1:8000/app/;  # (ou unix:/run/app.sock)
+            # proxy_pass http://backends/;   # bloc upstream (idem fastcgi_pass)
+            gzip_static on;      # file.gz envoyé si le client accepte gzip
+            compress on;         # gzip / deflate à la volée
+            compress_types text/html application/json;   # "*" = tout
+            compress_min_length 256;
+            compress_level 6;
         }
 */
 
@@ -79,6 +122,34 @@ struct LocationConfig
 	std::string              cgiExtension;
 	std::string              cgiPath;
 
+	std::size_t              cgiPoolSize;       // 0 : fork + execve par requête
+	std::string              cgiPoolRunner;     // script lancé par cgiPath
+	std::size_t              cgiPoolMaxRequests; // 0 : pas de recyclage
+
+	std::size_t              cgiMaxConcurrency; // 0 : illimité
+	std::size_t              cgiQueueSize;      // 0 : 503 dès la limite
+	unsigned long            cgiQueueTimeout;   // secondes
+	bool                     cgiStatus;         // page des compteurs CGI
+
+	bool                     fastcgiEnabled;
+	std::string              fastcgiPass;       // "unix:/path" ou "ip:port"
+
+	bool                     proxyEnabled;
+	std::string              proxyPass;         // "unix:/path" ou "ip:port"
+	std::string              proxyUri;          // remplace le préfixe de la
+	                                            // location (vide : URI inchangée)
+
+	std::string              upstream;          // proxy_pass / fastcgi_pass vers
+	                                            // un bloc upstream (vide : adresse
+	                                            // fixe proxyPass / fastcgiPass)
+
+	bool                     gzipStatic;
+
+	bool                     compress;
+	std::set<std::string>    compressTypes;     // types MIME (sans paramètres)
+	std::size_t              compressMinLength; // octets
+	int                      compressLevel;     // 1 (rapide) .. 9 (max)
+
 	LocationConfig()
 		: path("/"),
 		  root(),
@@ -93,8 +164,28 @@ struct LocationConfig
 		  uploadStore(),
 		  cgiEnabled(false),
 		  cgiExtension(),
-		  cgiPath()
-	{}
+		  cgiPath(),
+		  cgiPoolSize(0),
+		  cgiPoolRunner(),
+		  cgiPoolMaxRequests(0),
+		  cgiMaxConcurrency(0),
+		  cgiQueueSize(0),
+		  cgiQueueTimeout(10),
+		  cgiStatus(false),
+		  fastcgiEnabled(false),
+		  fastcgiPass(),
+		  proxyEnabled(false),
+		  proxyPass(),
+		  proxyUri(),
+		  upstream(),
+		  gzipStatic(false),
+		  compress(false),
+		  compressTypes(),
+		  compressMinLength(256),
+		  compressLevel(6)
+	{
+		compressTypes.insert("text/html");
+	}
 };
 
 /*
@@ -110,6 +201,9 @@ struct LocationConfig
             error_page 404 /404.html;
             client_max_body_size 1000000;
             autoindex off;
+            keepalive_timeout 75;      # 0 => pas de keep-alive
+            keepalive_requests 1000;   # requêtes max par connexion
+            pipeline_max_requests 32;  # réponses en attente max par connexion
 
             location / { ... }
             location /upload { ... }
@@ -130,6 +224,10 @@ struct ServerConfig
 
 	bool                        autoindex;
 
+	int                         keepaliveTimeout;   // secondes (0 = désactivé)
+	std::size_t                 keepaliveRequests;
+	std::size_t                 pipelineMaxRequests;
+
 	std::vector<LocationConfig> locations;
 
 	ServerConfig()
@@ -140,10 +238,124 @@ struct ServerConfig
 		  errorPages(),
 		  clientMaxBodySize(1024 * 1024),
 		  autoindex(false),
+		  keepaliveTimeout(75),
+		  keepaliveRequests(1000),
+		  pipelineMaxRequests(32),
 		  locations()
 	{}
 };
 
+/*
+    UpstreamConfig
+
+    Groupe de serveurs interchangeables (directive globale) :
+
+        upstream backends {
+            server 127.0.0.1:9100;
+            server 10.0.0.2:9100 weight=2 max_fails=3 fail_timeout=30;
+            server unix:/run/app.sock;
+            least_conn;              # ou hash $request_uri; / hash $remote_addr;
+        }
+
+    Répartition : round-robin pondéré (défaut), least_conn (moins de
+    requêtes en cours, rapportées au poids), ou hachage cohérent de
+    l'URI ou de l'IP du client. Un serveur qui échoue max_fails fois en
+    fail_timeout secondes est écarté pendant fail_timeout secondes
+    (max_fails 0 : jamais). Voir Upstream.
+*/
+
+struct UpstreamServerConfig
+{
+	std::string   address;       // "unix:/path" ou "ip:port"
+	unsigned      weight;
+	unsigned      maxFails;      // 0 : jamais écarté
+	unsigned long failTimeout;   // secondes
+
+	UpstreamServerConfig()
+		: address(),
+		  weight(1),
+		  maxFails(1),
+		  failTimeout(10)
+	{}
+};
+
+struct UpstreamConfig
+{
+	enum Balance
+	{
+		BALANCE_ROUND_ROBIN,
+		BALANCE_LEAST_CONN,
+		BALANCE_HASH_URI,      // hash $request_uri
+		BALANCE_HASH_IP        // hash $remote_addr
+	};
+
+	std::string                       name;
+	Balance                           balance;
+	std::vector<UpstreamServerConfig> servers;
+
+	UpstreamConfig()
+		: name(),
+		  balance(BALANCE_ROUND_ROBIN),
+		  servers()
+	{}
+};
+
+/*
+    GlobalConfig
+
+    Directives placées en dehors des blocs server :
+
+        event_backend epoll;     # ou poll (défaut : epoll si disponible)
+        worker_processes 4;      # ou auto (= nombre de CPU), défaut 1
+        worker_threads 4;        # ou auto : 1 acceptor + N reactors, défaut 1
+        accept_budget 64;        # accept() max par tour de boucle, défaut 64
+        sendfile_max_chunk 512k; # octets max par sendfile(), défaut 512k
+
+        open_file_cache 1000;            # entrées max (défaut off)
+        open_file_cache_inactive 20;     # secondes sans usage avant retrait
+        open_file_cache_valid 60;        # secondes avant de revérifier (stat)
+        open_file_cache_min_uses 1;      # usages avant de garder le fd ouvert
+
+        response_cache 8m;               # budget des réponses en mémoire (défaut off)
+        response_cache_max_entry 64k;    # taille max d'un fichier mis en cache
+
+        upstream backends { ... }        # voir UpstreamConfig
+*/
+
+struct GlobalConfig
+{
+	std::string                 eventBackend;   // vide => backend par défaut
+	std::size_t                 workerProcesses; // 1 => pas de master
+	std::size_t                 workerThreads;   // 1 => une seule boucle
+	std::size_t                 acceptBudget;    // accept() par tour, tous ports
+	std::size_t                 sendfileMaxChunk; // octets par appel sendfile()
+
+	std::size_t                 openFileCacheMax;      // 0 => désactivé
+	unsigned long               openFileCacheInactive; // secondes
+	unsigned long               openFileCacheValid;    // secondes
+	unsigned                    openFileCacheMinUses;
+
+	std::size_t                 responseCacheSize;     // octets, 0 => désactivé
+	std::size_t                 responseCacheMaxEntry; // octets par fichier
+
+	std::vector<UpstreamConfig> upstreams;
+
+	GlobalConfig()
+		: eventBackend(),
+		  workerProcesses(1),
+		  workerThreads(1),
+		  acceptBudget(64),
+		  sendfileMaxChunk(512 * 1024),
+		  openFileCacheMax(0),
+		  openFileCacheInactive(20),
+		  openFileCacheValid(60),
+		  openFileCacheMinUses(1),
+		  responseCacheSize(0),
+		  responseCacheMaxEntry(64 * 1024),
+		  upstreams()
+	{}
+};
+
 class Config
 {
 public:
@@ -157,11 +369,35 @@ public:
 	// Retourne la liste des serveurs configurés.
 	const std::vector<ServerConfig> &getServers() const;
 
+	// Retourne les directives globales.
+	const GlobalConfig &getGlobal() const;
+
 private:
 	std::vector<ServerConfig> _servers;
+	GlobalConfig              _global;
 
 	std::string trim(const std::string &s) const;
 
+	// "keyword value;" -> value (vérifie le mot-clé et le ';').
+	std::string readSingleValue(const std::string &line,
+	                            const std::string &keyword) const;
+	// Entier >= 0 (throw si invalide).
+	unsigned long parseSize(const std::string &value,
+	                        const std::string &keyword) const;
+	unsigned long parseNumber(const std::string &value,
+	                          const std::string &keyword) const;
+	// fastcgi_pass, proxy_pass : "unix:/path" ou "host:port" -> "ip:port".
+	std::string parseSocketAddress(const std::string &value,
+	                               const std::string &directive) const;
+
+	void parseGlobalDirective(const std::string &line);
+
+	// upstream <nom> { ... } ; puis noms de proxy_pass / fastcgi_pass
+	// résolus une fois tout le fichier lu (upstream après les server).
+	void parseUpstreamBlock(std::istream &in, const std::string &line);
+	void parseUpstreamServer(const std::string &line, UpstreamConfig &upstream);
+	void resolveUpstreams();
+
 	void parseServerBlock(std::istream &in, ServerConfig &server);
 
 	void parseListenDirective(const std::string &line, ServerConfig &server);
@@ -171,6 +407,9 @@ private:
 	void parseErrorPageDirective(const std::string &line, ServerConfig &server);
 	void parseClientMaxBodySizeDirective(const std::string &line, ServerConfig &server);
 	void parseServerAutoindexDirective(const std::string &line, ServerConfig &server);
+	void parseKeepaliveTimeoutDirective(const std::string &line, ServerConfig &server);
+	void parseKeepaliveRequestsDirective(const std::string &line, ServerConfig &server);
+	void parsePipelineMaxRequestsDirective(const std::string &line, ServerConfig &server);
 
 	// location
 	void parseLocationDirective(std::istream &in,
@@ -0,0 +1,186 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   FastCgiConnection.hpp                              :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef FASTCGICONNECTION_HPP
+# define FASTCGICONNECTION_HPP
+
+# include <string>
+# include <vector>
+# include <map>
+# include <cstddef>
+
+# include "CgiOutput.hpp"
+# include "TimerWheel.hpp"
+
+struct CgiJob;
+class FastCgiConnection;
+
+/*
+    FastCgiRequest
+
+    Une requête envoyée à une application FastCGI (rôle RESPONDER). Les
+    records FCGI_STDOUT reçus par la connexion remplissent la sortie
+    (CgiOutput), FCGI_END_REQUEST la termine.
+
+    Détruite avant sa fin (client parti, timeout), elle est abandonnée
+    auprès de la connexion (FCGI_ABORT_REQUEST).
+*/
+
+class FastCgiRequest : public CgiOutput
+{
+public:
+	FastCgiRequest();
+	~FastCgiRequest();
+
+	// END_REQUEST reçu avec FCGI_REQUEST_COMPLETE et un app status 0
+	// (sinon le motif est loggé : connexion perdue, refus...).
+	bool succeeded() const;
+
+	// Connexion qui porte la requête, NULL une fois terminée.
+	FastCgiConnection *connection() const;
+
+	CgiJob *job;              // propriétaire (WebServer)
+
+private:
+	FastCgiRequest(const FastCgiRequest &);
+	FastCgiRequest &operator=(const FastCgiRequest &);
+
+	friend class FastCgiConnection;
+
+	FastCgiConnection *_conn;
+	unsigned short     _id;
+	bool               _failed;         // connexion perdue avant la fin
+	unsigned long      _appStatus;
+	int                _protocolStatus;
+};
+
+/*
+    FastCgiConnection
+
+    Une connexion persistante (FCGI_KEEP_CONN) vers une application
+    FastCGI, socket Unix ou TCP non bloquante, pilotée par la boucle :
+
+      - submit() encode BEGIN_REQUEST, PARAMS (l'environnement CGI) et
+        STDIN dans le buffer d'écriture ; flush() l'envoie jusqu'à EAGAIN ;
+      - readRecords() lit la socket, découpe les records et les distribue
+        aux requêtes par request id (multiplexage) ;
+      - à l'ouverture, FCGI_GET_VALUES demande FCGI_MPXS_CONNS et
+        FCGI_MAX_REQS : tant que l'application n'a pas annoncé qu'elle
+        multiplexe, une seule requête à la fois ;
+      - une requête abandonnée garde son id (ABORT_REQUEST envoyé)
+        jusqu'à son END_REQUEST ; ses records sont ignorés.
+
+    Pas de backpressure par requête dans un flux multiplexé : pause()
+    arrête la lecture de toute la connexion tant qu'un de ses clients
+    est trop lent.
+*/
+
+class FastCgiConnection
+{
+public:
+	enum ReadResult
+	{
+		READ_WAIT,   // socket vide (EAGAIN) : attendre EV_READ
+		READ_MORE,   // limite atteinte : il peut rester des octets
+		READ_EOF     // connexion fermée, erreur ou record invalide
+	};
+
+	explicit FastCgiConnection(const std::string &address);
+	~FastCgiConnection();
+
+	// socket() + connect() non bloquant ; false si l'échec est immédiat.
+	bool open();
+	// Socket déjà connectée (worker d'un CgiPool) : une requête à la fois,
+	// pas de FCGI_GET_VALUES. false si elle ne passe pas en non bloquant.
+	bool adopt(int fd);
+
+	int fd() const;
+	const std::string &address() const;
+
+	std::size_t active() const;     // requêtes en cours (hors abandonnées)
+	bool idle() const;              // aucune requête, même abandonnée
+	bool broken() const;
+	// connect() pas (encore) abouti : rien n'est parti.
+	bool connecting() const;
+	// Peut prendre une requête de plus (limite de multiplexage).
+	bool canAccept() const;
+	// Requêtes en cours (pour vérifier leurs deadlines).
+	void activeRequests(std::vector<FastCgiRequest *> &out) const;
+
+	// Nouvelle requête : id attribué, records mis en file d'écriture.
+	void submit(FastCgiRequest &req, const std::string &scriptPath,
+	            const std::vector<std::string> &env,
+	            const std::string &body);
+	// Retire une requête sans la faire échouer (elle repart sur une
+	// autre connexion) ; la connexion ne sert plus.
+	void withdraw(FastCgiRequest &req);
+
+	// Connexion en cours ou octets en attente : surveiller EV_WRITE.
+	bool wantsWrite() const;
+	// Termine le connect() et écrit jusqu'à EAGAIN ; false si la
+	// connexion est perdue.
+	bool flush();
+
+	// Lit au plus limit octets et distribue les records complets ; les
+	// requêtes qui ont reçu des données (ou leur fin) sont ajoutées à
+	// touched.
+	ReadResult readRecords(std::size_t limit,
+	                       std::vector<FastCgiRequest *> &touched);
+
+	// Connexion perdue : les requêtes en cours se terminent en échec
+	// (ajoutées à touched).
+	void fail(std::vector<FastCgiRequest *> &touched);
+
+	// Backpressure (compteur : un appel par requête en pause).
+	void pause();
+	void resume();
+	bool paused() const;
+
+	TimerNode timer;                // timeouts des requêtes (clé : fd)
+	bool      dispatching;          // records en cours de traitement :
+	                                // l'appelant ne doit pas la fermer
+
+private:
+	FastCgiConnection(const FastCgiConnection &);
+	FastCgiConnection &operator=(const FastCgiConnection &);
+
+	friend class FastCgiRequest;
+
+	typedef std::map<unsigned short, FastCgiRequest *> RequestMap;
+
+	void detach(FastCgiRequest &req);
+	void appendRecord(unsigned char type, unsigned short id,
+	                  const char *data, std::size_t len);
+	void appendStream(unsigned char type, unsigned short id,
+	                  const std::string &data);
+	void dispatch(unsigned char type, unsigned short id,
+	              const char *data, std::size_t len,
+	              std::vector<FastCgiRequest *> &touched);
+	void readValues(const char *data, std::size_t len);
+
+	int           _fd;
+	std::string   _address;
+	bool          _connecting;
+	bool          _broken;
+
+	std::string   _wbuf;            // records à envoyer
+	std::size_t   _wOff;
+	std::string   _rbuf;            // record incomplet en cours de lecture
+
+	RequestMap    _requests;        // NULL : requête abandonnée
+	std::size_t   _active;
+	unsigned short _nextId;
+	std::size_t   _maxRequests;     // 1 tant que MPXS_CONNS n'est pas connu
+	unsigned      _paused;
+};
+
+#endif // FASTCGICONNECTION_HPP
@@ -0,0 +1,61 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   FastCgiPool.hpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef FASTCGIPOOL_HPP
+# define FASTCGIPOOL_HPP
+
+# include <string>
+# include <vector>
+# include <map>
+# include <cstddef>
+
+# include "FastCgiConnection.hpp"
+
+/*
+    FastCgiPool
+
+    Connexions persistantes vers les applications FastCGI, par adresse
+    (valeur de fastcgi_pass). Un pool par boucle d'événements (reactor) :
+    pas de lock, chaque connexion n'est vue que par un thread.
+
+      - find() : la connexion la moins chargée qui peut prendre une
+        requête de plus (multiplexage), sinon NULL ;
+      - open() : nouvelle connexion quand toutes sont pleines ;
+      - les connexions au repos restent ouvertes pour les requêtes
+        suivantes, idle() permet à l'appelant d'en borner le nombre.
+*/
+
+class FastCgiPool
+{
+public:
+	FastCgiPool();
+	~FastCgiPool();
+
+	FastCgiConnection *find(const std::string &address);
+	// NULL si la connexion ne peut pas être ouverte.
+	FastCgiConnection *open(const std::string &address);
+	// Ferme et détruit la connexion (l'appelant l'a retirée du Poller).
+	void close(FastCgiConnection *conn);
+
+	// Connexions au repos vers address.
+	std::size_t idle(const std::string &address) const;
+
+private:
+	FastCgiPool(const FastCgiPool &);
+	FastCgiPool &operator=(const FastCgiPool &);
+
+	typedef std::map<std::string, std::vector<FastCgiConnection *> > ConnMap;
+
+	ConnMap _conns;
+};
+
+#endif // FASTCGIPOOL_HPP
@@ -15,6 +15,13 @@
 
 # include <string>
 # include <map>
+# include <vector>
+# include <cstddef>
+# include <sys/types.h> // off_t
+
+# include "OpenFileCache.hpp"
+# include "ResponseCache.hpp"
+# include "OutputQueue.hpp"
 
 /*
     HttpResponse
@@ -22,13 +29,36 @@
     Représente une réponse HTTP complète que l'on peut sérialiser
     en string brute à envoyer sur la socket.
 
+    Pour l'envoi, on sérialise les headers seuls (serializeHeaders()) et
+    le body passe dans l'OutputQueue par moveBodyTo() (swap) : il n'est
+    jamais recopié dans un buffer "headers + body".
+
+    Body "fichier" (setFileBody()) : la réponse garde seulement une
+    entrée de l'OpenFileCache (fd partagé), un offset et une longueur ;
+    le contenu part avec sendfile() sans jamais passer en mémoire. La
+    réponse tient la référence tant qu'elle n'a pas été reprise par
+    moveBodyTo().
+
+    Body en plusieurs parties (appendBodyPart() / appendFilePart()) :
+    suite de morceaux mémoire et de tranches de fichier, envoyés dans
+    l'ordre (ex : multipart/byteranges).
+
+    Body streamé (setStreamedBody()) : seuls les headers sont envoyés
+    d'ici, le body suit plus tard dans l'OutputQueue (sortie d'un CGI) ;
+    pas de Content-Length automatique.
+
+    Réponse "en cache" (setCachedBody()) : la réponse complète est déjà
+    sérialisée dans une entrée du ResponseCache ; status, headers et
+    body de l'objet sont alors ignorés à l'envoi.
+
     Contient :
       - un code de statut (200, 404, 500, ...)
       - une raison textuelle ("OK", "Not Found", ...)
       - des headers (clé:valeur)
       - un body (string)
 
-    toString() produit quelque chose comme :
+    serializeHeaders() produit quelque chose comme (le body suit à part,
+    voir moveBodyTo()) :
 
       HTTP/1.1 200 OK\r\n
       Header1: value\r\n
@@ -36,7 +66,6 @@
       Server: webserv/0.1\r\n
       Content-Length: <taille body>\r\n
       \r\n
-      <body>
 */
 
 class HttpResponse
@@ -47,18 +76,67 @@ public:
 
 	void setStatus(int code, const std::string &reason);
 	void setBody(const std::string &body);
+	// Échange le body avec body (sans copie) : pour y placer un gros
+	// contenu, ou pour le récupérer au moment de l'envoi.
+	void swapBody(std::string &body);
+
+	// Body = length octets du fichier de file à partir de offset
+	// (prend la référence sur file).
+	void setFileBody(OpenFileCache::Entry *file, off_t offset,
+	                 std::size_t length);
+	// Ajoute un morceau au body (après le body mémoire éventuel).
+	void appendBodyPart(const std::string &data);
+	// Idem avec une tranche de fichier (prend la référence sur file).
+	void appendFilePart(OpenFileCache::Entry *file, off_t offset,
+	                    std::size_t length);
+	// Met le body (mémoire, parties, références) en fin de out.
+	void moveBodyTo(OutputQueue &out);
+	// Réponse prête dans le ResponseCache (prend la référence).
+	void setCachedBody(ResponseCache::Entry *entry);
+	bool hasCachedBody() const;
+	ResponseCache::Entry *releaseCachedBody();
+	// Body envoyé à part, au fil de l'eau (Transfer-Encoding: chunked,
+	// Content-Length du producteur, ou fin de connexion).
+	void setStreamedBody();
+
+	// Écriture, recherche, suppression sans tenir compte de la casse du
+	// nom (les headers CGI arrivent tels que le script les écrit) :
+	// setHeader() remplace un header existant quelle que soit sa casse.
 	void setHeader(const std::string &name, const std::string &value);
+	std::string getHeader(const std::string &name) const;
+	void removeHeader(const std::string &name);
 
 	int getStatusCode() const;
 
-	// Construit la string brute à envoyer sur le réseau.
-	std::string toString() const;
+	// Status line + headers + ligne vide (sans le body).
+	std::string serializeHeaders() const;
 
 private:
+	// Une réponse avec un body fichier tient une référence : pas de copie.
+	HttpResponse(const HttpResponse &);
+	HttpResponse &operator=(const HttpResponse &);
+
 	int _statusCode;
 	std::string _reasonPhrase;
 	std::map<std::string, std::string> _headers;
 	std::string _body;
+
+	// Partie de body : data si file == NULL, sinon tranche de fichier
+	struct Part
+	{
+		std::string           data;
+		OpenFileCache::Entry *file;
+		off_t                 offset;
+		std::size_t           length;
+	};
+
+	void        releaseParts();
+	std::size_t bodyLength() const;
+
+	std::vector<Part> _parts;     // envoyées après _body
+
+	ResponseCache::Entry *_cached; // non NULL : réponse déjà sérialisée
+	bool                  _streamed; // body hors de la réponse
 };
 
 #endif // HTTPRESPONSE_HPP
@@ -0,0 +1,64 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   MasterProcess.hpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef MASTERPROCESS_HPP
+# define MASTERPROCESS_HPP
+
+# include <vector>
+# include <ctime>
+# include <sys/types.h>
+
+# include "Config.hpp"
+
+/*
+    MasterProcess
+
+    Mode multi-process (worker_processes N|auto) :
+
+      - le master fork N workers ;
+      - chaque worker crée SES PROPRES sockets d'écoute avec SO_REUSEPORT
+        (le noyau répartit les connexions entre eux) et fait tourner sa
+        propre boucle WebServer::run() ;
+      - le master ne sert aucune requête : il attend la mort des workers
+        et relance ceux qui ont crashé (signal).
+
+    Un worker qui sort avec un code != 0 a échoué au démarrage (bind,
+    config...) : relancer ne servirait à rien, le master arrête tout.
+
+    SIGINT / SIGTERM sur le master : arrêt propre de tous les workers.
+*/
+
+class MasterProcess
+{
+public:
+	MasterProcess(const std::vector<ServerConfig> &servers,
+	              const GlobalConfig &global);
+	~MasterProcess();
+
+	// Boucle du master. Retourne le code de sortie du programme.
+	int run();
+
+private:
+	MasterProcess(const MasterProcess &);
+	MasterProcess &operator=(const MasterProcess &);
+
+	pid_t spawnWorker(std::size_t slot);
+	void  stopWorkers();
+
+	const std::vector<ServerConfig> &_servers;
+	const GlobalConfig              &_global;
+
+	std::vector<pid_t>               _workers;     // pid par slot (-1 = vide)
+	std::vector<std::time_t>         _spawnTimes;  // dernier lancement par slot
+};
+
+#endif // MASTERPROCESS_HPP
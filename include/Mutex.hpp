@@ -0,0 +1,60 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Mutex.hpp                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef MUTEX_HPP
+# define MUTEX_HPP
+
+# include <pthread.h>
+
+/*
+    Mutex / ScopedLock
+
+    Petit wrapper RAII autour de pthread_mutex_t (pas de std::mutex en
+    C++98). Utilisé pour les données partagées entre threads en mode
+    worker_threads (file de connexions d'un reactor, caches partagés).
+
+        {
+            ScopedLock lock(_mutex);
+            ... section critique ...
+        }   // unlock automatique
+*/
+
+class Mutex
+{
+public:
+	Mutex();
+	~Mutex();
+
+	void lock();
+	void unlock();
+
+private:
+	Mutex(const Mutex &);
+	Mutex &operator=(const Mutex &);
+
+	pthread_mutex_t _mutex;
+};
+
+class ScopedLock
+{
+public:
+	explicit ScopedLock(Mutex &mutex);
+	~ScopedLock();
+
+private:
+	ScopedLock(const ScopedLock &);
+	ScopedLock &operator=(const ScopedLock &);
+
+	Mutex &_mutex;
+};
+
+#endif // MUTEX_HPP
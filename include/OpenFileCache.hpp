@@ -0,0 +1,127 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   OpenFileCache.hpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef OPENFILECACHE_HPP
+# define OPENFILECACHE_HPP
+
+# include <string>
+# include <map>
+# include <cstddef>
+# include <ctime>
+# include <sys/types.h>
+
+# include "Mutex.hpp"
+
+/*
+    OpenFileCache
+
+    Cache des métadonnées de fichiers (existe ? dossier ? taille, mtime)
+    et des fds ouverts, partagé par tous les threads du process.
+
+      - acquire(path) : renvoie une Entry référencée (jamais NULL). Les
+        chemins inexistants sont aussi mis en cache (exists = false).
+      - release(entry) : rend la référence. Le fd d'une entrée n'est
+        fermé que lorsque plus personne ne l'utilise (un sendfile() en
+        cours garde l'entrée vivante même si elle sort du cache).
+
+    Paramètres (directives globales) :
+      - max       : nombre max d'entrées (0 = cache désactivé : chaque
+                    acquire fait stat/open et release ferme) ;
+      - inactive  : une entrée non utilisée pendant ce délai est retirée ;
+      - valid     : au-delà, l'entrée est revérifiée par stat() (fichier
+                    modifié ou remplacé => nouvelle entrée) ;
+      - min_uses  : en dessous de ce nombre d'utilisations, le fd n'est
+                    pas gardé ouvert entre deux requêtes (métadonnées
+                    seulement).
+
+    Éviction : LRU, l'entrée la moins récemment utilisée part en premier
+    quand la table est pleine.
+
+    Le lock ne couvre que la table : stat() et open() se font hors lock.
+*/
+
+class OpenFileCache
+{
+public:
+	struct Entry
+	{
+		// --- Lecture seule pour l'appelant (tant qu'il tient une référence) ---
+		bool            exists;
+		bool            isDir;
+		bool            isFile;      // fichier régulier
+		off_t           size;
+		std::time_t     mtime;
+		int             fd;          // ouvert si acquire(..., wantFd) a réussi
+		std::string     path;
+
+		// --- Interne ---
+		OpenFileCache  *cache;
+		dev_t           dev;
+		ino_t           ino;
+		unsigned        refs;
+		unsigned        uses;
+		unsigned long   validatedAt; // ms
+		unsigned long   lastUse;     // ms
+		bool            cached;      // encore dans la table
+		Entry          *lruPrev;     // vers plus récent
+		Entry          *lruNext;     // vers plus ancien
+
+		Entry();
+	};
+
+	OpenFileCache(std::size_t maxEntries, unsigned long inactiveMs,
+	              unsigned long validMs, unsigned minUses);
+	~OpenFileCache();
+
+	// Entrée de path, référencée. wantFd : ouvre le fichier s'il est
+	// régulier (Entry::fd reste -1 si l'ouverture échoue).
+	Entry *acquire(const std::string &path, bool wantFd, unsigned long nowMs);
+
+	// Référence supplémentaire : l'appelant en tient déjà une.
+	static void retain(Entry *entry);
+	// Rend une référence (thread-safe). NULL accepté.
+	static void release(Entry *entry);
+
+	// Oublie path (après un DELETE ou un upload).
+	void invalidate(const std::string &path);
+
+private:
+	OpenFileCache(const OpenFileCache &);
+	OpenFileCache &operator=(const OpenFileCache &);
+
+	typedef std::map<std::string, Entry *> EntryMap;
+
+	Entry *createEntry(const std::string &path, unsigned long nowMs);
+	Entry *lookup(const std::string &path, unsigned long nowMs);
+	Entry *insert(Entry *fresh, unsigned long nowMs);
+	void   take(Entry *entry, unsigned long nowMs);
+	bool   isValid(const Entry &entry, unsigned long nowMs) const;
+	void   openFd(Entry *entry);
+	void   releaseLocked(Entry *entry);
+	void   detach(Entry *entry);
+	void   destroy(Entry *entry);
+	void   expire(unsigned long nowMs);
+	void   lruUnlink(Entry *entry);
+	void   lruPushFront(Entry *entry);
+
+	Mutex           _mutex;
+	EntryMap        _entries;
+	Entry          *_lruHead;    // plus récent
+	Entry          *_lruTail;    // plus ancien
+
+	std::size_t     _maxEntries;
+	unsigned long   _inactiveMs;
+	unsigned long   _validMs;
+	unsigned        _minUses;
+};
+
+#endif // OPENFILECACHE_HPP
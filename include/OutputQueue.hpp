@@ -0,0 +1,126 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   OutputQueue.hpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef OUTPUTQUEUE_HPP
+# define OUTPUTQUEUE_HPP
+
+# include <string>
+# include <deque>
+# include <cstddef>
+# include <sys/types.h> // off_t
+# include <sys/uio.h>   // struct iovec, writev
+
+# include "OpenFileCache.hpp"
+# include "ResponseCache.hpp"
+
+/*
+    OutputQueue
+
+    File d'octets à envoyer, découpée en segments :
+
+      - segments mémoire (bloc de headers, body...) : envoyés avec
+        writev(). append() prend possession du buffer par swap : aucun
+        octet du body n'est copié ;
+      - segments fichier (entrée OpenFileCache + offset + longueur) :
+        envoyés avec sendfile() directement depuis le page cache. La
+        queue tient une référence sur l'entrée et la rend quand le
+        segment est terminé (ou à la destruction) ;
+      - segments partagés (tranche d'une entrée du ResponseCache) :
+        envoyés avec writev() comme les segments mémoire, sans copie ;
+        la queue tient une référence sur l'entrée ;
+      - segments pipe (length octets déjà présents dans un pipe, stdout
+        d'un CGI) : envoyés avec splice(), sans passer par l'espace
+        utilisateur. Le pipe appartient au CGI, qui doit vivre jusqu'à
+        la fin du segment (ou de la queue).
+
+    Chaque segment garde un offset d'envoi qui avance : rien n'est
+    jamais effacé en tête de buffer (pas de erase(0, n)).
+
+    Utilisation :
+
+        bool whole;
+        int n = queue.fillIovec(iov, 16, whole);
+        if (n > 0)  -> writev(fd, iov, n), puis consume(w)
+        else if (queue.frontFile(f, off, left))
+                    -> sendfile(fd, f, &off, ...), puis consume(w)
+        else if (queue.frontPipe(p, left))
+                    -> splice(p, NULL, fd, NULL, left, ...), puis consume(w)
+*/
+
+class OutputQueue
+{
+public:
+	OutputQueue();
+	~OutputQueue();
+
+	// Ajoute data en fin de file (data est vidé : swap).
+	void append(std::string &data);
+
+	// Ajoute length octets de file à partir de offset (prend la référence).
+	void appendFile(OpenFileCache::Entry *file, off_t offset,
+	                std::size_t length);
+
+	// Ajoute les octets [begin, end) de entry (prend la référence).
+	void appendCached(ResponseCache::Entry *entry, std::size_t begin,
+	                  std::size_t end);
+
+	// Ajoute length octets à lire dans le pipe pipeFd (non possédé).
+	void appendPipe(int pipeFd, std::size_t length);
+
+	bool        empty() const;
+	std::size_t pending() const;   // octets restant à envoyer
+
+	// Remplit au plus max iovec avec les segments mémoire de tête (on
+	// s'arrête au premier segment fichier ou pipe). whole = true si toute la
+	// file est couverte.
+	int fillIovec(struct iovec *iov, int max, bool &whole) const;
+
+	// Segment fichier en tête ? (fd, offset courant, octets restants)
+	bool frontFile(int &fd, off_t &offset, std::size_t &left) const;
+
+	// Segment pipe en tête ? (fd du pipe, octets restants)
+	bool frontPipe(int &fd, std::size_t &left) const;
+	// Un segment pipe attend encore dans la file.
+	bool hasPipe() const;
+
+	// Marque n octets comme envoyés (n <= pending()).
+	void consume(std::size_t n);
+
+private:
+	// La copie (ResponseSlot dans un std::deque) n'est faite que sur des
+	// queues vides : une queue avec un segment fichier ou partagé tient
+	// une référence.
+	OutputQueue &operator=(const OutputQueue &);
+
+	struct Segment
+	{
+		std::string data;
+		std::size_t offset;   // octets déjà envoyés dans ce segment
+		ResponseCache::Entry *cached; // non NULL : octets [offset, end) de l'entrée
+		std::size_t end;
+		OpenFileCache::Entry *file;  // NULL : segment mémoire
+		off_t       fileOffset;
+		std::size_t fileLeft;         // (segment pipe : octets restants)
+		int         pipeFd;           // >= 0 : segment pipe
+
+		Segment();
+
+		const char *bytes() const;   // prochain octet à envoyer
+		std::size_t left() const;    // octets mémoire restants
+	};
+
+	std::deque<Segment> _segments;
+	std::size_t         _pending;
+	std::size_t         _pipes;     // segments pipe dans la file
+};
+
+#endif // OUTPUTQUEUE_HPP
@@ -0,0 +1,111 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Poller.hpp                                         :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef POLLER_HPP
+# define POLLER_HPP
+
+# include <vector>
+# include <string>
+# include <poll.h>
+
+# ifdef __linux__
+#  include <sys/epoll.h>
+#  define WEBSERV_HAVE_EPOLL 1
+# endif
+
+/*
+    Poller
+
+    Abstraction du multiplexeur d'I/O utilisé par la boucle du WebServer.
+
+    Deux backends :
+      - BACKEND_POLL  : poll() classique, level-triggered. Le coût d'un tour
+                        de boucle est proportionnel au nombre de fds suivis.
+      - BACKEND_EPOLL : epoll en edge-triggered (Linux uniquement). wait()
+                        ne renvoie QUE les fds prêts.
+
+    Dans les deux cas, wait() remplit un vecteur d'Event (fd + masque) :
+    la boucle ne parcourt jamais les fds inactifs.
+
+    IMPORTANT (edge-triggered) : un fd n'est re-signalé que lorsqu'un nouvel
+    événement arrive. Les handlers doivent donc lire / écrire / accepter
+    jusqu'à EAGAIN. C'est aussi correct en poll(), donc on le fait toujours.
+*/
+
+class Poller
+{
+public:
+	enum Backend
+	{
+		BACKEND_POLL,
+		BACKEND_EPOLL
+	};
+
+	enum
+	{
+		EV_READ  = 1,
+		EV_WRITE = 2,
+		EV_ERROR = 4   // POLLERR / POLLHUP / POLLNVAL (ou équivalents epoll)
+	};
+
+	struct Event
+	{
+		int      fd;
+		unsigned events;
+	};
+
+	explicit Poller(Backend backend);
+	~Poller();
+
+	// Backend réellement utilisé (epoll peut retomber sur poll hors Linux).
+	Backend getBackend() const;
+	const char *getBackendName() const;
+
+	// "epoll" / "poll" -> Backend. Retourne false si le nom est inconnu.
+	static bool parseBackend(const std::string &name, Backend &out);
+	static Backend defaultBackend();
+
+	void add(int fd, unsigned events);
+	void modify(int fd, unsigned events);
+	void remove(int fd);
+
+	bool empty() const;
+	std::size_t size() const;
+
+	// Attend des événements (timeoutMs < 0 => infini).
+	// Retourne le nombre d'événements, 0 sur timeout, -1 sur erreur
+	// (EINTR est traité comme un timeout).
+	int wait(std::vector<Event> &out, int timeoutMs);
+
+private:
+	Poller(const Poller &);
+	Poller &operator=(const Poller &);
+
+	Backend                    _backend;
+	std::size_t                _count;
+
+	// Masque d'intérêt courant, indexé par fd (0 = non suivi).
+	// Permet d'éviter les epoll_ctl(MOD) inutiles.
+	std::vector<unsigned>      _interest;
+
+	// --- backend poll ---
+	std::vector<struct pollfd> _pollFds;
+	std::vector<int>           _pollIndex;   // fd -> index dans _pollFds (-1)
+
+	// --- backend epoll ---
+	int                        _epollFd;
+# ifdef WEBSERV_HAVE_EPOLL
+	std::vector<struct epoll_event> _epollEvents;
+# endif
+};
+
+#endif // POLLER_HPP
@@ -0,0 +1,225 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ProxyConnection.hpp                                :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef PROXYCONNECTION_HPP
+# define PROXYCONNECTION_HPP
+
+# include <string>
+# include <map>
+# include <vector>
+# include <utility>
+# include <cstddef>
+
+# include "CgiOutput.hpp"
+# include "TimerWheel.hpp"
+
+struct CgiJob;
+class ProxyConnection;
+
+/*
+    ProxyRequest
+
+    Une requête relayée vers un backend HTTP (proxy_pass). La connexion
+    traduit la réponse en sortie CGI (CgiOutput) : "Status: code raison",
+    les headers de bout en bout (sans les hop-by-hop), une ligne vide,
+    puis le body décodé (plus de chunked). La boucle la streame ensuite
+    comme celle d'un script.
+
+    Détruite avant la fin de la réponse (client parti, timeout), elle
+    rend la connexion inutilisable : le reste de la réponse ne sera
+    jamais lu.
+
+    La requête (méthode, cible, headers, body) est gardée jusqu'au
+    premier octet de réponse : elle peut repartir sur une autre
+    connexion (resubmit()).
+*/
+
+class ProxyRequest : public CgiOutput
+{
+public:
+	ProxyRequest();
+	~ProxyRequest();
+
+	// Réponse complète, framing respecté (sinon le motif est loggé).
+	bool succeeded() const;
+
+	// Connexion qui porte la requête, NULL une fois terminée.
+	ProxyConnection *connection() const;
+
+	// Méthode idempotente ou requête sans body : peut être rejouée.
+	bool replayable() const;
+
+	CgiJob *job;              // propriétaire (WebServer)
+
+private:
+	ProxyRequest(const ProxyRequest &);
+	ProxyRequest &operator=(const ProxyRequest &);
+
+	friend class ProxyConnection;
+
+	ProxyConnection *_conn;
+	bool             _failed;
+	std::string      _error;    // motif de l'échec (log)
+
+	// Requête envoyée, pour un nouvel essai (body libéré dès la réponse)
+	std::string      _method;
+	std::string      _target;
+	std::map<std::string, std::string> _headers;
+	std::string      _body;
+};
+
+/*
+    ProxyConnection
+
+    Une connexion HTTP/1.1 persistante vers un backend, socket Unix ou
+    TCP non bloquante, pilotée par la boucle ; une requête à la fois :
+
+      - submit() écrit la ligne de requête, les headers du client (sans
+        les hop-by-hop), Content-Length et le body dans le buffer
+        d'écriture ; flush() l'envoie jusqu'à EAGAIN (EV_WRITE) ;
+      - readResponse() lit la socket et découpe la réponse : status line
+        (les 1xx sont ignorées), headers, puis body par Content-Length,
+        en chunked, ou jusqu'à la fermeture ;
+      - réponse terminée : la connexion revient au repos, réutilisable si
+        le backend garde la connexion (reusable()).
+
+    Backpressure : pause() arrête la lecture tant que le client est trop
+    lent ; le backend bloque alors sur sa socket pleine.
+*/
+
+class ProxyConnection
+{
+public:
+	typedef std::map<std::string, std::string> HeaderMap;
+
+	enum ReadResult
+	{
+		READ_WAIT,   // socket vide (EAGAIN) : attendre EV_READ
+		READ_MORE,   // limite atteinte : il peut rester des octets
+		READ_EOF     // connexion fermée, erreur ou réponse invalide
+	};
+
+	explicit ProxyConnection(const std::string &address);
+	~ProxyConnection();
+
+	// socket() + connect() non bloquant ; false si l'échec est immédiat.
+	bool open();
+
+	int fd() const;
+	const std::string &address() const;
+
+	bool idle() const;              // aucune requête en cours
+	bool broken() const;
+	// Au repos et gardée ouverte par le backend : peut resservir.
+	bool reusable() const;
+	// A déjà porté une requête avant celle en cours (sortie du pool).
+	bool reused() const;
+	// connect() pas (encore) abouti : rien n'est parti.
+	bool connecting() const;
+	// Requête en cours sans aucun octet de réponse reçu.
+	bool untouched() const;
+	ProxyRequest *current() const;
+
+	// Nouvelle requête (la connexion doit être au repos). headers : ceux
+	// du client, noms en minuscules.
+	void submit(ProxyRequest &req, const std::string &method,
+	            const std::string &target, const HeaderMap &headers,
+	            const std::string &body);
+	// Requête retirée d'une autre connexion (withdraw()), renvoyée telle
+	// quelle sur celle-ci (au repos).
+	void resubmit(ProxyRequest &req);
+	// Retire la requête en cours sans la faire échouer (elle repart
+	// ailleurs) ; la connexion ne sert plus.
+	ProxyRequest *withdraw();
+
+	// Connexion en cours ou octets en attente : surveiller EV_WRITE.
+	bool wantsWrite() const;
+	// Termine le connect() et écrit jusqu'à EAGAIN ; false si la
+	// connexion est perdue.
+	bool flush();
+
+	// Lit au plus limit octets ; touched = la requête qui a reçu des
+	// données ou sa fin (sinon NULL).
+	ReadResult readResponse(std::size_t limit, ProxyRequest *&touched);
+
+	// Connexion perdue : la requête en cours se termine en échec (rendue
+	// pour être livrée, sinon NULL).
+	ProxyRequest *fail();
+
+	void pause();
+	void resume();
+	bool paused() const;
+
+	TimerNode timer;                // timeout de la requête (clé : fd)
+	bool      dispatching;          // réponse en cours de traitement :
+	                                // l'appelant ne doit pas la fermer
+
+private:
+	ProxyConnection(const ProxyConnection &);
+	ProxyConnection &operator=(const ProxyConnection &);
+
+	friend class ProxyRequest;
+
+	typedef std::vector<std::pair<std::string, std::string> > FieldList;
+
+	enum State
+	{
+		ST_IDLE,         // pas de requête : aucun octet attendu
+		ST_STATUS,       // status line
+		ST_HEADER,       // lignes de headers
+		ST_LENGTH,       // body de Content-Length octets
+		ST_CHUNK_SIZE,   // taille d'un chunk (hex)
+		ST_CHUNK_DATA,
+		ST_CHUNK_END,    // CRLF après les données du chunk
+		ST_TRAILER,      // trailers après le chunk 0 (ignorés)
+		ST_CLOSE         // body jusqu'à la fermeture
+	};
+
+	void send(ProxyRequest &req);
+	void detach(ProxyRequest &req);
+	bool consume(const char *data, std::size_t len);
+	bool takeLine(const char *&data, std::size_t &len, std::string &line);
+	bool handleLine(const std::string &line);
+	bool endHeaders();
+	void complete();
+	void error(const std::string &reason);
+
+	int           _fd;
+	std::string   _address;
+	bool          _connecting;
+	bool          _broken;
+	bool          _keepAlive;      // le backend garde la connexion
+	bool          _paused;
+
+	std::string   _wbuf;            // requête à envoyer
+	std::size_t   _wOff;
+	std::string   _line;            // ligne incomplète (status, header, chunk)
+
+	ProxyRequest *_req;
+	std::size_t   _requests;        // requêtes portées (reused())
+	std::size_t   _received;        // octets reçus pour la requête en cours
+	State         _state;
+	std::size_t   _left;            // octets de body (ou du chunk) attendus
+
+	// Réponse en cours de lecture
+	int           _status;
+	std::string   _reason;
+	FieldList     _fields;          // headers reçus, dans l'ordre
+	std::size_t   _headerBytes;
+	bool          _http11;
+	bool          _chunked;
+	bool          _hasLength;
+	std::size_t   _length;
+	std::string   _connection;      // valeur du header Connection
+};
+
+#endif // PROXYCONNECTION_HPP
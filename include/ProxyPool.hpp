@@ -0,0 +1,61 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ProxyPool.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef PROXYPOOL_HPP
+# define PROXYPOOL_HPP
+
+# include <string>
+# include <vector>
+# include <map>
+# include <cstddef>
+
+# include "ProxyConnection.hpp"
+
+/*
+    ProxyPool
+
+    Connexions keep-alive vers les backends HTTP, par adresse (valeur de
+    proxy_pass). Un pool par boucle d'événements (reactor) : pas de lock,
+    chaque connexion n'est vue que par un thread.
+
+      - find() : une connexion au repos réutilisable (la plus récente
+        d'abord), sinon NULL ; une connexion fermée par le backend
+        pendant son repos est vue par la boucle (EOF) et retirée ;
+      - open() : nouvelle connexion quand aucune n'est libre ;
+      - idle() permet à l'appelant de borner les connexions au repos.
+*/
+
+class ProxyPool
+{
+public:
+	ProxyPool();
+	~ProxyPool();
+
+	ProxyConnection *find(const std::string &address);
+	// NULL si la connexion ne peut pas être ouverte.
+	ProxyConnection *open(const std::string &address);
+	// Ferme et détruit la connexion (l'appelant l'a retirée du Poller).
+	void close(ProxyConnection *conn);
+
+	// Connexions au repos vers address.
+	std::size_t idle(const std::string &address) const;
+
+private:
+	ProxyPool(const ProxyPool &);
+	ProxyPool &operator=(const ProxyPool &);
+
+	typedef std::map<std::string, std::vector<ProxyConnection *> > ConnMap;
+
+	ConnMap _conns;
+};
+
+#endif // PROXYPOOL_HPP
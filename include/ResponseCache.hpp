@@ -0,0 +1,114 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ResponseCache.hpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef RESPONSECACHE_HPP
+# define RESPONSECACHE_HPP
+
+# include <string>
+# include <map>
+# include <cstddef>
+# include <ctime>
+# include <sys/types.h>
+
+# include "Mutex.hpp"
+# include "OpenFileCache.hpp"
+
+/*
+    ResponseCache
+
+    Cache des réponses statiques déjà sérialisées (status line, headers,
+    body) pour les petits fichiers, partagé par tous les threads.
+
+    Une entrée contient les octets prêts à envoyer :
+
+        HTTP/1.1 200 OK\r\n ... Content-Length: N\r\n | \r\n <body>
+                                                      ^
+                                                   headLen
+
+    Les headers propres à la connexion (Connection, Keep-Alive) sont
+    insérés à headLen au moment de l'envoi : l'OutputQueue envoie
+    [0, headLen) + headers connexion + [headLen, fin) avec writev(),
+    sans copie.
+
+      - lookup(key, file) : entrée référencée, ou NULL si absente ou si
+        le fichier a changé (taille, mtime, inode comparés aux
+        métadonnées de l'OpenFileCache) ;
+      - insert(key, file, bytes, headLen) : ajoute (bytes est vidé par
+        swap) et renvoie l'entrée référencée ;
+      - release(entry) : rend la référence. Une entrée évincée reste en
+        vie tant qu'une réponse en cours d'envoi la tient.
+
+    Budget : la somme des tailles des entrées en table ne dépasse pas
+    maxBytes (éviction LRU). Les fichiers de plus de maxEntrySize octets
+    ne sont pas mis en cache (envoyés avec sendfile).
+*/
+
+class ResponseCache
+{
+public:
+	struct Entry
+	{
+		// --- Lecture seule pour l'appelant (tant qu'il tient une référence) ---
+		std::string     bytes;
+		std::size_t     headLen;     // position de la ligne vide finale
+
+		// --- Interne ---
+		std::string     key;
+		ResponseCache  *cache;
+		dev_t           dev;
+		ino_t           ino;
+		off_t           size;
+		std::time_t     mtime;
+		volatile int    refs;
+		bool            cached;      // encore dans la table
+		Entry          *lruPrev;     // vers plus récent
+		Entry          *lruNext;     // vers plus ancien
+
+		Entry();
+	};
+
+	ResponseCache(std::size_t maxBytes, std::size_t maxEntrySize);
+	~ResponseCache();
+
+	bool        enabled() const;
+	std::size_t maxEntrySize() const;
+
+	Entry *lookup(const std::string &key, const OpenFileCache::Entry &file);
+	Entry *insert(const std::string &key, const OpenFileCache::Entry &file,
+	              std::string &bytes, std::size_t headLen);
+
+	// Référence supplémentaire : l'appelant en tient déjà une.
+	static void retain(Entry *entry);
+	// Rend une référence (thread-safe). NULL accepté.
+	static void release(Entry *entry);
+
+private:
+	ResponseCache(const ResponseCache &);
+	ResponseCache &operator=(const ResponseCache &);
+
+	typedef std::map<std::string, Entry *> EntryMap;
+
+	void detach(Entry *entry);
+	void lruUnlink(Entry *entry);
+	void lruPushFront(Entry *entry);
+
+	Mutex           _mutex;
+	EntryMap        _entries;
+	Entry          *_lruHead;    // plus récent
+	Entry          *_lruTail;    // plus ancien
+
+	std::size_t     _maxBytes;
+	std::size_t     _maxEntrySize;
+	std::size_t     _bytes;      // taille des entrées en table
+};
+
+#endif // RESPONSECACHE_HPP
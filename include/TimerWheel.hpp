@@ -0,0 +1,94 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   TimerWheel.hpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef TIMERWHEEL_HPP
+# define TIMERWHEEL_HPP
+
+# include <vector>
+# include <cstddef>
+
+/*
+    TimerWheel
+
+    Roue de timers hiérarchique (4 niveaux de 64 cases, tick de 10 ms),
+    sur une horloge monotone en millisecondes.
+
+      - niveau 0 : échéances dans les 64 prochains ticks (~640 ms)
+      - niveau 1 : < 64^2 ticks (~41 s), niveau 2 : < 64^3 (~44 min), ...
+      - quand le niveau 0 fait un tour, la case suivante du niveau 1 est
+        "cascadée" (redistribuée plus bas), etc.
+
+    schedule / cancel : O(1) (liste doublement chaînée intrusive).
+    advance           : O(timers échus) + O(ticks écoulés).
+    nextTimeout       : délai avant la prochaine case non vide, utilisé
+                        comme timeout de poll / epoll_wait.
+
+    Les TimerNode appartiennent à l'appelant (ex : ClientState) et ne
+    doivent pas être déplacés tant qu'ils sont armés.
+*/
+
+struct TimerNode
+{
+	TimerNode      *prev;
+	TimerNode      *next;
+	unsigned long   expires;   // échéance (ms, horloge monotone)
+	int             fd;        // clé : connexion propriétaire du timer
+	bool            armed;
+
+	TimerNode();
+};
+
+class TimerWheel
+{
+public:
+	TimerWheel();
+	~TimerWheel();
+
+	// Horloge monotone en ms (CLOCK_MONOTONIC).
+	static unsigned long monotonicMs();
+
+	// (Re)arme node pour l'instant expiresMs.
+	void schedule(TimerNode &node, unsigned long expiresMs);
+	void cancel(TimerNode &node);
+
+	bool        empty() const;
+	std::size_t size() const;
+
+	// Avance la roue jusqu'à nowMs ; les timers échus sont désarmés et
+	// ajoutés à expired.
+	void advance(unsigned long nowMs, std::vector<TimerNode *> &expired);
+
+	// Délai (ms) avant la prochaine échéance possible, -1 si aucun timer.
+	int nextTimeout(unsigned long nowMs) const;
+
+private:
+	TimerWheel(const TimerWheel &);
+	TimerWheel &operator=(const TimerWheel &);
+
+	enum
+	{
+		LEVELS    = 4,
+		SLOT_BITS = 6,
+		SLOTS     = 1 << SLOT_BITS,
+		SLOT_MASK = SLOTS - 1
+	};
+
+	void link(TimerNode &node, unsigned long minTick);
+	void cascade(int level, unsigned long index);
+
+	// Sentinelles des listes circulaires, une par case
+	TimerNode       _slots[LEVELS][SLOTS];
+	unsigned long   _current;   // dernier tick traité
+	std::size_t     _count;     // timers armés
+};
+
+#endif // TIMERWHEEL_HPP
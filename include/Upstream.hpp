@@ -0,0 +1,105 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Upstream.hpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef UPSTREAM_HPP
+# define UPSTREAM_HPP
+
+# include <string>
+# include <vector>
+# include <utility>
+# include <cstddef>
+
+# include "Config.hpp"
+# include "Mutex.hpp"
+
+/*
+    Upstream
+
+    Un bloc upstream à l'exécution : choix du serveur pour chaque requête
+    proxy_pass / fastcgi_pass, et santé passive des serveurs.
+
+      - select() choisit un serveur selon la politique du bloc et le
+        compte en cours ; release() le rend à la fin de la requête ;
+      - round-robin pondéré "lisse" : un serveur de poids 2 reçoit deux
+        requêtes sur trois, sans rafale ;
+      - least_conn : le moins de requêtes en cours rapportées au poids
+        (égalité : au suivant, en tournant) ;
+      - hash : anneau de hachage cohérent (points virtuels par serveur,
+        proportionnels au poids) ; une même URI ou IP retombe sur le même
+        serveur, et retirer un serveur ne déplace que ses clés ;
+      - report() : max_fails échecs (connexion refusée, réponse invalide,
+        timeout) en fail_timeout secondes écartent le serveur pendant
+        fail_timeout secondes ; un succès remet son compte à zéro. Tous
+        écartés : on les essaie quand même (reprise rapide plutôt que 502) ;
+      - tried : serveurs déjà essayés pour la requête, jamais repris par
+        select() (hash : point suivant de l'anneau).
+
+    Partagé par tous les reactors (celui de l'acceptor) : un lock.
+*/
+
+class Upstream
+{
+public:
+	explicit Upstream(const UpstreamConfig &config);
+	~Upstream();
+
+	const std::string &name() const;
+	std::size_t size() const;
+	const std::string &address(std::size_t peer) const;
+
+	// Serveur pour cette requête (compté en cours), hors de tried, où il
+	// est ajouté. uri / clientIp : clés de hash $request_uri /
+	// $remote_addr (IPv4, ordre réseau).
+	std::size_t select(const std::string &uri, unsigned int clientIp,
+	                   unsigned long now, std::vector<bool> &tried);
+	// Requête terminée (ou abandonnée) sur ce serveur.
+	void release(std::size_t peer);
+	// Issue de la requête : un échec peut écarter le serveur.
+	void report(std::size_t peer, bool ok, unsigned long now);
+
+private:
+	Upstream(const Upstream &);
+	Upstream &operator=(const Upstream &);
+
+	struct Peer
+	{
+		std::string   address;
+		unsigned      weight;
+		unsigned      maxFails;
+		unsigned long failTimeout;   // ms
+		long          current;       // round-robin pondéré
+		std::size_t   active;        // requêtes en cours
+		unsigned      fails;         // échecs depuis failStart
+		unsigned long failStart;
+		unsigned long downUntil;     // écarté jusqu'à (0 : disponible)
+	};
+
+	typedef std::vector<std::pair<unsigned int, std::size_t> > Ring;
+
+	bool available(std::size_t peer, const std::vector<bool> &tried,
+	               unsigned long now, bool all) const;
+	std::size_t pickRoundRobin(const std::vector<bool> &tried,
+	                           unsigned long now, bool all);
+	std::size_t pickLeastConn(const std::vector<bool> &tried,
+	                          unsigned long now, bool all);
+	std::size_t pickHash(unsigned int key, const std::vector<bool> &tried,
+	                     unsigned long now, bool all) const;
+
+	std::string             _name;
+	UpstreamConfig::Balance _balance;
+	std::vector<Peer>       _peers;
+	Ring                    _ring;     // (hash, serveur), trié
+	std::size_t             _next;     // least_conn : départ du tour
+	Mutex                   _mutex;
+};
+
+#endif // UPSTREAM_HPP
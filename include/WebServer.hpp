@@ -2,62 +2,324 @@
 # define WEBSERVER_HPP
 
 # include <vector>
+# include <deque>
 # include <map>
 # include <set>
 # include <string>
-# include <poll.h>
 # include <cerrno>
-# include <ctime>  // std::time_t
 
 # include "Config.hpp"
 # include "HttpRequest.hpp"
 # include "HttpResponse.hpp"
+# include "Poller.hpp"
+# include "Mutex.hpp"
+# include "TimerWheel.hpp"
+# include "OutputQueue.hpp"
+# include "OpenFileCache.hpp"
+# include "ResponseCache.hpp"
+# include "CgiProcess.hpp"
+# include "FastCgiPool.hpp"
+# include "ProxyPool.hpp"
+# include "CgiPool.hpp"
+# include "CgiLimiter.hpp"
+# include "Upstream.hpp"
+
+struct CgiJob;
+class Compressor;
+
+/*
+ * ResponseSlot :
+ *  - une réponse en attente d'envoi sur une connexion.
+ *  - pipelining : les requêtes déjà reçues sont toutes traitées, et
+ *    leurs réponses partent dans l'ordre. Seuls les slots prêts en tête
+ *    de file sont envoyés (plusieurs à la fois avec writev()).
+ */
+struct ResponseSlot
+{
+	bool        ready;       // réponse complète, peut être envoyée
+	bool        closeAfter;  // fermer la connexion après l'envoi
+	std::string keepAlive;   // valeur du header Keep-Alive (si !closeAfter)
+	CgiJob     *cgi;         // CGI en cours qui produira cette réponse
+	OutputQueue out;         // segments à envoyer (headers, body)
+
+	ResponseSlot();
+};
 
 /*
  * ClientState :
  *  - représente l'état d'une connexion cliente
  *  - on y garde : le server cible, la requête en cours,
  *    le buffer lu, le buffer à écrire, etc.
- *  - gère aussi le chunked et un timeout (lastActivity).
+ *  - gère aussi le chunked et un timeout (lastActivity + timer).
+ *  - keep-alive / pipelining : dès qu'une réponse est mise en file,
+ *    resetForNextRequest() remet la requête à zéro et on continue à
+ *    parser readBuffer (qui peut contenir les requêtes suivantes).
+ *
+ *  Les champs consultés à chaque événement (server, timeout, flags,
+ *  buffers) sont en tête ; la requête parsée (map de headers) en dernier.
  */
 struct ClientState
 {
 	const ServerConfig *server;      // serveur associé à cette connexion
-	HttpRequest         request;     // requête HTTP en cours
-	bool                headersComplete;
-	bool                requestHandled;
-	std::size_t         contentLength; // pour les bodies "normaux" (Content-Length)
-	std::string         readBuffer;    // octets reçus non encore traités
-	std::string         writeBuffer;   // réponse à envoyer
+	const ServerConfig *defaultServer; // "default server" du port d'écoute
+	const ServerConfig *lastServer;  // vhost de la dernière réponse : son
+	                                 // keepalive_timeout a été annoncé
+
+	// --- Timeout ---
+	unsigned long       lastActivity;     // dernière activité (ms, horloge monotone)
+	int                 idleTimeout;      // secondes d'inactivité tolérées
+	TimerNode           timer;            // échéance dans la TimerWheel
+	unsigned int        clientIp;         // IPv4, ordre réseau (hash $remote_addr)
 
-	// --- Gestion du Transfer-Encoding: chunked ---
+	bool                headersComplete;
 	bool                isChunked;        // true si on a "Transfer-Encoding: chunked"
+	bool                closing;          // une réponse "Connection: close" est en file
+	bool                inputPaused;      // trop de réponses en attente : on ne lit plus
+	bool                peerClosed;       // EOF reçu : fermer une fois les réponses parties
+	std::size_t         requestsServed;   // requêtes déjà traitées (keep-alive)
+	std::size_t         contentLength; // pour les bodies "normaux" (Content-Length)
 	std::size_t         currentChunkSize; // taille du chunk qu'on est en train de lire
+
+	std::string         readBuffer;    // octets reçus non encore traités
+	std::deque<ResponseSlot> responses; // réponses à envoyer, dans l'ordre
 	std::string         chunkDecodedBody; // body reconstruit après déchunk
 
-	// --- Timeout ---
-	std::time_t         lastActivity;     // dernière activité (lecture/écriture)
+	HttpRequest         request;     // requête HTTP en cours
 
 	ClientState();
+
+	// Remet l'état à zéro et libère les buffers.
+	void clear();
+
+	// Prépare la requête suivante sur la même connexion
+	// (on garde readBuffer : il peut déjà contenir la requête suivante).
+	void resetForNextRequest();
+};
+
+/*
+ * CgiJob :
+ *  - un CGI lancé pour une requête, piloté par la boucle d'événements.
+ *  - la réponse est réservée dans la file du client (slot, ready =
+ *    false) : les réponses suivantes (pipelining) attendent derrière.
+ *  - script local (cgi) : ses fds (stdin, stdout, pidfd) sont dans la
+ *    FdTable en FD_CGI et pointent sur le job ; le timer est indexé par
+ *    le fd stdout.
+ *  - fastcgi_pass (remote) : la requête voyage sur une connexion du
+ *    FastCgiPool (FD_FASTCGI), partagée avec d'autres jobs ; le timer
+ *    de la connexion surveille les deadlines de ses jobs.
+ *  - cgi_pool (remote aussi) : même chemin, sur la connexion d'un
+ *    worker du CgiPool de la location ; en attendant un worker libre,
+ *    le job garde son environnement et son body dans la file du pool.
+ *  - proxy_pass (proxied) : la requête HTTP part sur une connexion
+ *    keep-alive du ProxyPool (FD_PROXY), une à la fois ; la réponse du
+ *    backend est traduite en sortie CGI et suit le même chemin.
+ *  - upstream (proxy_pass / fastcgi_pass vers un bloc upstream) : le
+ *    serveur choisi reste compté en cours jusqu'à la destruction du
+ *    job ; finishCgi() lui rapporte le succès ou l'échec. Une connexion
+ *    perdue avant le moindre octet de réponse (connect() refusé...)
+ *    compte un échec et la requête repart sur le serveur suivant ; un
+ *    job fastcgi_pass garde pour cela son environnement et son body.
+ *  - admission (cgi, cgi_pool) : le CgiLimiter de la location compte le
+ *    job en cours ; sans place libre, le job attend dans sa file
+ *    (waiting) avec son environnement et son body, sans être lancé.
+ *  - streaming : dès que les headers du script sont arrivés, ils
+ *    partent (slot prêt) et le body suit au fil des lectures, en
+ *    chunked, avec le Content-Length du script, ou jusqu'à la fermeture
+ *    (HTTP/1.0). Le slot garde cgi != NULL jusqu'à la fin du body.
+ *    Script local sans compression : le body va du pipe à la socket par
+ *    splice() (segments pipe de l'OutputQueue), sans copie.
+ */
+struct CgiJob
+{
+	CgiProcess            process;       // cgi : script local
+	FastCgiRequest        fastcgi;       // fastcgi_pass : application
+	ProxyRequest          proxy;         // proxy_pass : backend HTTP
+	bool                  remote;        // true : FastCGI (ou cgi_pool)
+	bool                  proxied;       // true : proxy_pass
+	CgiPool              *pool;          // cgi_pool : pool de la location
+	CgiLimiter           *limiter;       // cgi : admission de la location
+	Upstream             *upstream;      // serveur choisi dans un upstream
+	std::size_t           peer;          //   (NULL : adresse fixe)
+	std::vector<bool>     tried;         //   serveurs essayés
+	std::string           uri;           //   clés de select() pour le
+	unsigned int          clientIp;      //   serveur suivant
+	bool                  waiting;       // dans la file du limiter
+	std::string           scriptPath;    // requête en file (limiter,
+	std::vector<std::string> env;        //   cgi_pool), lancée quand
+	std::string           input;         //   une place se libère
+	int                   clientFd;      // connexion propriétaire
+	ResponseSlot         *slot;          // réponse réservée
+	const ServerConfig   *server;
+	const LocationConfig *loc;
+	std::string           acceptEncoding; // pour la compression
+	bool                  chunkedOk;     // client HTTP/1.1
+	unsigned long         deadline;      // CGI_TIMEOUT_SECONDS (ms)
+	TimerNode             timer;
+
+	// --- Streaming ---
+	bool                  streaming;     // headers envoyés, le body suit
+	bool                  splice;        // body en splice() pipe -> socket
+	bool                  paused;        // client lent : pipe plus lu
+	bool                  chunked;       // Transfer-Encoding: chunked
+	bool                  discardBody;   // 1xx / 204 / 304 : pas de body
+	bool                  lengthKnown;   // Content-Length du script
+	std::size_t           bodyLeft;      // octets encore attendus
+	Compressor           *compressor;    // compression à la volée
+
+	CgiJob();
+	~CgiJob();
+
+	// Sortie du programme : locale, FastCGI ou backend HTTP.
+	CgiOutput &output();
+
+private:
+	CgiJob(const CgiJob &);
+	CgiJob &operator=(const CgiJob &);
 };
 
+/*
+ * FdSlot :
+ *  - une case de la table des fds (indexée directement par le fd)
+ *  - kind  : FD_FREE / FD_LISTENER / FD_CLIENT / FD_WAKEUP / FD_CGI /
+ *            FD_FASTCGI / FD_PROXY
+ *  - state : état de la connexion. Pour une socket d'écoute, seul
+ *            state.server est utilisé (le "server par défaut" du port).
+ *  - cgi   : pour FD_CGI, le job auquel appartient le pipe / pidfd.
+ *  - fastcgi : pour FD_FASTCGI, la connexion (appartient au FastCgiPool,
+ *            ou au CgiPool cgiPool pour un worker cgi_pool).
+ *  - proxy : pour FD_PROXY, la connexion (appartient au ProxyPool).
+ */
+struct FdSlot
+{
+	enum Kind
+	{
+		FD_FREE = 0,
+		FD_LISTENER,
+		FD_CLIENT,
+		FD_WAKEUP,     // pipe de réveil d'un reactor (worker_threads)
+		FD_CGI,        // stdin / stdout / pidfd d'un CGI
+		FD_FASTCGI,    // connexion vers une application FastCGI
+		FD_PROXY       // connexion vers un backend HTTP (proxy_pass)
+	};
+
+	unsigned char      kind;
+	ClientState        state;
+	CgiJob            *cgi;
+	FastCgiConnection *fastcgi;
+	CgiPool           *cgiPool;
+	ProxyConnection   *proxy;
+
+	FdSlot();
+};
+
+/*
+ * FdTable :
+ *  - "slab" de FdSlot indexé par fd : lookup O(1), sans map.
+ *  - les cases sont allouées par pages fixes, jamais déplacées :
+ *    une référence sur un FdSlot reste valide quand la table grandit,
+ *    et une connexion n'alloue aucun noeud (la case est réutilisée).
+ */
+class FdTable
+{
+public:
+	FdTable();
+	~FdTable();
+
+	// Case du fd, ou NULL si le fd n'a jamais été vu.
+	FdSlot *get(int fd);
+
+	// Prépare la case du fd (alloue la page au besoin) et la marque kind.
+	FdSlot &acquire(int fd, unsigned char kind);
+
+	// Libère la case (FD_FREE + buffers libérés).
+	void release(int fd);
+
+	// Borne supérieure (exclue) des fds couverts par la table.
+	int limit() const;
+
+private:
+	FdTable(const FdTable &);
+	FdTable &operator=(const FdTable &);
+
+	std::vector<FdSlot *> _pages;
+};
+
+/*
+ * WebServer :
+ *  - une boucle d'événements (Poller + FdTable).
+ *
+ *  Mode worker_threads N (N > 1) :
+ *    - le WebServer principal (ROLE_ACCEPTOR) garde les sockets d'écoute
+ *      et ne fait qu'accepter ;
+ *    - il crée N WebServer en ROLE_REACTOR, chacun dans son thread, avec
+ *      son propre Poller et sa propre FdTable (sa "tranche" de la table
+ *      des connexions) ;
+ *    - chaque connexion acceptée est confiée au reactor le moins chargé
+ *      (égalité => round-robin) via adoptConnection() ;
+ *    - la config (_servers) est partagée en lecture seule.
+ */
 class WebServer
 {
 public:
-	WebServer(const std::vector<ServerConfig> &servers);
+	enum Role
+	{
+		ROLE_ACCEPTOR,   // sockets d'écoute (+ reactors si worker_threads > 1)
+		ROLE_REACTOR     // pas de socket d'écoute : reçoit des connexions
+	};
+
+	WebServer(const std::vector<ServerConfig> &servers,
+	          const GlobalConfig &global,
+	          Role role = ROLE_ACCEPTOR);
 	~WebServer();
 
 	void run();
 
+	// Thread-safe : confie une connexion acceptée à ce reactor.
+	void adoptConnection(int fd, const ServerConfig *server,
+	                     unsigned int clientIp);
+
+	// Nombre de connexions gérées (lu par l'acceptor, thread-safe).
+	int activeClients();
+
 private:
 	WebServer(const WebServer &);
 	WebServer &operator=(const WebServer &);
 
+	struct Handoff
+	{
+		int                 fd;
+		const ServerConfig *server;
+		unsigned int        clientIp;
+	};
+
 	void initListeningSockets();
-	void handleNewConnection(std::size_t index);
-	void handleClientRead(std::size_t index);
-	void handleClientWrite(std::size_t index);
-	void removeClient(std::size_t index);
+	void initWakeupPipe();
+	void startReactors(const GlobalConfig &global);
+	void stopReactors();
+	static void *reactorMain(void *arg);
+	bool stopRequested();
+	WebServer *pickReactor();
+	void drainHandoffs();
+
+	void registerClient(int clientFd, const ServerConfig *server,
+	                    unsigned int clientIp);
+	void markListenerReady(int listenFd);
+	void acceptPendingConnections();
+	int  handleNewConnection(int listenFd);
+	void handleClientRead(int fd);
+	void handleClientWrite(int fd);
+	void removeClient(int fd);
+	bool closeIfDrained(int fd, ClientState &state);
+	void armClientTimer(ClientState &state);
+	void expireTimers();
+
+	void processClientInput(int fd, ClientState &state);
+	bool wantsKeepAlive(const ClientState &state) const;
+	void queueResponse(ClientState &state,
+	                   HttpResponse &response, bool keepAlive);
+	ResponseSlot &openResponseSlot(ClientState &state, bool keepAlive);
+	void fillResponseSlot(ResponseSlot &slot, HttpResponse &response);
+	void updateClientEvents(int fd, ClientState &state);
 
 	const LocationConfig *findLocationForTarget(const ServerConfig &server,
 	                                            const std::string &target) const;
@@ -67,9 +329,92 @@ private:
 	std::string generateAutoindexPage(const std::string &dirPath,
 	                                  const std::string &urlPath) const;
 
+	// CGI : la réponse n'est pas construite ici, le job lancé est
+	// renvoyé dans cgi (la réponse suivra, sans bloquer la boucle).
 	void buildHttpResponse(const ServerConfig &server,
 	                       const HttpRequest &request,
-	                       HttpResponse &response);
+	                       unsigned int clientIp,
+	                       HttpResponse &response,
+	                       CgiJob *&cgi);
+
+	// --- CGI asynchrone ---
+	CgiJob *startCgi(const HttpRequest &request,
+	                 const ServerConfig &server,
+	                 const LocationConfig *loc,
+	                 const std::string &scriptPath,
+	                 HttpResponse &response);
+	bool runCgi(CgiJob *job);
+	void respondCgi(CgiJob *job, HttpResponse &response);
+	void queueCgi(int fd, ClientState &state, CgiJob *job, bool keepAlive);
+	void watchCgiFd(int fd, CgiJob *job, unsigned events);
+	void unwatchCgiFd(int fd);
+	void handleCgiEvent(int fd);
+	void pumpCgiOutput(CgiJob *job);
+	void startCgiStream(CgiJob *job);
+	void forwardCgiOutput(CgiJob *job);
+	bool spliceCgiOutput(CgiJob *job);
+	void resumeCgi(CgiJob *job);
+	void progressCgi(CgiJob *job);
+	void finishCgi(CgiJob *job, bool timedOut);
+	void endCgiStream(CgiJob *job, bool ok);
+	void destroyCgi(CgiJob *job);
+	void abortClientCgi(ClientState &state);
+	void deliverCgiOutput(CgiJob *job);
+	void pauseCgi(CgiJob *job);
+
+	// --- FastCGI (fastcgi_pass) ---
+	CgiJob *startFastCgi(const HttpRequest &request,
+	                     const ServerConfig &server,
+	                     const LocationConfig *loc,
+	                     const std::string &scriptPath,
+	                     unsigned int clientIp);
+	FastCgiConnection *connectFastCgi(const std::string &address);
+	void handleFastCgiEvent(int fd, unsigned events);
+	bool readFastCgi(FastCgiConnection *conn);
+	void expireFastCgi(FastCgiConnection *conn);
+	void armFastCgiTimer(FastCgiConnection *conn, unsigned long deadline);
+	void updateFastCgiEvents(FastCgiConnection *conn);
+	bool releaseFastCgi(FastCgiConnection *conn);
+	void closeFastCgi(FastCgiConnection *conn);
+	bool retryFastCgi(FastCgiConnection *conn, CgiJob *job);
+
+	// --- Reverse proxy (proxy_pass) ---
+	CgiJob *startProxy(const HttpRequest &request,
+	                   const ServerConfig &server,
+	                   const LocationConfig *loc,
+	                   unsigned int clientIp);
+	ProxyConnection *connectProxy(const std::string &address);
+	ProxyConnection *openProxy(const std::string &address);
+	void handleProxyEvent(int fd, unsigned events);
+	bool readProxy(ProxyConnection *conn);
+	void expireProxy(ProxyConnection *conn);
+	void updateProxyEvents(ProxyConnection *conn);
+	bool releaseProxy(ProxyConnection *conn);
+	void closeProxy(ProxyConnection *conn);
+	bool retryProxy(ProxyConnection *conn);
+
+	// --- Groupes de serveurs (upstream) ---
+	Upstream *upstreamFor(const LocationConfig &loc);
+	bool nextPeer(CgiJob *job);
+
+	// --- Pool d'interpréteurs (cgi_pool) ---
+	CgiPool *cgiPoolFor(const LocationConfig &loc);
+	void startCgiPools();
+	void startPooledCgi(CgiJob *job);
+	FastCgiConnection *spawnCgiWorker(CgiPool *pool);
+	void dispatchCgiPool(CgiPool *pool);
+
+	// --- Admission des CGI (cgi_max_concurrency, cgi_queue_*) ---
+	CgiLimiter *cgiLimiterFor(const LocationConfig &loc);
+	bool rejectCgi(const ServerConfig &server, const LocationConfig *loc,
+	               HttpResponse &response);
+	void setCgiBusyResponse(const ServerConfig &server, CgiLimiter *limiter,
+	                        HttpResponse &response);
+	void releaseCgiSlot(WebServer *owner, CgiLimiter *limiter);
+	void admitQueuedCgi(CgiLimiter *limiter);
+	void armCgiQueueTimer();
+	void expireCgiQueues();
+	void serveCgiStatus(HttpResponse &response);
 
 	std::string getMimeType(const std::string &path) const;
 
@@ -78,6 +423,27 @@ private:
 	                      int code,
 	                      const std::string &reason);
 
+	// Body fichier via l'OpenFileCache (false si pas un fichier lisible).
+	bool openFileBody(const std::string &path, HttpResponse &response);
+	// Fichier statique en 200 (ou 304 si requête conditionnelle) : depuis
+	// le ResponseCache si possible (false si pas un fichier lisible).
+	bool serveStaticFile(const HttpRequest &request,
+	                     const LocationConfig *loc,
+	                     const std::string &path,
+	                     HttpResponse &response);
+	void cacheResponse(ResponseCache *cache, const std::string &key,
+	                   const OpenFileCache::Entry &file,
+	                   HttpResponse &response);
+	// compress on : gzip / deflate d'un body dynamique (CGI, autoindex).
+	void compressBody(const std::string &acceptEncoding,
+	                  const LocationConfig *loc,
+	                  HttpResponse &response);
+	// Range / If-Range sur un fichier statique (206 / 416).
+	bool serveRanges(const HttpRequest &request,
+	                 OpenFileCache::Entry *file,
+	                 const std::string &mime,
+	                 HttpResponse &response);
+
 	// --- NOUVEAU ---
 	// Sélectionne le bon server (virtual host) en fonction du header Host:
 	// parmi tous les ServerConfig qui écoutent sur le même port.
@@ -85,12 +451,77 @@ private:
 	                                           const ServerConfig &defaultServer) const;
 
 private:
-	std::vector<ServerConfig>           _servers;
-	std::vector<struct pollfd>          _pollFds;
-	std::map<int, ClientState>          _clients;
+	// Config partagée (lecture seule) : le vecteur appartient à Config,
+	// qui vit pendant toute l'exécution. Tous les reactors pointent dessus.
+	const std::vector<ServerConfig>    &_servers;
+	Role                                _role;
+	bool                                _reusePort;  // SO_REUSEPORT (mode workers)
+	Poller                              _poller;
+	std::vector<Poller::Event>          _events;
+
+	// Caches (fichiers ouverts, réponses sérialisées), partagés par tous
+	// les reactors : ceux de l'acceptor (les reactors pointent dessus).
+	// Déclarés avant _fds : détruits après les réponses qui tiennent
+	// encore des entrées.
+	OpenFileCache                       _ownFileCache;
+	OpenFileCache                      *_fileCache;
+	ResponseCache                       _ownResponseCache;
+	ResponseCache                      *_responseCache;
+	// Variantes compressées (compress on), même si response_cache est
+	// off : un fichier n'est compressé qu'une fois par version
+	ResponseCache                       _ownVariantCache;
+	ResponseCache                      *_variantCache;
+
+	// Timeouts : roue de timers + horloge monotone mise à jour une fois
+	// par tour de boucle (pas d'appel système par recv/send).
+	TimerWheel                          _timers;
+	unsigned long                       _now;      // ms
+	std::vector<TimerNode *>            _expired;
+	std::vector<int>                    _expiredFds;
+
+	// Table des fds : sockets d'écoute (avec leur "server par défaut"
+	// pour le port) et connexions clientes.
+	FdTable                             _fds;
+	std::vector<int>                    _listenFds;
+
+	// Accept borné et équitable : listeners ayant encore des connexions
+	// en attente, servis en round-robin, _acceptBudget accept() par tour.
+	std::deque<int>                     _acceptQueue;
+	std::size_t                         _acceptBudget;
+
+	std::size_t                         _sendfileChunk; // sendfile_max_chunk
+
+	// Connexions FastCGI persistantes de cette boucle
+	FastCgiPool                         _fastcgi;
+	// Connexions keep-alive vers les backends proxy_pass (cette boucle)
+	ProxyPool                           _proxies;
+	// Interpréteurs préforkés, par location cgi_pool (cette boucle)
+	std::map<const LocationConfig *, CgiPool *> _cgiPools;
+	// Admission des scripts et compteurs, par location cgi : ceux de
+	// l'acceptor, pour tout le process (les reactors pointent dessus)
+	std::map<const LocationConfig *, CgiLimiter *> _ownCgiLimiters;
+	std::map<const LocationConfig *, CgiLimiter *> *_cgiLimiters;
+	std::map<const LocationConfig *, CgiCounters *> _ownCgiCounters;
+	std::map<const LocationConfig *, CgiCounters *> *_cgiCounters;
+	TimerNode                           _cgiQueueTimer; // files des limiters
+	volatile int                        _cgiAdmitted;   // réveil : jobs admis
+	// Blocs upstream, par nom : ceux de l'acceptor (santé des serveurs
+	// et requêtes en cours vues par tout le process)
+	std::map<std::string, Upstream *>   _ownUpstreams;
+	std::map<std::string, Upstream *>  *_upstreams;
+
+	// --- Acceptor : reactors (worker_threads) ---
+	std::vector<WebServer *>            _reactors;
+	std::size_t                         _nextReactor;   // round-robin
 
-	// Pour chaque fd d'écoute, on garde un "server par défaut" pour ce port.
-	std::map<int, const ServerConfig *> _listenFdToServer;
+	// --- Reactor : connexions reçues de l'acceptor ---
+	pthread_t                           _thread;
+	bool                                _threadStarted;
+	int                                 _wakeupPipe[2];
+	Mutex                               _handoffMutex;
+	std::vector<Handoff>                _handoffs;
+	volatile int                        _activeClients;
+	volatile int                        _stop;
 };
 
 #endif
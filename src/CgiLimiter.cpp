@@ -0,0 +1,194 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CgiLimiter.cpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "CgiLimiter.hpp"
+
+CgiCounters::CgiCounters()
+	: running(0),
+	  queued(0),
+	  started(0),
+	  rejected(0),
+	  timedOut(0)
+{
+}
+
+void CgiCounters::add(volatile long &counter, long delta)
+{
+	__sync_add_and_fetch(&counter, delta);
+}
+
+long CgiCounters::get(volatile long &counter)
+{
+	return __sync_fetch_and_add(&counter, 0);
+}
+
+CgiLimiter::CgiLimiter(std::size_t maxRunning, std::size_t queueSize,
+                       unsigned long queueTimeoutMs, CgiCounters *counters)
+	: _maxRunning(maxRunning),
+	  _queueSize(queueSize),
+	  _queueTimeout(queueTimeoutMs),
+	  _mutex(),
+	  _running(0),
+	  _queue(),
+	  _admitted(),
+	  _counters(counters)
+{
+}
+
+CgiLimiter::~CgiLimiter()
+{
+}
+
+bool CgiLimiter::saturated()
+{
+	ScopedLock lock(_mutex);
+	return _maxRunning > 0 && _running >= _maxRunning &&
+	       _queue.size() >= _queueSize;
+}
+
+void CgiLimiter::reject()
+{
+	CgiCounters::add(_counters->rejected, 1);
+}
+
+CgiLimiter::Admission CgiLimiter::enter(CgiJob *job, WebServer *owner,
+                                        unsigned long now)
+{
+	ScopedLock lock(_mutex);
+
+	if (_maxRunning == 0 || _running < _maxRunning)
+	{
+		++_running;
+		CgiCounters::add(_counters->running, 1);
+		CgiCounters::add(_counters->started, 1);
+		return RUN;
+	}
+	if (_queue.size() >= _queueSize)
+	{
+		CgiCounters::add(_counters->rejected, 1);
+		return FULL;
+	}
+
+	Waiting w;
+	w.job = job;
+	w.owner = owner;
+	w.deadline = now + _queueTimeout;
+	_queue.push_back(w);
+	CgiCounters::add(_counters->queued, 1);
+	return QUEUED;
+}
+
+// Place libre (lock tenu) : la tête de file est admise.
+WebServer *CgiLimiter::admitHead()
+{
+	if (_queue.empty() || (_maxRunning > 0 && _running >= _maxRunning))
+		return NULL;
+
+	Waiting w = _queue.front();
+	_queue.pop_front();
+	_admitted.push_back(w);
+	++_running;
+	CgiCounters::add(_counters->queued, -1);
+	CgiCounters::add(_counters->running, 1);
+	CgiCounters::add(_counters->started, 1);
+	return w.owner;
+}
+
+WebServer *CgiLimiter::finished()
+{
+	ScopedLock lock(_mutex);
+	if (_running == 0)
+		return NULL;
+	--_running;
+	CgiCounters::add(_counters->running, -1);
+	return admitHead();
+}
+
+WebServer *CgiLimiter::remove(CgiJob *job)
+{
+	ScopedLock lock(_mutex);
+
+	for (std::deque<Waiting>::iterator it = _queue.begin(); it != _queue.end(); ++it)
+	{
+		if (it->job == job)
+		{
+			_queue.erase(it);
+			CgiCounters::add(_counters->queued, -1);
+			return NULL;
+		}
+	}
+	for (std::size_t i = 0; i < _admitted.size(); ++i)
+	{
+		if (_admitted[i].job == job)
+		{
+			_admitted.erase(_admitted.begin() + i);
+			--_running;
+			CgiCounters::add(_counters->running, -1);
+			return admitHead();
+		}
+	}
+	return NULL;
+}
+
+void CgiLimiter::takeAdmitted(WebServer *owner, std::vector<CgiJob *> &out)
+{
+	ScopedLock lock(_mutex);
+
+	std::size_t kept = 0;
+	for (std::size_t i = 0; i < _admitted.size(); ++i)
+	{
+		if (_admitted[i].owner == owner)
+			out.push_back(_admitted[i].job);
+		else
+			_admitted[kept++] = _admitted[i];
+	}
+	_admitted.resize(kept);
+}
+
+CgiJob *CgiLimiter::expire(WebServer *owner, unsigned long now)
+{
+	ScopedLock lock(_mutex);
+
+	for (std::deque<Waiting>::iterator it = _queue.begin(); it != _queue.end(); ++it)
+	{
+		if (it->owner != owner)
+			continue;
+		if (it->deadline > now)
+			return NULL;
+		CgiJob *job = it->job;
+		_queue.erase(it);
+		CgiCounters::add(_counters->queued, -1);
+		CgiCounters::add(_counters->timedOut, 1);
+		return job;
+	}
+	return NULL;
+}
+
+unsigned long CgiLimiter::nextDeadline(WebServer *owner)
+{
+	ScopedLock lock(_mutex);
+
+	for (std::deque<Waiting>::const_iterator it = _queue.begin();
+	     it != _queue.end(); ++it)
+	{
+		if (it->owner == owner)
+			return it->deadline;
+	}
+	return 0;
+}
+
+// Le temps d'attente de la file : au-delà, les places ont tourné
+unsigned long CgiLimiter::retryAfter() const
+{
+	unsigned long seconds = _queueTimeout / 1000UL;
+	return seconds > 0 ? seconds : 1;
+}
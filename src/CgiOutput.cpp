@@ -0,0 +1,154 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CgiOutput.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "CgiOutput.hpp"
+
+#include <sstream>
+
+namespace
+{
+	// Trim de base (espaces / tab / \r / \n)
+	static std::string trim(const std::string &s)
+	{
+		std::size_t start = s.find_first_not_of(" \t\r\n");
+		if (start == std::string::npos)
+			return std::string();
+		std::size_t end = s.find_last_not_of(" \t\r\n");
+		return s.substr(start, end - start + 1);
+	}
+}
+
+CgiOutput::CgiOutput()
+	: _output(),
+	  _eof(false),
+	  _scriptPath()
+{
+}
+
+CgiOutput::~CgiOutput()
+{
+}
+
+bool CgiOutput::outputDone() const
+{
+	return _eof;
+}
+
+std::size_t CgiOutput::buffered() const
+{
+	return _output.size();
+}
+
+void CgiOutput::takeOutput(std::string &out)
+{
+	out.clear();
+	out.swap(_output);
+}
+
+/*
+ * parseHeaders()
+ *
+ *  - headers séparés du body par CRLFCRLF (ou LFLF).
+ *    "Status: 404 Not Found" fixe le code de réponse.
+ */
+bool CgiOutput::parseHeaders(int &status, std::string &reason,
+                             HeaderMap &headers)
+{
+	std::size_t pos = _output.find("\r\n\r\n");
+	std::size_t sepLen = 4;
+	std::size_t lfPos = _output.find("\n\n");
+	if (lfPos != std::string::npos && (pos == std::string::npos || lfPos < pos))
+	{
+		pos = lfPos;
+		sepLen = 2;
+	}
+	if (pos == std::string::npos)
+		return false;
+
+	status = 200;
+	reason = "OK";
+	headers.clear();
+
+	std::string headerPart = _output.substr(0, pos);
+	_output.erase(0, pos + sepLen);
+
+	std::istringstream iss(headerPart);
+	std::string line;
+
+	while (std::getline(iss, line))
+	{
+		line = trim(line);
+		if (line.empty())
+			continue;
+
+		std::size_t colon = line.find(':');
+		if (colon == std::string::npos)
+			continue;
+
+		std::string name  = trim(line.substr(0, colon));
+		std::string value = trim(line.substr(colon + 1));
+
+		if (name.empty())
+			continue;
+
+		if (name == "Status")
+		{
+			// "Status: 404 Not Found"
+			std::istringstream st(value);
+			int code = 0;
+			std::string text;
+			if (st >> code)
+			{
+				std::getline(st, text);
+				text = trim(text);
+				if (code >= 100 && code <= 599)
+				{
+					status = code;
+					if (!text.empty())
+						reason = text;
+				}
+			}
+		}
+		else
+			headers[name] = value;
+	}
+
+	return true;
+}
+
+/*
+ * parseOutput()
+ *
+ *  - sortie complète : un programme qui a échoué (voir succeeded()), ou
+ *    sans aucune sortie, est une erreur.
+ *  - sans séparateur headers / body, tout est body.
+ */
+bool CgiOutput::parseOutput(int &status, std::string &reason,
+                            HeaderMap &headers, std::string &body)
+{
+	status = 200;
+	reason = "OK";
+	headers.clear();
+	body.clear();
+
+	if (!succeeded() || _output.empty())
+		return false;
+
+	parseHeaders(status, reason, headers);
+	body.swap(_output);
+	return true;
+}
+
+const std::string &CgiOutput::scriptPath() const
+{
+	return _scriptPath;
+}
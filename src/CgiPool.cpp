@@ -0,0 +1,225 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CgiPool.cpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "CgiPool.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>   // std::find
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>    // kill, SIGKILL
+#include <spawn.h>     // posix_spawn
+#include <sys/socket.h>
+#include <sys/wait.h>  // waitpid
+
+namespace
+{
+	// Les deux bouts sont close-on-exec (comme les pipes de CgiProcess) :
+	// seul le worker garde le sien, en fd 0 après dup2().
+	static bool openSocketPair(int fds[2])
+	{
+#ifdef __linux__
+		return socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0;
+#else
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+			return false;
+		fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+		fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+		return true;
+#endif
+	}
+}
+
+CgiPool::CgiPool(const std::string &interpreter, const std::string &runner,
+                 std::size_t size, std::size_t maxRequests)
+	: _interpreter(interpreter),
+	  _runner(runner),
+	  _size(size),
+	  _maxRequests(maxRequests),
+	  _workers(),
+	  _queue()
+{
+}
+
+CgiPool::~CgiPool()
+{
+	for (std::size_t i = 0; i < _workers.size(); ++i)
+	{
+		delete _workers[i].conn;
+		::kill(_workers[i].pid, SIGKILL);
+		reap(_workers[i].pid);
+	}
+}
+
+/*
+ * spawn()
+ *
+ *  - argv : [interpréteur, runner], environnement vide (le runner pose
+ *    celui de chaque requête). posix_spawn(), comme CgiProcess : pas de
+ *    copie des tables de pages du serveur.
+ *  - stdout du worker : stderr du serveur, le canal est le fd 0.
+ */
+FastCgiConnection *CgiPool::spawn()
+{
+	if (full())
+		return NULL;
+
+	std::vector<char *> argv;
+	argv.push_back(const_cast<char *>(_interpreter.c_str()));
+	argv.push_back(const_cast<char *>(_runner.c_str()));
+	argv.push_back(0);
+	char *envp[] = { 0 };
+
+	int sv[2];
+	if (!openSocketPair(sv))
+	{
+		std::cerr << "Error: socketpair() for CGI pool failed: "
+		          << std::strerror(errno) << std::endl;
+		return NULL;
+	}
+
+	posix_spawn_file_actions_t actions;
+	pid_t pid = -1;
+	int err = posix_spawn_file_actions_init(&actions);
+	if (err == 0)
+	{
+		err = posix_spawn_file_actions_adddup2(&actions, sv[1], STDIN_FILENO);
+		if (err == 0)
+			err = posix_spawn_file_actions_adddup2(&actions, STDERR_FILENO,
+			                                       STDOUT_FILENO);
+		if (err == 0)
+			err = posix_spawn(&pid, _interpreter.c_str(), &actions, NULL,
+			                  &argv[0], envp);
+		posix_spawn_file_actions_destroy(&actions);
+	}
+	close(sv[1]);
+
+	if (err != 0)
+	{
+		std::cerr << "Error: cannot start CGI pool worker " << _runner
+		          << ": " << std::strerror(err) << std::endl;
+		close(sv[0]);
+		return NULL;
+	}
+
+
+	FastCgiConnection *conn = new FastCgiConnection(_runner);
+	if (!conn->adopt(sv[0]))
+	{
+		delete conn;
+		::kill(pid, SIGKILL);
+		reap(pid);
+		return NULL;
+	}
+
+	Worker w;
+	w.conn = conn;
+	w.pid = pid;
+	w.served = 0;
+	_workers.push_back(w);
+	return conn;
+}
+
+bool CgiPool::full() const
+{
+	return _workers.size() >= _size;
+}
+
+FastCgiConnection *CgiPool::acquire()
+{
+	for (std::size_t i = 0; i < _workers.size(); ++i)
+	{
+		if (_workers[i].conn->idle() && !_workers[i].conn->broken())
+			return _workers[i].conn;
+	}
+	return NULL;
+}
+
+void CgiPool::assign(FastCgiConnection *conn)
+{
+	std::vector<Worker>::iterator it = findWorker(conn);
+	if (it != _workers.end())
+		++it->served;
+}
+
+bool CgiPool::exhausted(FastCgiConnection *conn) const
+{
+	if (_maxRequests == 0)
+		return false;
+	for (std::size_t i = 0; i < _workers.size(); ++i)
+	{
+		if (_workers[i].conn == conn)
+			return _workers[i].served >= _maxRequests;
+	}
+	return false;
+}
+
+bool CgiPool::retire(FastCgiConnection *conn)
+{
+	std::vector<Worker>::iterator it = findWorker(conn);
+	if (it == _workers.end())
+		return false;
+
+	Worker w = *it;
+	*it = _workers.back();
+	_workers.pop_back();
+
+	delete w.conn;
+	::kill(w.pid, SIGKILL);
+	reap(w.pid);
+	return w.served > 0;
+}
+
+void CgiPool::enqueue(CgiJob *job)
+{
+	_queue.push_back(job);
+}
+
+CgiJob *CgiPool::dequeue()
+{
+	if (_queue.empty())
+		return NULL;
+	CgiJob *job = _queue.front();
+	_queue.pop_front();
+	return job;
+}
+
+std::size_t CgiPool::queued() const
+{
+	return _queue.size();
+}
+
+void CgiPool::remove(CgiJob *job)
+{
+	std::deque<CgiJob *>::iterator it = std::find(_queue.begin(), _queue.end(), job);
+	if (it != _queue.end())
+		_queue.erase(it);
+}
+
+std::vector<CgiPool::Worker>::iterator CgiPool::findWorker(FastCgiConnection *conn)
+{
+	for (std::vector<Worker>::iterator it = _workers.begin(); it != _workers.end(); ++it)
+	{
+		if (it->conn == conn)
+			return it;
+	}
+	return _workers.end();
+}
+
+void CgiPool::reap(pid_t pid)
+{
+	int status;
+	while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+		;
+}
@@ -0,0 +1,387 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CgiProcess.cpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "CgiProcess.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>    // pipe, vfork, dup2, execve, chdir
+#include <fcntl.h>
+#include <signal.h>    // kill, SIGKILL
+#include <spawn.h>     // posix_spawn
+#include <sys/wait.h>  // waitpid
+#ifdef __linux__
+# include <sys/syscall.h> // SYS_pidfd_open
+#endif
+
+// posix_spawn_file_actions_addchdir_np() : glibc >= 2.29
+#if defined(__GLIBC__) && defined(__GLIBC_PREREQ)
+# if __GLIBC_PREREQ(2, 29)
+#  define CGI_SPAWN_CHDIR 1
+# endif
+#endif
+
+namespace
+{
+	static void closeFd(int &fd)
+	{
+		if (fd >= 0)
+			close(fd);
+		fd = -1;
+	}
+
+	/*
+	 * openPipe()
+	 *
+	 *  - les deux bouts sont close-on-exec : un autre script lancé en même
+	 *    temps (autre requête, autre thread) ne doit pas hériter de nos
+	 *    pipes, sinon l'EOF de stdout n'arriverait qu'à sa propre fin.
+	 *    L'enfant récupère ses bouts avec dup2(), qui enlève le flag.
+	 */
+	static bool openPipe(int fds[2])
+	{
+#ifdef __linux__
+		return pipe2(fds, O_CLOEXEC) == 0;
+#else
+		if (pipe(fds) < 0)
+			return false;
+		fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+		fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+		return true;
+#endif
+	}
+
+	// Taille demandée pour le pipe stdout du script
+	static const int OUTPUT_PIPE_SIZE = 256 * 1024;
+
+	static bool setNonBlocking(int fd)
+	{
+		int flags = fcntl(fd, F_GETFL, 0);
+		return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+	}
+
+	/*
+	 * spawnScript()
+	 *
+	 *  - lance le script sans fork() : le serveur peut tenir de gros
+	 *    caches et des milliers de connexions, et fork() recopie ses
+	 *    tables de pages à chaque requête CGI. posix_spawn() (glibc :
+	 *    clone(CLONE_VM | CLONE_VFORK)) partage la mémoire jusqu'à
+	 *    l'execve, quelle que soit la taille du process.
+	 *  - stdin / stdout et le chdir dans le dossier du script sont des
+	 *    file actions ; sans addchdir_np, vfork() + execve() (l'enfant
+	 *    n'appelle que dup2 / chdir / execve / _exit).
+	 *  - renvoie 0, ou le code d'erreur (execve compris avec posix_spawn).
+	 */
+	static int spawnScript(const char *path, char *const argv[],
+	                       char *const envp[], int in, int out,
+	                       const char *dir, pid_t &pid)
+	{
+#ifdef CGI_SPAWN_CHDIR
+		posix_spawn_file_actions_t actions;
+		int err = posix_spawn_file_actions_init(&actions);
+		if (err != 0)
+			return err;
+
+		err = posix_spawn_file_actions_adddup2(&actions, in, STDIN_FILENO);
+		if (err == 0)
+			err = posix_spawn_file_actions_adddup2(&actions, out, STDOUT_FILENO);
+		if (err == 0)
+			err = posix_spawn_file_actions_addchdir_np(&actions, dir);
+		if (err == 0)
+			err = posix_spawn(&pid, path, &actions, NULL, argv, envp);
+
+		posix_spawn_file_actions_destroy(&actions);
+		return err;
+#else
+		pid = vfork();
+		if (pid < 0)
+			return errno;
+		if (pid == 0)
+		{
+			if (dup2(in, STDIN_FILENO) < 0 || dup2(out, STDOUT_FILENO) < 0)
+				_exit(1);
+			if (chdir(dir) < 0)
+				_exit(1);
+			execve(path, argv, envp);
+			_exit(1);
+		}
+		return 0;
+#endif
+	}
+
+	// pidfd : lisible quand le process se termine (Linux >= 5.3)
+	static int openPidFd(pid_t pid)
+	{
+#if defined(__linux__) && defined(SYS_pidfd_open)
+		return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+		(void)pid;
+		return -1;
+#endif
+	}
+}
+
+CgiProcess::CgiProcess()
+	: CgiOutput(),
+	  _pid(-1),
+	  _in(-1),
+	  _out(-1),
+	  _exitFd(-1),
+	  _input(),
+	  _inputOff(0),
+	  _exited(false),
+	  _status(0)
+{
+}
+
+CgiProcess::~CgiProcess()
+{
+	// Requête abandonnée (client parti, timeout) : pas de zombie
+	if (_pid > 0 && !_exited)
+	{
+		::kill(_pid, SIGKILL);
+		int status;
+		while (waitpid(_pid, &status, 0) < 0 && errno == EINTR)
+			;
+	}
+
+	closeFd(_in);
+	closeFd(_out);
+	closeFd(_exitFd);
+}
+
+/*
+ * start()
+ *
+ *  - argv / envp / dossier sont préparés AVANT le lancement (voir
+ *    spawnScript()) : l'enfant n'exécute rien d'autre que dup2, chdir
+ *    et execve, ce qui reste correct quand d'autres threads
+ *    (worker_threads) tiennent des locks à ce moment-là.
+ */
+bool CgiProcess::start(const std::string &interpreter,
+                       const std::string &scriptPath,
+                       const std::vector<std::string> &env,
+                       std::string &input)
+{
+	_scriptPath = scriptPath;
+	_input.swap(input);
+	_inputOff = 0;
+
+	std::string scriptDir = ".";
+	std::string scriptName = scriptPath;
+	std::size_t slashPos = scriptPath.rfind('/');
+	if (slashPos != std::string::npos)
+	{
+		scriptDir  = scriptPath.substr(0, slashPos);
+		scriptName = scriptPath.substr(slashPos + 1);
+		if (scriptDir.empty())
+			scriptDir = "/";
+	}
+
+	// argv : [interpreter, scriptName, NULL] ou [./scriptName, NULL]
+	std::string execPath = interpreter;
+	std::vector<char *> argv;
+	if (!interpreter.empty())
+	{
+		argv.push_back(const_cast<char *>(execPath.c_str()));
+		argv.push_back(const_cast<char *>(scriptName.c_str()));
+	}
+	else
+	{
+		execPath = "./" + scriptName;
+		argv.push_back(const_cast<char *>(execPath.c_str()));
+	}
+	argv.push_back(0);
+
+	std::vector<char *> envp;
+	for (std::size_t i = 0; i < env.size(); ++i)
+		envp.push_back(const_cast<char *>(env[i].c_str()));
+	envp.push_back(0);
+
+	int inPipe[2];
+	int outPipe[2];
+
+	if (!openPipe(inPipe))
+		return false;
+	if (!openPipe(outPipe))
+	{
+		close(inPipe[0]);
+		close(inPipe[1]);
+		return false;
+	}
+
+	if (!setNonBlocking(inPipe[1]) || !setNonBlocking(outPipe[0]))
+	{
+		close(inPipe[0]);
+		close(inPipe[1]);
+		close(outPipe[0]);
+		close(outPipe[1]);
+		return false;
+	}
+
+#ifdef F_SETPIPE_SZ
+	// stdout plus grand (Linux) : le body part par splice() en blocs de
+	// 256 Ko au lieu de 64 Ko. Échec sans gravité (pipe-max-size, quota)
+	fcntl(outPipe[0], F_SETPIPE_SZ, OUTPUT_PIPE_SIZE);
+#endif
+
+	// Enfant : stdin / stdout sur les pipes, dans le dossier du script
+	// (les autres fds du serveur sont close-on-exec)
+	pid_t pid = -1;
+	int err = spawnScript(execPath.c_str(), &argv[0], &envp[0],
+	                      inPipe[0], outPipe[1], scriptDir.c_str(), pid);
+	if (err != 0)
+	{
+		std::cerr << "Error: cannot start CGI " << scriptPath << ": "
+		          << std::strerror(err) << std::endl;
+		close(inPipe[0]);
+		close(inPipe[1]);
+		close(outPipe[0]);
+		close(outPipe[1]);
+		return false;
+	}
+
+	close(inPipe[0]);
+	close(outPipe[1]);
+
+	_pid = pid;
+	_in = inPipe[1];
+	_out = outPipe[0];
+	_exitFd = openPidFd(pid);
+	return true;
+}
+
+int CgiProcess::inputFd() const
+{
+	return _in;
+}
+
+int CgiProcess::outputFd() const
+{
+	return _out;
+}
+
+int CgiProcess::exitFd() const
+{
+	return _exitFd;
+}
+
+bool CgiProcess::writeInput()
+{
+	while (_in >= 0 && _inputOff < _input.size())
+	{
+		ssize_t n = write(_in, _input.data() + _inputOff,
+		                  _input.size() - _inputOff);
+		if (n > 0)
+		{
+			_inputOff += static_cast<std::size_t>(n);
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return false; // pipe plein : on attend EV_WRITE
+
+		// EPIPE : le script ne lit pas (ou plus) son stdin
+		break;
+	}
+
+	std::string().swap(_input);
+	_inputOff = 0;
+	return true;
+}
+
+void CgiProcess::closeInput()
+{
+	closeFd(_in);
+	std::string().swap(_input);
+}
+
+CgiProcess::ReadResult CgiProcess::readOutput(std::size_t limit)
+{
+	char buf[16384];
+
+	while (!_eof)
+	{
+		if (_output.size() >= limit)
+			return READ_MORE;
+
+		ssize_t n = read(_out, buf, sizeof(buf));
+		if (n > 0)
+		{
+			_output.append(buf, static_cast<std::size_t>(n));
+			continue;
+		}
+		if (n == 0)
+		{
+			_eof = true;
+			break;
+		}
+		if (errno == EINTR)
+			continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return READ_WAIT;
+
+		std::cerr << "Error: read() from CGI pipe failed: "
+		          << std::strerror(errno) << std::endl;
+		_eof = true;
+	}
+	return READ_EOF;
+}
+
+bool CgiProcess::reap()
+{
+	if (_exited || _pid <= 0)
+		return true;
+
+	pid_t ret = waitpid(_pid, &_status, WNOHANG);
+	if (ret == 0)
+		return false;
+	if (ret < 0)
+	{
+		if (errno == EINTR)
+			return false;
+		std::cerr << "Error: waitpid() on CGI failed: "
+		          << std::strerror(errno) << std::endl;
+		_status = -1; // compté comme une sortie anormale
+	}
+
+	_exited = true;
+	return true;
+}
+
+bool CgiProcess::exited() const
+{
+	return _exited;
+}
+
+void CgiProcess::kill()
+{
+	if (_pid > 0 && !_exited)
+		::kill(_pid, SIGKILL);
+}
+
+bool CgiProcess::succeeded() const
+{
+	if (_status != -1 && WIFEXITED(_status) && WEXITSTATUS(_status) == 0)
+		return true;
+
+	std::cerr << "CGI script exited abnormally: " << _scriptPath;
+	if (_status != -1 && WIFEXITED(_status))
+		std::cerr << " (exit code " << WEXITSTATUS(_status) << ")";
+	else if (_status != -1 && WIFSIGNALED(_status))
+		std::cerr << " (signal " << WTERMSIG(_status) << ")";
+	std::cerr << std::endl;
+	return false;
+}
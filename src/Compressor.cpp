@@ -0,0 +1,143 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Compressor.cpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Compressor.hpp"
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	// Taille des blocs de sortie de deflate()
+	static const std::size_t OUT_CHUNK = 16384;
+
+	// Plus gros bloc d'entrée donné en une fois (avail_in est un uInt)
+	static const std::size_t IN_CHUNK = 1024 * 1024;
+}
+
+Compressor::Compressor(Format format, int level)
+	: _ok(false),
+	  _finished(false)
+{
+	std::memset(&_zs, 0, sizeof(_zs));
+
+	// windowBits : 15 = flux zlib, +16 = en-tête et trailer gzip
+	int windowBits = (format == GZIP) ? 15 + 16 : 15;
+
+	if (deflateInit2(&_zs, level, Z_DEFLATED, windowBits, 8,
+	                 Z_DEFAULT_STRATEGY) == Z_OK)
+		_ok = true;
+	else
+		std::cerr << "Error: deflateInit2() failed" << std::endl;
+}
+
+Compressor::~Compressor()
+{
+	if (_ok)
+		deflateEnd(&_zs);
+}
+
+bool Compressor::run(const char *data, std::size_t len, int flush,
+                     std::string &out)
+{
+	char buf[OUT_CHUNK];
+
+	_zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+	_zs.avail_in = static_cast<uInt>(len);
+
+	do
+	{
+		_zs.next_out = reinterpret_cast<Bytef *>(buf);
+		_zs.avail_out = sizeof(buf);
+
+		int rc = deflate(&_zs, flush);
+		if (rc == Z_STREAM_ERROR)
+		{
+			std::cerr << "Error: deflate() failed" << std::endl;
+			return false;
+		}
+		out.append(buf, sizeof(buf) - _zs.avail_out);
+	}
+	while (_zs.avail_out == 0);
+
+	return true;
+}
+
+bool Compressor::update(const char *data, std::size_t len, std::string &out)
+{
+	if (!_ok || _finished)
+		return false;
+
+	while (len > 0)
+	{
+		std::size_t n = (len > IN_CHUNK) ? IN_CHUNK : len;
+		if (!run(data, n, Z_NO_FLUSH, out))
+		{
+			_ok = false;
+			return false;
+		}
+		data += n;
+		len -= n;
+	}
+	return true;
+}
+
+/*
+ * flush()
+ *
+ *  - Z_SYNC_FLUSH : tout ce qui a été donné jusqu'ici sort du
+ *    compresseur (flux en streaming : le client peut décoder chaque
+ *    morceau reçu sans attendre la fin).
+ */
+bool Compressor::flush(std::string &out)
+{
+	if (!_ok || _finished)
+		return false;
+
+	if (!run("", 0, Z_SYNC_FLUSH, out))
+	{
+		_ok = false;
+		return false;
+	}
+	return true;
+}
+
+bool Compressor::finish(std::string &out)
+{
+	if (!_ok || _finished)
+		return false;
+
+	_finished = true;
+	if (!run("", 0, Z_FINISH, out))
+	{
+		_ok = false;
+		return false;
+	}
+	return true;
+}
+
+bool Compressor::compress(Format format, int level,
+                          const std::string &in, std::string &out)
+{
+	Compressor z(format, level);
+
+	out.clear();
+	// Texte compressible : on réserve un tiers de l'entrée
+	out.reserve(in.size() / 3 + 64);
+
+	return z.update(in.data(), in.size(), out) && z.finish(out);
+}
+
+const char *Compressor::encodingName(Format format)
+{
+	return (format == GZIP) ? "gzip" : "deflate";
+}
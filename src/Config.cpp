@@ -18,6 +18,12 @@
 #include <stdexcept>
 #include <cstddef>
 #include <cstdlib>
+#include <unistd.h>   // sysconf
+#include <netdb.h>    // getaddrinfo (fastcgi_pass, proxy_pass)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/un.h>   // sockaddr_un
+#include <cstring>
 
 /*
     Classe Config
@@ -31,7 +37,8 @@
 */
 
 Config::Config()
-	: _servers()
+	: _servers(),
+	  _global()
 {
 }
 
@@ -59,9 +66,91 @@ std::string Config::trim(const std::string &s) const
 	return s.substr(start, end - start);
 }
 
+/*
+    readSingleValue()
+
+    Pour les directives de la forme "keyword value;" (ou "keyword value ;").
+*/
+std::string Config::readSingleValue(const std::string &line,
+                                    const std::string &keyword) const
+{
+	std::istringstream iss(line);
+	std::string kw;
+	std::string value;
+
+	if (!(iss >> kw))
+		throw std::runtime_error("Invalid " + keyword + " directive (missing keyword)");
+
+	if (kw != keyword)
+		throw std::runtime_error("Invalid " + keyword + " directive (wrong keyword)");
+
+	if (!(iss >> value))
+		throw std::runtime_error("Invalid " + keyword + " directive (missing value)");
+
+	if (value[value.size() - 1] != ';')
+	{
+		std::string semi;
+		if (!(iss >> semi) || semi != ";")
+			throw std::runtime_error("Invalid " + keyword + " directive (missing ';')");
+	}
+	else
+		value.erase(value.size() - 1);
+
+	value = trim(value);
+
+	if (value.empty())
+		throw std::runtime_error("Invalid " + keyword + " directive (empty value)");
+
+	return value;
+}
+
+unsigned long Config::parseNumber(const std::string &value,
+                                  const std::string &keyword) const
+{
+	unsigned long tmp = 0;
+	std::istringstream valStream(value);
+
+	if (value[0] == '-' || !(valStream >> tmp) || !valStream.eof())
+		throw std::runtime_error("Invalid " + keyword + " value: " + value);
+
+	return tmp;
+}
+
+/*
+    parseSize()
+
+    Taille avec suffixe optionnel : 4096, 512k, 8m, 1g (majuscules ok).
+*/
+unsigned long Config::parseSize(const std::string &value,
+                                const std::string &keyword) const
+{
+	unsigned long unit = 1;
+	std::string digits = value;
+	char last = value[value.size() - 1];
+
+	if (last == 'k' || last == 'K')
+		unit = 1024UL;
+	else if (last == 'm' || last == 'M')
+		unit = 1024UL * 1024UL;
+	else if (last == 'g' || last == 'G')
+		unit = 1024UL * 1024UL * 1024UL;
+
+	if (unit != 1)
+		digits.erase(digits.size() - 1);
+	if (digits.empty())
+		throw std::runtime_error("Invalid " + keyword + " value: " + value);
+
+	unsigned long n = parseNumber(digits, keyword);
+	if (n > static_cast<unsigned long>(-1) / unit)
+		throw std::runtime_error(keyword + " value too large: " + value);
+
+	return n * unit;
+}
+
 void Config::load(const std::string &path)
 {
 	_servers.clear();
+	_global = GlobalConfig();
 
 	std::ifstream in(path.c_str());
 	if (!in)
@@ -83,15 +172,370 @@ void Config::load(const std::string &path)
 			parseServerBlock(in, server);
 			_servers.push_back(server);
 		}
+		else if (line.compare(0, 9, "upstream ") == 0 ||
+		         line.compare(0, 9, "upstream\t") == 0)
+			parseUpstreamBlock(in, line);
 		else
 		{
-			// Pour l'instant on ignore les directives globales (hors server)
-			continue;
+			// Directives globales (hors server)
+			parseGlobalDirective(line);
 		}
 	}
 
 	if (_servers.empty())
 		throw std::runtime_error("No 'server { ... }' block found in config");
+
+	resolveUpstreams();
+}
+
+/*
+    parseGlobalDirective()
+
+    event_backend epoll;
+    event_backend poll;
+    worker_processes 4;
+    worker_processes auto;
+    worker_threads 4;
+    worker_threads auto;
+    accept_budget 64;
+    sendfile_max_chunk 512k;
+    open_file_cache 1000;          (ou off)
+    open_file_cache_inactive 20;
+    open_file_cache_valid 60;
+    open_file_cache_min_uses 2;
+
+    Les autres directives globales sont ignorées (comme avant).
+*/
+void Config::parseGlobalDirective(const std::string &line)
+{
+	std::istringstream iss(line);
+	std::string keyword;
+
+	if (!(iss >> keyword))
+		return;
+
+	if (keyword == "event_backend")
+	{
+		std::string value;
+
+		if (!(iss >> value))
+			throw std::runtime_error("Invalid event_backend directive (missing value)");
+
+		if (value[value.size() - 1] != ';')
+		{
+			std::string semi;
+			if (!(iss >> semi) || semi != ";")
+				throw std::runtime_error("Invalid event_backend directive (missing ';')");
+		}
+		else
+			value.erase(value.size() - 1);
+
+		value = trim(value);
+
+		if (value != "epoll" && value != "poll")
+			throw std::runtime_error("Invalid event_backend value (expected 'epoll' or 'poll'): " + value);
+
+		_global.eventBackend = value;
+	}
+	else if (keyword == "worker_processes" || keyword == "worker_threads")
+	{
+		std::string value = readSingleValue(line, keyword);
+		std::size_t count = 1;
+
+		if (value == "auto")
+		{
+			long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+			count = (cpus > 0) ? static_cast<std::size_t>(cpus) : 1;
+		}
+		else
+		{
+			unsigned long tmp = parseNumber(value, keyword);
+			if (tmp == 0 || tmp > 1024)
+				throw std::runtime_error(keyword + " must be between 1 and 1024 (or 'auto')");
+			count = static_cast<std::size_t>(tmp);
+		}
+
+		if (keyword == "worker_processes")
+			_global.workerProcesses = count;
+		else
+			_global.workerThreads = count;
+	}
+	else if (keyword == "accept_budget")
+	{
+		std::string value = readSingleValue(line, "accept_budget");
+		unsigned long tmp = parseNumber(value, "accept_budget");
+		if (tmp == 0 || tmp > 65536)
+			throw std::runtime_error("accept_budget must be between 1 and 65536");
+		_global.acceptBudget = static_cast<std::size_t>(tmp);
+	}
+	else if (keyword == "sendfile_max_chunk")
+	{
+		std::string value = readSingleValue(line, "sendfile_max_chunk");
+		unsigned long tmp = parseSize(value, "sendfile_max_chunk");
+		if (tmp < 4096)
+			throw std::runtime_error("sendfile_max_chunk must be >= 4096");
+		_global.sendfileMaxChunk = static_cast<std::size_t>(tmp);
+	}
+	else if (keyword == "open_file_cache")
+	{
+		std::string value = readSingleValue(line, "open_file_cache");
+		if (value == "off")
+			_global.openFileCacheMax = 0;
+		else
+		{
+			unsigned long tmp = parseNumber(value, "open_file_cache");
+			if (tmp > 1000000)
+				throw std::runtime_error("open_file_cache must be <= 1000000 (or 'off')");
+			_global.openFileCacheMax = static_cast<std::size_t>(tmp);
+		}
+	}
+	else if (keyword == "open_file_cache_inactive" ||
+	         keyword == "open_file_cache_valid")
+	{
+		std::string value = readSingleValue(line, keyword);
+		unsigned long tmp = parseNumber(value, keyword);
+		if (tmp == 0 || tmp > 86400)
+			throw std::runtime_error(keyword + " must be between 1 and 86400 seconds");
+
+		if (keyword == "open_file_cache_inactive")
+			_global.openFileCacheInactive = tmp;
+		else
+			_global.openFileCacheValid = tmp;
+	}
+	else if (keyword == "open_file_cache_min_uses")
+	{
+		std::string value = readSingleValue(line, "open_file_cache_min_uses");
+		unsigned long tmp = parseNumber(value, "open_file_cache_min_uses");
+		if (tmp == 0 || tmp > 1000000)
+			throw std::runtime_error("open_file_cache_min_uses must be between 1 and 1000000");
+		_global.openFileCacheMinUses = static_cast<unsigned>(tmp);
+	}
+	else if (keyword == "response_cache")
+	{
+		std::string value = readSingleValue(line, "response_cache");
+		if (value == "off")
+			_global.responseCacheSize = 0;
+		else
+			_global.responseCacheSize =
+			    static_cast<std::size_t>(parseSize(value, "response_cache"));
+	}
+	else if (keyword == "response_cache_max_entry")
+	{
+		std::string value = readSingleValue(line, "response_cache_max_entry");
+		unsigned long tmp = parseSize(value, "response_cache_max_entry");
+		if (tmp == 0)
+			throw std::runtime_error("response_cache_max_entry must be > 0");
+		_global.responseCacheMaxEntry = static_cast<std::size_t>(tmp);
+	}
+}
+
+/*
+    parseUpstreamBlock()
+
+    upstream backends {
+        server 127.0.0.1:9100 weight=2 max_fails=3 fail_timeout=30;
+        server unix:/run/app.sock;
+        least_conn;               (ou hash $request_uri; / hash $remote_addr;)
+    }
+*/
+void Config::parseUpstreamBlock(std::istream &in, const std::string &line)
+{
+	std::istringstream iss(line);
+	std::string keyword;
+	std::string name;
+
+	iss >> keyword;
+	if (!(iss >> name))
+		throw std::runtime_error("Invalid upstream directive (missing name)");
+
+	bool hasBrace = false;
+	if (name[name.size() - 1] == '{')
+	{
+		hasBrace = true;
+		name.erase(name.size() - 1);
+	}
+	if (!hasBrace)
+	{
+		std::string brace;
+		if (!(iss >> brace) || brace != "{")
+			throw std::runtime_error("Invalid upstream directive (missing '{')");
+	}
+
+	// Le nom remplace host[:port] dans proxy_pass / fastcgi_pass
+	if (name.empty() || name.find_first_of(":/") != std::string::npos)
+		throw std::runtime_error("Invalid upstream name: " + name);
+	for (std::size_t i = 0; i < _global.upstreams.size(); ++i)
+	{
+		if (_global.upstreams[i].name == name)
+			throw std::runtime_error("Duplicate upstream: " + name);
+	}
+
+	UpstreamConfig upstream;
+	upstream.name = name;
+	bool balanceSet = false;
+	bool closed = false;
+
+	std::string inner;
+	while (std::getline(in, inner))
+	{
+		inner = trim(inner);
+
+		if (inner.empty() || inner[0] == '#')
+			continue;
+
+		if (inner == "}")
+		{
+			closed = true;
+			break;
+		}
+
+		if (inner.compare(0, 6, "server") == 0)
+		{
+			parseUpstreamServer(inner, upstream);
+			continue;
+		}
+
+		if (inner.compare(0, 10, "least_conn") == 0)
+		{
+			std::string rest = trim(inner.substr(10));
+			if (rest != ";")
+				throw std::runtime_error("Invalid least_conn directive in upstream " + name);
+			if (balanceSet)
+				throw std::runtime_error("Duplicate balancing method in upstream " + name);
+			upstream.balance = UpstreamConfig::BALANCE_LEAST_CONN;
+		}
+		else if (inner.compare(0, 4, "hash") == 0)
+		{
+			std::string value = readSingleValue(inner, "hash");
+			if (balanceSet)
+				throw std::runtime_error("Duplicate balancing method in upstream " + name);
+			if (value == "$request_uri")
+				upstream.balance = UpstreamConfig::BALANCE_HASH_URI;
+			else if (value == "$remote_addr")
+				upstream.balance = UpstreamConfig::BALANCE_HASH_IP;
+			else
+				throw std::runtime_error("Invalid hash key in upstream (expected $request_uri or $remote_addr): " + value);
+		}
+		else
+			throw std::runtime_error("Unknown directive inside upstream block: " + inner);
+
+		balanceSet = true;
+	}
+
+	if (!closed)
+		throw std::runtime_error("Unterminated upstream block: " + name);
+	if (upstream.servers.empty())
+		throw std::runtime_error("No server in upstream: " + name);
+
+	_global.upstreams.push_back(upstream);
+}
+
+/*
+    server 127.0.0.1:9100;
+    server app.local:9000 weight=2 max_fails=3 fail_timeout=30;
+*/
+void Config::parseUpstreamServer(const std::string &line, UpstreamConfig &upstream)
+{
+	std::istringstream iss(line);
+	std::string keyword;
+	std::string address;
+	std::vector<std::string> params;
+
+	iss >> keyword;
+	if (keyword != "server")
+		throw std::runtime_error("Unknown directive inside upstream block: " + line);
+
+	bool ended = false;
+	std::string token;
+	while (!ended && iss >> token)
+	{
+		if (token[token.size() - 1] == ';')
+		{
+			ended = true;
+			token.erase(token.size() - 1);
+		}
+		if (token.empty())
+			continue;
+		if (address.empty())
+			address = token;
+		else
+			params.push_back(token);
+	}
+
+	if (!ended)
+		throw std::runtime_error("Invalid server directive in upstream (missing ';')");
+	if (address.empty())
+		throw std::runtime_error("Invalid server directive in upstream (missing address)");
+
+	UpstreamServerConfig server;
+	server.address = parseSocketAddress(address, "upstream server");
+
+	for (std::size_t i = 0; i < params.size(); ++i)
+	{
+		std::size_t eq = params[i].find('=');
+		std::string key = params[i].substr(0, eq);
+		std::string value = (eq == std::string::npos) ? std::string()
+		                                              : params[i].substr(eq + 1);
+		if (key != "weight" && key != "max_fails" && key != "fail_timeout")
+			throw std::runtime_error("Unknown upstream server parameter: " + params[i]);
+		if (value.empty())
+			throw std::runtime_error("Invalid upstream server parameter: " + params[i]);
+
+		unsigned long tmp = parseNumber(value, "upstream " + key);
+		if (key == "weight")
+		{
+			if (tmp == 0 || tmp > 100)
+				throw std::runtime_error("upstream weight must be between 1 and 100");
+			server.weight = static_cast<unsigned>(tmp);
+		}
+		else if (key == "max_fails")
+		{
+			if (tmp > 1000)
+				throw std::runtime_error("upstream max_fails must be <= 1000");
+			server.maxFails = static_cast<unsigned>(tmp);
+		}
+		else
+		{
+			if (tmp == 0 || tmp > 86400)
+				throw std::runtime_error("upstream fail_timeout must be between 1 and 86400 seconds");
+			server.failTimeout = tmp;
+		}
+	}
+
+	upstream.servers.push_back(server);
+}
+
+/*
+    resolveUpstreams()
+
+    proxy_pass http://nom et fastcgi_pass nom sans port : un bloc
+    upstream de ce nom s'il existe (déclaré avant ou après), sinon un
+    nom d'hôte (proxy_pass : port 80 ; fastcgi_pass : erreur, le port
+    est obligatoire).
+*/
+void Config::resolveUpstreams()
+{
+	for (std::size_t i = 0; i < _servers.size(); ++i)
+	{
+		for (std::size_t j = 0; j < _servers[i].locations.size(); ++j)
+		{
+			LocationConfig &loc = _servers[i].locations[j];
+			if (loc.upstream.empty())
+				continue;
+
+			bool found = false;
+			for (std::size_t k = 0; k < _global.upstreams.size() && !found; ++k)
+				found = (_global.upstreams[k].name == loc.upstream);
+			if (found)
+				continue;
+
+			if (loc.proxyEnabled)
+				loc.proxyPass = parseSocketAddress(loc.upstream + ":80", "proxy_pass");
+			else
+				loc.fastcgiPass = parseSocketAddress(loc.upstream, "fastcgi_pass");
+			loc.upstream.clear();
+		}
+	}
 }
 
 /*
@@ -128,6 +572,12 @@ void Config::parseServerBlock(std::istream &in, ServerConfig &server)
 			parseClientMaxBodySizeDirective(line, server);
 		else if (line.find("autoindex") == 0)
 			parseServerAutoindexDirective(line, server);
+		else if (line.find("keepalive_timeout") == 0)
+			parseKeepaliveTimeoutDirective(line, server);
+		else if (line.find("keepalive_requests") == 0)
+			parseKeepaliveRequestsDirective(line, server);
+		else if (line.find("pipeline_max_requests") == 0)
+			parsePipelineMaxRequestsDirective(line, server);
 		else if (line.find("location") == 0)
 			parseLocationDirective(in, line, server);
 		else
@@ -407,6 +857,51 @@ void Config::parseServerAutoindexDirective(const std::string &line, ServerConfig
 		throw std::runtime_error("Invalid autoindex value (expected 'on' or 'off'): " + value);
 }
 
+/*
+    keepalive_timeout 75;    (0 => connexions fermées après chaque réponse)
+*/
+void Config::parseKeepaliveTimeoutDirective(const std::string &line, ServerConfig &server)
+{
+	std::string value = readSingleValue(line, "keepalive_timeout");
+	unsigned long tmp = parseNumber(value, "keepalive_timeout");
+
+	if (tmp > 3600)
+		throw std::runtime_error("keepalive_timeout must be <= 3600");
+
+	server.keepaliveTimeout = static_cast<int>(tmp);
+}
+
+/*
+    keepalive_requests 1000;
+*/
+void Config::parseKeepaliveRequestsDirective(const std::string &line, ServerConfig &server)
+{
+	std::string value = readSingleValue(line, "keepalive_requests");
+	unsigned long tmp = parseNumber(value, "keepalive_requests");
+
+	if (tmp == 0)
+		throw std::runtime_error("keepalive_requests must be > 0");
+
+	server.keepaliveRequests = static_cast<std::size_t>(tmp);
+}
+
+/*
+    pipeline_max_requests 32;
+
+    Nombre max de requêtes pipelinées dont la réponse n'est pas encore
+    envoyée sur une connexion. Au-delà, on arrête de lire la socket.
+*/
+void Config::parsePipelineMaxRequestsDirective(const std::string &line, ServerConfig &server)
+{
+	std::string value = readSingleValue(line, "pipeline_max_requests");
+	unsigned long tmp = parseNumber(value, "pipeline_max_requests");
+
+	if (tmp == 0)
+		throw std::runtime_error("pipeline_max_requests must be > 0");
+
+	server.pipelineMaxRequests = static_cast<std::size_t>(tmp);
+}
+
 /*
     location /path { ... }
 */
@@ -468,6 +963,13 @@ void Config::parseLocationDirective(std::istream &in,
         redirect
         upload_store
         cgi
+        cgi_pool, cgi_pool_runner, cgi_pool_max_requests
+        cgi_max_concurrency, cgi_queue_size, cgi_queue_timeout
+        cgi_status
+        fastcgi_pass
+        proxy_pass
+        gzip_static
+        compress, compress_types, compress_min_length, compress_level
 */
 void Config::parseLocationBlock(std::istream &in,
                                 LocationConfig &loc,
@@ -731,6 +1233,66 @@ void Config::parseLocationBlock(std::istream &in,
 			loc.uploadStoreSet = true;
 			loc.uploadStore    = value;
 		}
+		else if (line.find("cgi_pool_runner") == 0)
+		{
+			std::string value = readSingleValue(line, "cgi_pool_runner");
+			loc.cgiPoolRunner = value;
+		}
+		else if (line.find("cgi_pool_max_requests") == 0)
+		{
+			std::string value = readSingleValue(line, "cgi_pool_max_requests");
+			loc.cgiPoolMaxRequests =
+			    static_cast<std::size_t>(parseNumber(value, "cgi_pool_max_requests"));
+		}
+		else if (line.find("cgi_pool") == 0)
+		{
+			/*
+			    cgi_pool 4;   (0 = off)
+			*/
+			std::string value = readSingleValue(line, "cgi_pool");
+			unsigned long tmp = parseNumber(value, "cgi_pool");
+			if (tmp > 256)
+				throw std::runtime_error("cgi_pool must be between 0 and 256");
+			loc.cgiPoolSize = static_cast<std::size_t>(tmp);
+		}
+		else if (line.find("cgi_max_concurrency") == 0)
+		{
+			/*
+			    cgi_max_concurrency 8;   (0 = illimité)
+			*/
+			std::string value = readSingleValue(line, "cgi_max_concurrency");
+			unsigned long tmp = parseNumber(value, "cgi_max_concurrency");
+			if (tmp > 65536)
+				throw std::runtime_error("cgi_max_concurrency must be between 0 and 65536");
+			loc.cgiMaxConcurrency = static_cast<std::size_t>(tmp);
+		}
+		else if (line.find("cgi_queue_size") == 0)
+		{
+			std::string value = readSingleValue(line, "cgi_queue_size");
+			unsigned long tmp = parseNumber(value, "cgi_queue_size");
+			if (tmp > 65536)
+				throw std::runtime_error("cgi_queue_size must be between 0 and 65536");
+			loc.cgiQueueSize = static_cast<std::size_t>(tmp);
+		}
+		else if (line.find("cgi_queue_timeout") == 0)
+		{
+			std::string value = readSingleValue(line, "cgi_queue_timeout");
+			unsigned long tmp = parseNumber(value, "cgi_queue_timeout");
+			if (tmp < 1 || tmp > 3600)
+				throw std::runtime_error("cgi_queue_timeout must be between 1 and 3600");
+			loc.cgiQueueTimeout = tmp;
+		}
+		else if (line.find("cgi_status") == 0)
+		{
+			std::string value = readSingleValue(line, "cgi_status");
+
+			if (value == "on")
+				loc.cgiStatus = true;
+			else if (value == "off")
+				loc.cgiStatus = false;
+			else
+				throw std::runtime_error("Invalid cgi_status value in location (expected 'on' or 'off'): " + value);
+		}
 		else if (line.find("cgi") == 0)
 		{
 			/*
@@ -772,11 +1334,201 @@ void Config::parseLocationBlock(std::istream &in,
 			loc.cgiExtension = ext;
 			loc.cgiPath      = path;
 		}
+		else if (line.find("fastcgi_pass") == 0)
+		{
+			/*
+			    fastcgi_pass unix:/run/app.sock;
+			    fastcgi_pass 127.0.0.1:9000;
+			    fastcgi_pass backends;           (bloc upstream)
+			*/
+			std::string value = readSingleValue(line, "fastcgi_pass");
+
+			loc.fastcgiEnabled = true;
+			if (value.compare(0, 5, "unix:") != 0 &&
+			    value.find(':') == std::string::npos)
+				loc.upstream = value;        // voir resolveUpstreams()
+			else
+				loc.fastcgiPass = parseSocketAddress(value, "fastcgi_pass");
+		}
+		else if (line.find("proxy_pass") == 0)
+		{
+			/*
+			    proxy_pass http://127.0.0.1:8000;
+			    proxy_pass http://localhost:8000/v1/;   (URI : remplace le
+			                                             préfixe de la location)
+			    proxy_pass unix:/run/app.sock;
+			    proxy_pass http://backends/;         (bloc upstream)
+			*/
+			std::string value = readSingleValue(line, "proxy_pass");
+
+			if (value.compare(0, 5, "unix:") == 0)
+				loc.proxyPass = parseSocketAddress(value, "proxy_pass");
+			else if (value.compare(0, 7, "http://") == 0)
+			{
+				std::string rest = value.substr(7);
+				std::size_t slash = rest.find('/');
+				std::string authority = rest.substr(0, slash);
+				if (authority.empty())
+					throw std::runtime_error("Invalid proxy_pass value (missing host): " + value);
+				if (authority.find(':') == std::string::npos)
+					loc.upstream = authority;    // voir resolveUpstreams()
+				else
+					loc.proxyPass = parseSocketAddress(authority, "proxy_pass");
+				if (slash != std::string::npos)
+					loc.proxyUri = rest.substr(slash);
+			}
+			else
+				throw std::runtime_error("Invalid proxy_pass value (expected http://host[:port][/uri] or unix:/path): " + value);
+
+			loc.proxyEnabled = true;
+		}
+		else if (line.find("gzip_static") == 0)
+		{
+			std::string value = readSingleValue(line, "gzip_static");
+
+			if (value == "on")
+				loc.gzipStatic = true;
+			else if (value == "off")
+				loc.gzipStatic = false;
+			else
+				throw std::runtime_error("Invalid gzip_static value in location (expected 'on' or 'off'): " + value);
+		}
+		else if (line.find("compress_types") == 0)
+		{
+			std::istringstream iss(line);
+			std::string keyword;
+			std::string token;
+
+			iss >> keyword;
+			if (keyword != "compress_types")
+				throw std::runtime_error("Invalid compress_types directive in location (wrong keyword)");
+
+			std::set<std::string> types;
+			bool ended = false;
+
+			while (iss >> token)
+			{
+				if (!token.empty() && token[token.size() - 1] == ';')
+				{
+					token.erase(token.size() - 1);
+					ended = true;
+				}
+				for (std::size_t j = 0; j < token.size(); ++j)
+				{
+					if (token[j] >= 'A' && token[j] <= 'Z')
+						token[j] = static_cast<char>(token[j] - 'A' + 'a');
+				}
+				if (!token.empty())
+					types.insert(token);
+				if (ended)
+					break;
+			}
+
+			if (!ended)
+				throw std::runtime_error("Invalid compress_types directive in location (missing ';')");
+			if (types.empty())
+				throw std::runtime_error("Invalid compress_types directive in location (no types)");
+
+			loc.compressTypes = types;
+		}
+		else if (line.find("compress_min_length") == 0)
+		{
+			std::string value = readSingleValue(line, "compress_min_length");
+			loc.compressMinLength =
+			    static_cast<std::size_t>(parseSize(value, "compress_min_length"));
+		}
+		else if (line.find("compress_level") == 0)
+		{
+			std::string value = readSingleValue(line, "compress_level");
+			unsigned long tmp = parseNumber(value, "compress_level");
+			if (tmp < 1 || tmp > 9)
+				throw std::runtime_error("compress_level must be between 1 and 9");
+			loc.compressLevel = static_cast<int>(tmp);
+		}
+		else if (line.find("compress") == 0)
+		{
+			std::string value = readSingleValue(line, "compress");
+
+			if (value == "on")
+				loc.compress = true;
+			else if (value == "off")
+				loc.compress = false;
+			else
+				throw std::runtime_error("Invalid compress value in location (expected 'on' or 'off'): " + value);
+		}
 		else
 		{
 			throw std::runtime_error("Unknown directive inside location block: " + line);
 		}
 	}
+
+	if (loc.cgiEnabled && loc.fastcgiEnabled)
+		throw std::runtime_error("cgi and fastcgi_pass cannot be used in the same location: " + loc.path);
+	if (loc.cgiPoolSize > 0 && !loc.cgiEnabled)
+		throw std::runtime_error("cgi_pool requires a cgi directive in location: " + loc.path);
+	if (loc.cgiPoolSize > 0 && loc.cgiPoolRunner.empty())
+		throw std::runtime_error("cgi_pool requires cgi_pool_runner in location: " + loc.path);
+	if ((loc.cgiMaxConcurrency > 0 || loc.cgiQueueSize > 0) && !loc.cgiEnabled)
+		throw std::runtime_error("cgi_max_concurrency / cgi_queue_size require a cgi directive in location: " + loc.path);
+	if (loc.cgiQueueSize > 0 && loc.cgiMaxConcurrency == 0)
+		throw std::runtime_error("cgi_queue_size requires cgi_max_concurrency in location: " + loc.path);
+	if (loc.cgiStatus && (loc.cgiEnabled || loc.fastcgiEnabled))
+		throw std::runtime_error("cgi_status cannot be combined with cgi or fastcgi_pass in location: " + loc.path);
+	if (loc.proxyEnabled && (loc.cgiEnabled || loc.fastcgiEnabled || loc.cgiStatus))
+		throw std::runtime_error("proxy_pass cannot be combined with cgi, fastcgi_pass or cgi_status in location: " + loc.path);
+}
+
+/*
+    parseSocketAddress()
+
+    "unix:/chemin" (socket Unix) ou "host:port" (fastcgi_pass,
+    proxy_pass). Le nom d'hôte est résolu ici, au chargement : la boucle
+    d'événements ne fait jamais de DNS (le résultat est "ip:port", IPv4).
+    directive : pour les messages d'erreur.
+*/
+std::string Config::parseSocketAddress(const std::string &value,
+                                       const std::string &directive) const
+{
+	if (value.compare(0, 5, "unix:") == 0)
+	{
+		std::string path = value.substr(5);
+		if (path.empty())
+			throw std::runtime_error("Invalid " + directive + " value (empty unix socket path): " + value);
+		struct sockaddr_un sun;
+		if (path.size() >= sizeof(sun.sun_path))
+			throw std::runtime_error("Invalid " + directive + " value (unix socket path too long): " + value);
+		return value;
+	}
+
+	std::size_t colonPos = value.rfind(':');
+	if (colonPos == std::string::npos || colonPos == 0)
+		throw std::runtime_error("Invalid " + directive + " value (expected unix:/path or host:port): " + value);
+
+	std::string host = value.substr(0, colonPos);
+	std::string portStr = value.substr(colonPos + 1);
+
+	unsigned long port = portStr.empty() ? 0 : parseNumber(portStr, directive + " port");
+	if (port == 0 || port > 65535)
+		throw std::runtime_error("Invalid port in " + directive + " directive: " + portStr);
+
+	struct addrinfo hints;
+	std::memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+
+	struct addrinfo *res = NULL;
+	if (getaddrinfo(host.c_str(), NULL, &hints, &res) != 0 || !res)
+		throw std::runtime_error("Cannot resolve " + directive + " host: " + host);
+
+	char ip[INET_ADDRSTRLEN];
+	const struct sockaddr_in *sin =
+	    reinterpret_cast<const struct sockaddr_in *>(res->ai_addr);
+	const char *ok = inet_ntop(AF_INET, &sin->sin_addr, ip, sizeof(ip));
+	freeaddrinfo(res);
+	if (!ok)
+		throw std::runtime_error("Cannot resolve " + directive + " host: " + host);
+
+	return std::string(ip) + ":" + portStr;
 }
 
 const std::vector<ServerConfig> &Config::getServers() const
@@ -784,3 +1536,8 @@ const std::vector<ServerConfig> &Config::getServers() const
 	return _servers;
 }
 
+const GlobalConfig &Config::getGlobal() const
+{
+	return _global;
+}
+
@@ -0,0 +1,695 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   FastCgiConnection.cpp                              :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "FastCgiConnection.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <algorithm>   // std::min
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>       // sockaddr_un
+#include <netinet/in.h>
+#include <netinet/tcp.h>  // TCP_NODELAY
+#include <arpa/inet.h>    // inet_pton
+
+namespace
+{
+	// Protocole FastCGI 1.0 (types de records, rôles, statuts)
+	static const unsigned char FCGI_VERSION_1 = 1;
+
+	static const unsigned char FCGI_BEGIN_REQUEST = 1;
+	static const unsigned char FCGI_ABORT_REQUEST = 2;
+	static const unsigned char FCGI_END_REQUEST = 3;
+	static const unsigned char FCGI_PARAMS = 4;
+	static const unsigned char FCGI_STDIN = 5;
+	static const unsigned char FCGI_STDOUT = 6;
+	static const unsigned char FCGI_STDERR = 7;
+	static const unsigned char FCGI_GET_VALUES = 9;
+	static const unsigned char FCGI_GET_VALUES_RESULT = 10;
+
+	static const unsigned char FCGI_RESPONDER = 1;
+	static const unsigned char FCGI_KEEP_CONN = 1;
+	static const int FCGI_REQUEST_COMPLETE = 0;
+
+	static const std::size_t FCGI_HEADER_LEN = 8;
+
+	// Contenu max d'un record (multiple de 8 : pas de padding)
+	static const std::size_t FCGI_MAX_CONTENT = 65528;
+
+	// Requêtes max en parallèle sur une connexion qui multiplexe
+	static const std::size_t FASTCGI_MAX_MULTIPLEX = 16;
+
+	static void closeFd(int &fd)
+	{
+		if (fd >= 0)
+			close(fd);
+		fd = -1;
+	}
+
+	static bool setNonBlocking(int fd)
+	{
+		int flags = fcntl(fd, F_GETFL, 0);
+		return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0 &&
+		       fcntl(fd, F_SETFD, FD_CLOEXEC) == 0;
+	}
+
+	// Non bloquant + close-on-exec dès la création : un CGI lancé par un
+	// autre thread entre socket() et fcntl() n'hérite pas du fd
+	static int openSocket(int family)
+	{
+#ifdef __linux__
+		return socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+#else
+		int fd = socket(family, SOCK_STREAM, 0);
+		if (fd >= 0 && !setNonBlocking(fd))
+		{
+			close(fd);
+			return -1;
+		}
+		return fd;
+#endif
+	}
+
+	// Longueur d'un name-value pair : 1 octet (< 128) ou 4 (bit haut à 1)
+	static void appendLength(std::string &out, std::size_t len)
+	{
+		if (len < 128)
+		{
+			out += static_cast<char>(len);
+			return;
+		}
+		out += static_cast<char>(((len >> 24) & 0x7f) | 0x80);
+		out += static_cast<char>((len >> 16) & 0xff);
+		out += static_cast<char>((len >> 8) & 0xff);
+		out += static_cast<char>(len & 0xff);
+	}
+
+	static bool readLength(const unsigned char *p, std::size_t len,
+	                       std::size_t &pos, std::size_t &out)
+	{
+		if (pos >= len)
+			return false;
+		if (p[pos] < 128)
+		{
+			out = p[pos++];
+			return true;
+		}
+		if (len - pos < 4)
+			return false;
+		out = (static_cast<std::size_t>(p[pos] & 0x7f) << 24) |
+		      (static_cast<std::size_t>(p[pos + 1]) << 16) |
+		      (static_cast<std::size_t>(p[pos + 2]) << 8) |
+		      static_cast<std::size_t>(p[pos + 3]);
+		pos += 4;
+		return true;
+	}
+}
+
+/*
+ * Implémentation de FastCgiRequest
+ */
+
+FastCgiRequest::FastCgiRequest()
+	: CgiOutput(),
+	  job(NULL),
+	  _conn(NULL),
+	  _id(0),
+	  _failed(false),
+	  _appStatus(0),
+	  _protocolStatus(-1)
+{
+}
+
+FastCgiRequest::~FastCgiRequest()
+{
+	if (_conn)
+		_conn->detach(*this);
+}
+
+FastCgiConnection *FastCgiRequest::connection() const
+{
+	return _conn;
+}
+
+bool FastCgiRequest::succeeded() const
+{
+	if (!_failed && _protocolStatus == FCGI_REQUEST_COMPLETE && _appStatus == 0)
+		return true;
+
+	std::cerr << "FastCGI request failed: " << _scriptPath;
+	if (_failed)
+		std::cerr << " (connection lost)";
+	else if (_protocolStatus != FCGI_REQUEST_COMPLETE)
+		std::cerr << " (protocol status " << _protocolStatus << ")";
+	else
+		std::cerr << " (app status " << _appStatus << ")";
+	std::cerr << std::endl;
+	return false;
+}
+
+/*
+ * Implémentation de FastCgiConnection
+ */
+
+FastCgiConnection::FastCgiConnection(const std::string &address)
+	: timer(),
+	  dispatching(false),
+	  _fd(-1),
+	  _address(address),
+	  _connecting(false),
+	  _broken(false),
+	  _wbuf(),
+	  _wOff(0),
+	  _rbuf(),
+	  _requests(),
+	  _active(0),
+	  _nextId(0),
+	  _maxRequests(1),
+	  _paused(0)
+{
+}
+
+FastCgiConnection::~FastCgiConnection()
+{
+	// Requêtes encore attachées : elles ne recevront plus rien
+	for (RequestMap::iterator it = _requests.begin(); it != _requests.end(); ++it)
+	{
+		if (!it->second)
+			continue;
+		it->second->_failed = true;
+		it->second->_eof = true;
+		it->second->_conn = NULL;
+	}
+	closeFd(_fd);
+}
+
+/*
+ * open()
+ *
+ *  - address : "unix:/chemin" ou "ip:port" (résolu par Config).
+ *  - le connect() se termine plus tard (EV_WRITE, voir flush()).
+ *  - premier record : FCGI_GET_VALUES, pour savoir si l'application
+ *    accepte plusieurs requêtes sur la même connexion.
+ */
+bool FastCgiConnection::open()
+{
+	struct sockaddr_un sun;
+	struct sockaddr_in sin;
+	struct sockaddr   *sa;
+	socklen_t          saLen;
+
+	if (_address.compare(0, 5, "unix:") == 0)
+	{
+		std::memset(&sun, 0, sizeof(sun));
+		sun.sun_family = AF_UNIX;
+		std::strncpy(sun.sun_path, _address.c_str() + 5, sizeof(sun.sun_path) - 1);
+		sa = reinterpret_cast<struct sockaddr *>(&sun);
+		saLen = sizeof(sun);
+	}
+	else
+	{
+		std::size_t colon = _address.rfind(':');
+		std::memset(&sin, 0, sizeof(sin));
+		sin.sin_family = AF_INET;
+		sin.sin_port = htons(static_cast<uint16_t>(
+		    std::atoi(_address.c_str() + colon + 1)));
+		if (inet_pton(AF_INET, _address.substr(0, colon).c_str(),
+		              &sin.sin_addr) != 1)
+			return false;
+		sa = reinterpret_cast<struct sockaddr *>(&sin);
+		saLen = sizeof(sin);
+	}
+
+	_fd = openSocket(sa->sa_family);
+	if (_fd < 0)
+	{
+		std::cerr << "Error: socket() for FastCGI failed: "
+		          << std::strerror(errno) << std::endl;
+		closeFd(_fd);
+		return false;
+	}
+
+	if (sa->sa_family == AF_INET)
+	{
+		int one = 1;
+		setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	}
+
+	if (connect(_fd, sa, saLen) < 0)
+	{
+		if (errno != EINPROGRESS)
+		{
+			std::cerr << "Error: connect() to FastCGI " << _address
+			          << " failed: " << std::strerror(errno) << std::endl;
+			closeFd(_fd);
+			return false;
+		}
+		_connecting = true;
+	}
+
+	timer.fd = _fd;
+
+	std::string names;
+	appendLength(names, 15);
+	appendLength(names, 0);
+	names += "FCGI_MPXS_CONNS";
+	appendLength(names, 13);
+	appendLength(names, 0);
+	names += "FCGI_MAX_REQS";
+	appendRecord(FCGI_GET_VALUES, 0, names.data(), names.size());
+	return true;
+}
+
+bool FastCgiConnection::adopt(int fd)
+{
+	_fd = fd;
+	if (!setNonBlocking(_fd))
+	{
+		closeFd(_fd);
+		return false;
+	}
+	timer.fd = _fd;
+	return true;
+}
+
+int FastCgiConnection::fd() const
+{
+	return _fd;
+}
+
+const std::string &FastCgiConnection::address() const
+{
+	return _address;
+}
+
+std::size_t FastCgiConnection::active() const
+{
+	return _active;
+}
+
+bool FastCgiConnection::idle() const
+{
+	return _requests.empty();
+}
+
+bool FastCgiConnection::broken() const
+{
+	return _broken;
+}
+
+bool FastCgiConnection::connecting() const
+{
+	return _connecting;
+}
+
+bool FastCgiConnection::canAccept() const
+{
+	return !_broken && _paused == 0 && _requests.size() < _maxRequests;
+}
+
+void FastCgiConnection::activeRequests(std::vector<FastCgiRequest *> &out) const
+{
+	for (RequestMap::const_iterator it = _requests.begin();
+	     it != _requests.end(); ++it)
+	{
+		if (it->second)
+			out.push_back(it->second);
+	}
+}
+
+void FastCgiConnection::appendRecord(unsigned char type, unsigned short id,
+                                     const char *data, std::size_t len)
+{
+	char header[FCGI_HEADER_LEN];
+	header[0] = static_cast<char>(FCGI_VERSION_1);
+	header[1] = static_cast<char>(type);
+	header[2] = static_cast<char>((id >> 8) & 0xff);
+	header[3] = static_cast<char>(id & 0xff);
+	header[4] = static_cast<char>((len >> 8) & 0xff);
+	header[5] = static_cast<char>(len & 0xff);
+	header[6] = 0; // padding
+	header[7] = 0;
+
+	_wbuf.append(header, FCGI_HEADER_LEN);
+	if (len > 0)
+		_wbuf.append(data, len);
+}
+
+// Flux (PARAMS, STDIN) : records de FCGI_MAX_CONTENT max, puis un
+// record vide qui marque la fin.
+void FastCgiConnection::appendStream(unsigned char type, unsigned short id,
+                                     const std::string &data)
+{
+	for (std::size_t off = 0; off < data.size(); off += FCGI_MAX_CONTENT)
+		appendRecord(type, id, data.data() + off,
+		             std::min(FCGI_MAX_CONTENT, data.size() - off));
+	appendRecord(type, id, NULL, 0);
+}
+
+/*
+ * submit()
+ *
+ *  - env : variables "NOM=valeur" (les mêmes que pour un CGI local),
+ *    envoyées en name-value pairs dans FCGI_PARAMS.
+ */
+void FastCgiConnection::submit(FastCgiRequest &req,
+                               const std::string &scriptPath,
+                               const std::vector<std::string> &env,
+                               const std::string &body)
+{
+	do
+		++_nextId;
+	while (_nextId == 0 || _requests.count(_nextId));
+
+	req._conn = this;
+	req._id = _nextId;
+	req._scriptPath = scriptPath;
+	_requests[_nextId] = &req;
+	++_active;
+
+	char begin[8];
+	std::memset(begin, 0, sizeof(begin));
+	begin[1] = static_cast<char>(FCGI_RESPONDER);
+	begin[2] = static_cast<char>(FCGI_KEEP_CONN);
+	appendRecord(FCGI_BEGIN_REQUEST, _nextId, begin, sizeof(begin));
+
+	std::string params;
+	for (std::size_t i = 0; i < env.size(); ++i)
+	{
+		std::size_t eq = env[i].find('=');
+		if (eq == std::string::npos)
+			continue;
+		appendLength(params, eq);
+		appendLength(params, env[i].size() - eq - 1);
+		params.append(env[i], 0, eq);
+		params.append(env[i], eq + 1, std::string::npos);
+	}
+	appendStream(FCGI_PARAMS, _nextId, params);
+	appendStream(FCGI_STDIN, _nextId, body);
+}
+
+/*
+ * detach()
+ *
+ *  - requête détruite avant son END_REQUEST : FCGI_ABORT_REQUEST, et
+ *    l'id reste réservé jusqu'à la réponse de l'application.
+ */
+void FastCgiConnection::detach(FastCgiRequest &req)
+{
+	--_active;
+	req._conn = NULL;
+
+	if (_broken)
+	{
+		_requests.erase(req._id);
+		return;
+	}
+	_requests[req._id] = NULL;
+	appendRecord(FCGI_ABORT_REQUEST, req._id, NULL, 0);
+}
+
+void FastCgiConnection::withdraw(FastCgiRequest &req)
+{
+	_broken = true;
+	_requests.erase(req._id);
+	--_active;
+	req._conn = NULL;
+}
+
+bool FastCgiConnection::wantsWrite() const
+{
+	return _connecting || _wOff < _wbuf.size();
+}
+
+bool FastCgiConnection::flush()
+{
+	if (_broken)
+		return false;
+
+	if (_connecting)
+	{
+		int err = 0;
+		socklen_t len = sizeof(err);
+		if (getsockopt(_fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+			err = errno;
+		if (err != 0)
+		{
+			std::cerr << "Error: connect() to FastCGI " << _address
+			          << " failed: " << std::strerror(err) << std::endl;
+			_broken = true;
+			return false;
+		}
+		_connecting = false;
+	}
+
+	while (_wOff < _wbuf.size())
+	{
+		ssize_t n = write(_fd, _wbuf.data() + _wOff, _wbuf.size() - _wOff);
+		if (n > 0)
+		{
+			_wOff += static_cast<std::size_t>(n);
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return true; // on attend EV_WRITE
+		if (n < 0 && errno == ENOTCONN)
+		{
+			_connecting = true; // connect() pas encore terminé
+			return true;
+		}
+
+		std::cerr << "Error: write() to FastCGI " << _address << " failed: "
+		          << std::strerror(errno) << std::endl;
+		_broken = true;
+		return false;
+	}
+
+	// Tout est parti : un gros body POST ne garde pas sa mémoire
+	if (_wbuf.capacity() > 64 * 1024)
+		std::string().swap(_wbuf);
+	else
+		_wbuf.clear();
+	_wOff = 0;
+	return true;
+}
+
+FastCgiConnection::ReadResult
+FastCgiConnection::readRecords(std::size_t limit,
+                               std::vector<FastCgiRequest *> &touched)
+{
+	if (_connecting)
+		return READ_WAIT; // rien à lire avant la fin du connect()
+
+	char buf[16384];
+	std::size_t got = 0;
+	ReadResult result = READ_MORE;
+	bool eof = false;
+
+	while (got < limit)
+	{
+		ssize_t n = read(_fd, buf, sizeof(buf));
+		if (n > 0)
+		{
+			_rbuf.append(buf, static_cast<std::size_t>(n));
+			got += static_cast<std::size_t>(n);
+			continue;
+		}
+		if (n == 0)
+		{
+			eof = true;
+			break;
+		}
+		if (errno == EINTR)
+			continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+		{
+			result = READ_WAIT;
+			break;
+		}
+
+		std::cerr << "Error: read() from FastCGI " << _address << " failed: "
+		          << std::strerror(errno) << std::endl;
+		eof = true;
+		break;
+	}
+
+	// Records complets : header (8 octets) + contenu + padding
+	std::size_t off = 0;
+	while (_rbuf.size() - off >= FCGI_HEADER_LEN)
+	{
+		const unsigned char *h =
+		    reinterpret_cast<const unsigned char *>(_rbuf.data() + off);
+		if (h[0] != FCGI_VERSION_1)
+		{
+			std::cerr << "Error: invalid FastCGI record from "
+			          << _address << std::endl;
+			eof = true;
+			off = _rbuf.size();
+			break;
+		}
+
+		unsigned short id = static_cast<unsigned short>((h[2] << 8) | h[3]);
+		std::size_t len = (static_cast<std::size_t>(h[4]) << 8) | h[5];
+		std::size_t total = FCGI_HEADER_LEN + len + h[6];
+		if (_rbuf.size() - off < total)
+			break;
+
+		dispatch(h[1], id, _rbuf.data() + off + FCGI_HEADER_LEN, len, touched);
+		off += total;
+	}
+	_rbuf.erase(0, off);
+
+	if (eof)
+	{
+		_broken = true;
+		return READ_EOF;
+	}
+	return result;
+}
+
+void FastCgiConnection::dispatch(unsigned char type, unsigned short id,
+                                 const char *data, std::size_t len,
+                                 std::vector<FastCgiRequest *> &touched)
+{
+	if (id == 0)
+	{
+		// Record de gestion
+		if (type == FCGI_GET_VALUES_RESULT)
+			readValues(data, len);
+		return;
+	}
+
+	RequestMap::iterator it = _requests.find(id);
+	if (it == _requests.end())
+		return;
+	FastCgiRequest *req = it->second; // NULL : abandonnée
+
+	if (type == FCGI_STDOUT)
+	{
+		if (!req || len == 0)
+			return;
+		req->_output.append(data, len);
+	}
+	else if (type == FCGI_STDERR)
+	{
+		std::string msg(data, len);
+		while (!msg.empty() && (msg[msg.size() - 1] == '\n' ||
+		                        msg[msg.size() - 1] == '\r'))
+			msg.erase(msg.size() - 1);
+		if (req && !msg.empty())
+			std::cerr << "FastCGI stderr (" << req->_scriptPath << "): "
+			          << msg << std::endl;
+		return;
+	}
+	else if (type == FCGI_END_REQUEST)
+	{
+		_requests.erase(it);
+		if (!req)
+			return;
+		--_active;
+
+		const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+		if (len >= 5)
+		{
+			req->_appStatus = (static_cast<unsigned long>(p[0]) << 24) |
+			                  (static_cast<unsigned long>(p[1]) << 16) |
+			                  (static_cast<unsigned long>(p[2]) << 8) |
+			                  static_cast<unsigned long>(p[3]);
+			req->_protocolStatus = p[4];
+		}
+		req->_eof = true;
+		req->_conn = NULL;
+	}
+	else
+		return;
+
+	for (std::size_t i = 0; i < touched.size(); ++i)
+	{
+		if (touched[i] == req)
+			return;
+	}
+	touched.push_back(req);
+}
+
+// FCGI_GET_VALUES_RESULT : FCGI_MPXS_CONNS / FCGI_MAX_REQS
+void FastCgiConnection::readValues(const char *data, std::size_t len)
+{
+	const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+	std::size_t pos = 0;
+	bool multiplex = false;
+	std::size_t maxReqs = FASTCGI_MAX_MULTIPLEX;
+
+	while (pos < len)
+	{
+		std::size_t nameLen;
+		std::size_t valueLen;
+		if (!readLength(p, len, pos, nameLen) ||
+		    !readLength(p, len, pos, valueLen) ||
+		    len - pos < nameLen + valueLen)
+			break;
+
+		std::string name(data + pos, nameLen);
+		std::string value(data + pos + nameLen, valueLen);
+		pos += nameLen + valueLen;
+
+		if (name == "FCGI_MPXS_CONNS")
+			multiplex = (value == "1");
+		else if (name == "FCGI_MAX_REQS")
+		{
+			std::size_t n = static_cast<std::size_t>(std::atol(value.c_str()));
+			if (n > 0 && n < maxReqs)
+				maxReqs = n;
+		}
+	}
+
+	_maxRequests = multiplex ? maxReqs : 1;
+}
+
+void FastCgiConnection::fail(std::vector<FastCgiRequest *> &touched)
+{
+	_broken = true;
+
+	for (RequestMap::iterator it = _requests.begin(); it != _requests.end(); ++it)
+	{
+		FastCgiRequest *req = it->second;
+		if (!req)
+			continue;
+		req->_failed = true;
+		req->_eof = true;
+		req->_conn = NULL;
+		touched.push_back(req);
+	}
+	_requests.clear();
+	_active = 0;
+}
+
+void FastCgiConnection::pause()
+{
+	++_paused;
+}
+
+void FastCgiConnection::resume()
+{
+	if (_paused > 0)
+		--_paused;
+}
+
+bool FastCgiConnection::paused() const
+{
+	return _paused > 0;
+}
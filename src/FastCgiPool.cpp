@@ -0,0 +1,92 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   FastCgiPool.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "FastCgiPool.hpp"
+
+FastCgiPool::FastCgiPool()
+	: _conns()
+{
+}
+
+FastCgiPool::~FastCgiPool()
+{
+	for (ConnMap::iterator it = _conns.begin(); it != _conns.end(); ++it)
+	{
+		for (std::size_t i = 0; i < it->second.size(); ++i)
+			delete it->second[i];
+	}
+}
+
+FastCgiConnection *FastCgiPool::find(const std::string &address)
+{
+	ConnMap::iterator it = _conns.find(address);
+	if (it == _conns.end())
+		return NULL;
+
+	FastCgiConnection *best = NULL;
+	for (std::size_t i = 0; i < it->second.size(); ++i)
+	{
+		FastCgiConnection *conn = it->second[i];
+		if (conn->canAccept() && (!best || conn->active() < best->active()))
+			best = conn;
+	}
+	return best;
+}
+
+FastCgiConnection *FastCgiPool::open(const std::string &address)
+{
+	FastCgiConnection *conn = new FastCgiConnection(address);
+	if (!conn->open())
+	{
+		delete conn;
+		return NULL;
+	}
+
+	_conns[address].push_back(conn);
+	return conn;
+}
+
+void FastCgiPool::close(FastCgiConnection *conn)
+{
+	ConnMap::iterator it = _conns.find(conn->address());
+	if (it != _conns.end())
+	{
+		std::vector<FastCgiConnection *> &list = it->second;
+		for (std::size_t i = 0; i < list.size(); ++i)
+		{
+			if (list[i] == conn)
+			{
+				list[i] = list.back();
+				list.pop_back();
+				break;
+			}
+		}
+		if (list.empty())
+			_conns.erase(it);
+	}
+	delete conn;
+}
+
+std::size_t FastCgiPool::idle(const std::string &address) const
+{
+	ConnMap::const_iterator it = _conns.find(address);
+	if (it == _conns.end())
+		return 0;
+
+	std::size_t count = 0;
+	for (std::size_t i = 0; i < it->second.size(); ++i)
+	{
+		if (it->second[i]->idle())
+			++count;
+	}
+	return count;
+}
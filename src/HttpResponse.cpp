@@ -14,13 +14,36 @@
 
 #include <sstream> // std::ostringstream
 
+namespace
+{
+	static bool sameHeaderName(const std::string &a, const std::string &b)
+	{
+		if (a.size() != b.size())
+			return false;
+		for (std::size_t i = 0; i < a.size(); ++i)
+		{
+			char x = a[i];
+			char y = b[i];
+			if (x >= 'A' && x <= 'Z')
+				x = static_cast<char>(x - 'A' + 'a');
+			if (y >= 'A' && y <= 'Z')
+				y = static_cast<char>(y - 'A' + 'a');
+			if (x != y)
+				return false;
+		}
+		return true;
+	}
+}
+
 HttpResponse::HttpResponse()
-	: _statusCode(200), _reasonPhrase("OK"), _headers(), _body()
+	: _statusCode(200), _reasonPhrase("OK"), _headers(), _body(),
+	  _parts(), _cached(NULL), _streamed(false)
 {
 }
 
 HttpResponse::~HttpResponse()
 {
+	releaseParts();
 }
 
 void HttpResponse::setStatus(int code, const std::string &reason)
@@ -29,22 +52,140 @@ void HttpResponse::setStatus(int code, const std::string &reason)
 	_reasonPhrase = reason;
 }
 
+// Oublie les parties et rend les références (fichiers, entrée du cache)
+void HttpResponse::releaseParts()
+{
+	for (std::size_t i = 0; i < _parts.size(); ++i)
+		OpenFileCache::release(_parts[i].file);
+	_parts.clear();
+
+	ResponseCache::release(_cached);
+	_cached = NULL;
+}
+
+std::size_t HttpResponse::bodyLength() const
+{
+	std::size_t len = _body.size();
+
+	for (std::size_t i = 0; i < _parts.size(); ++i)
+		len += _parts[i].file ? _parts[i].length : _parts[i].data.size();
+	return len;
+}
+
 void HttpResponse::setBody(const std::string &body)
 {
+	releaseParts();
 	_body = body;
 }
 
+void HttpResponse::swapBody(std::string &body)
+{
+	releaseParts();
+	_body.swap(body);
+}
+
+void HttpResponse::setFileBody(OpenFileCache::Entry *file, off_t offset,
+                               std::size_t length)
+{
+	releaseParts();
+	std::string().swap(_body);
+	appendFilePart(file, offset, length);
+}
+
+void HttpResponse::appendBodyPart(const std::string &data)
+{
+	_parts.push_back(Part());
+	_parts.back().data = data;
+	_parts.back().file = NULL;
+	_parts.back().offset = 0;
+	_parts.back().length = 0;
+}
+
+void HttpResponse::appendFilePart(OpenFileCache::Entry *file, off_t offset,
+                                  std::size_t length)
+{
+	_parts.push_back(Part());
+	_parts.back().file = file;
+	_parts.back().offset = offset;
+	_parts.back().length = length;
+}
+
+void HttpResponse::moveBodyTo(OutputQueue &out)
+{
+	out.append(_body);
+
+	for (std::size_t i = 0; i < _parts.size(); ++i)
+	{
+		Part &part = _parts[i];
+		if (part.file)
+			out.appendFile(part.file, part.offset, part.length);
+		else
+			out.append(part.data);
+	}
+	// Les références sont passées à out
+	_parts.clear();
+}
+
+void HttpResponse::setCachedBody(ResponseCache::Entry *entry)
+{
+	releaseParts();
+	std::string().swap(_body);
+	_cached = entry;
+}
+
+bool HttpResponse::hasCachedBody() const
+{
+	return _cached != NULL;
+}
+
+ResponseCache::Entry *HttpResponse::releaseCachedBody()
+{
+	ResponseCache::Entry *entry = _cached;
+
+	_cached = NULL;
+	return entry;
+}
+
 void HttpResponse::setHeader(const std::string &name, const std::string &value)
 {
+	removeHeader(name);
 	_headers[name] = value;
 }
 
+std::string HttpResponse::getHeader(const std::string &name) const
+{
+	std::map<std::string, std::string>::const_iterator it = _headers.begin();
+	for (; it != _headers.end(); ++it)
+	{
+		if (sameHeaderName(it->first, name))
+			return it->second;
+	}
+	return std::string();
+}
+
+void HttpResponse::removeHeader(const std::string &name)
+{
+	std::map<std::string, std::string>::iterator it = _headers.begin();
+	while (it != _headers.end())
+	{
+		if (sameHeaderName(it->first, name))
+			_headers.erase(it++);
+		else
+			++it;
+	}
+}
+
+void HttpResponse::setStreamedBody()
+{
+	_streamed = true;
+}
+
 int HttpResponse::getStatusCode() const
 {
 	return _statusCode;
 }
 
-std::string HttpResponse::toString() const
+std::string HttpResponse::serializeHeaders() const
 {
 	std::ostringstream oss;
 
@@ -59,9 +200,9 @@ std::string HttpResponse::toString() const
 	for (; it != _headers.end(); ++it)
 	{
 		oss << it->first << ": " << it->second << "\r\n";
-		if (it->first == "Content-Length")
+		if (sameHeaderName(it->first, "Content-Length"))
 			hasContentLength = true;
-		else if (it->first == "Server")
+		else if (sameHeaderName(it->first, "Server"))
 			hasServer = true;
 	}
 
@@ -69,16 +210,16 @@ std::string HttpResponse::toString() const
 	if (!hasServer)
 		oss << "Server: webserv/0.1\r\n";
 
-	// Header Content-Length automatique si non fourni
-	if (!hasContentLength)
-		oss << "Content-Length: " << _body.size() << "\r\n";
+	// Header Content-Length automatique si non fourni (pas pour un 304 :
+	// il décrirait la représentation, pas ce body vide ; ni pour un 204,
+	// qui n'en a jamais ; ni pour un body streamé, de taille inconnue)
+	if (!hasContentLength && _statusCode != 304 && _statusCode != 204 &&
+	    !_streamed)
+		oss << "Content-Length: " << bodyLength() << "\r\n";
 
 	// Ligne vide qui sépare headers et body
 	oss << "\r\n";
 
-	// Corps de la réponse
-	oss << _body;
-
 	return oss.str();
 }
 
@@ -0,0 +1,207 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   MasterProcess.cpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "MasterProcess.hpp"
+#include "WebServer.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <exception>
+#include <unistd.h>    // fork, sleep, _exit
+#include <sys/wait.h>  // waitpid, WIFEXITED, WEXITSTATUS, WIFSIGNALED, WTERMSIG
+
+namespace
+{
+	// Positionné par SIGINT / SIGTERM sur le master
+	static volatile sig_atomic_t g_stopRequested = 0;
+
+	static void onStopSignal(int sig)
+	{
+		(void)sig;
+		g_stopRequested = 1;
+	}
+
+	// Pas de SA_RESTART : waitpid() doit être interrompu par le signal.
+	static void installHandler(int sig, void (*handler)(int))
+	{
+		struct sigaction sa;
+		std::memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = handler;
+		sigemptyset(&sa.sa_mask);
+		sa.sa_flags = 0;
+		sigaction(sig, &sa, NULL);
+	}
+}
+
+MasterProcess::MasterProcess(const std::vector<ServerConfig> &servers,
+                             const GlobalConfig &global)
+	: _servers(servers),
+	  _global(global),
+	  _workers(global.workerProcesses, -1),
+	  _spawnTimes(global.workerProcesses, 0)
+{
+}
+
+MasterProcess::~MasterProcess()
+{
+}
+
+/*
+ * spawnWorker()
+ *
+ *  - fork un worker pour le slot donné.
+ *  - le worker construit son propre WebServer (listeners SO_REUSEPORT)
+ *    et ne revient jamais dans le code du master.
+ */
+pid_t MasterProcess::spawnWorker(std::size_t slot)
+{
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		std::cerr << "Error: fork() of worker failed: "
+		          << std::strerror(errno) << std::endl;
+		return -1;
+	}
+
+	if (pid == 0)
+	{
+		// ===== Worker =====
+		installHandler(SIGINT, SIG_DFL);
+		installHandler(SIGTERM, SIG_DFL);
+
+		int code = 1;
+		try
+		{
+			WebServer server(_servers, _global);
+			server.run();
+			code = 0; // arrêt normal : pas un échec pour le master
+		}
+		catch (const std::exception &e)
+		{
+			std::cerr << "Error: worker " << getpid() << ": "
+			          << e.what() << std::endl;
+		}
+		std::cout.flush();
+		_exit(code);
+	}
+
+	_workers[slot] = pid;
+	_spawnTimes[slot] = std::time(0);
+
+	std::cout << "Worker " << slot << " started, pid = " << pid << std::endl;
+	return pid;
+}
+
+void MasterProcess::stopWorkers()
+{
+	for (std::size_t i = 0; i < _workers.size(); ++i)
+	{
+		if (_workers[i] > 0)
+			kill(_workers[i], SIGTERM);
+	}
+
+	for (std::size_t i = 0; i < _workers.size(); ++i)
+	{
+		if (_workers[i] <= 0)
+			continue;
+
+		int status;
+		while (waitpid(_workers[i], &status, 0) < 0 && errno == EINTR)
+			;
+		_workers[i] = -1;
+	}
+}
+
+/*
+ * run()
+ *
+ *  - lance les N workers puis attend leurs terminaisons.
+ *  - crash (signal) => relance du worker, au plus une fois par seconde
+ *    et par slot pour ne pas boucler sur un worker qui crashe en continu.
+ */
+int MasterProcess::run()
+{
+	installHandler(SIGINT, onStopSignal);
+	installHandler(SIGTERM, onStopSignal);
+
+	std::cout << "Master " << getpid() << ": starting "
+	          << _workers.size() << " worker(s)" << std::endl;
+
+	for (std::size_t i = 0; i < _workers.size(); ++i)
+	{
+		if (spawnWorker(i) < 0)
+		{
+			stopWorkers();
+			return 1;
+		}
+	}
+
+	int exitCode = 0;
+
+	while (!g_stopRequested)
+	{
+		int status = 0;
+		pid_t pid = waitpid(-1, &status, 0);
+
+		if (pid < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			std::cerr << "Error: waitpid() in master failed: "
+			          << std::strerror(errno) << std::endl;
+			exitCode = 1;
+			break;
+		}
+
+		std::size_t slot = _workers.size();
+		for (std::size_t i = 0; i < _workers.size(); ++i)
+		{
+			if (_workers[i] == pid)
+			{
+				slot = i;
+				break;
+			}
+		}
+		if (slot == _workers.size())
+			continue;
+
+		_workers[slot] = -1;
+
+		if (WIFEXITED(status) && WEXITSTATUS(status) != 0)
+		{
+			std::cerr << "Worker " << slot << " (pid " << pid
+			          << ") exited with code " << WEXITSTATUS(status)
+			          << ", stopping master" << std::endl;
+			exitCode = 1;
+			break;
+		}
+
+		std::cerr << "Worker " << slot << " (pid " << pid << ") died";
+		if (WIFSIGNALED(status))
+			std::cerr << " (signal " << WTERMSIG(status) << ")";
+		std::cerr << ", respawning" << std::endl;
+
+		if (std::time(0) - _spawnTimes[slot] < 1)
+			sleep(1);
+
+		if (!g_stopRequested && spawnWorker(slot) < 0)
+		{
+			exitCode = 1;
+			break;
+		}
+	}
+
+	stopWorkers();
+	return exitCode;
+}
@@ -0,0 +1,47 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Mutex.cpp                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Mutex.hpp"
+
+#include <stdexcept>
+
+Mutex::Mutex()
+{
+	if (pthread_mutex_init(&_mutex, NULL) != 0)
+		throw std::runtime_error("pthread_mutex_init() failed");
+}
+
+Mutex::~Mutex()
+{
+	pthread_mutex_destroy(&_mutex);
+}
+
+void Mutex::lock()
+{
+	pthread_mutex_lock(&_mutex);
+}
+
+void Mutex::unlock()
+{
+	pthread_mutex_unlock(&_mutex);
+}
+
+ScopedLock::ScopedLock(Mutex &mutex)
+	: _mutex(mutex)
+{
+	_mutex.lock();
+}
+
+ScopedLock::~ScopedLock()
+{
+	_mutex.unlock();
+}
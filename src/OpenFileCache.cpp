@@ -0,0 +1,346 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   OpenFileCache.cpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "OpenFileCache.hpp"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+	// Remplit les métadonnées d'une entrée à partir de stat()
+	static void fillFromStat(OpenFileCache::Entry &e, const std::string &path)
+	{
+		struct stat st;
+
+		if (stat(path.c_str(), &st) != 0)
+			return; // exists reste à false
+
+		e.exists = true;
+		e.isDir = S_ISDIR(st.st_mode);
+		e.isFile = S_ISREG(st.st_mode);
+		e.size = st.st_size;
+		e.mtime = st.st_mtime;
+		e.dev = st.st_dev;
+		e.ino = st.st_ino;
+	}
+
+	// Même fichier, inchangé (fresh : stat() refait à l'instant) ?
+	static bool sameFile(const OpenFileCache::Entry &cached,
+	                     const OpenFileCache::Entry &fresh)
+	{
+		if (cached.exists != fresh.exists)
+			return false;
+		if (!cached.exists)
+			return true;
+
+		return cached.ino == fresh.ino && cached.dev == fresh.dev &&
+		       cached.size == fresh.size && cached.mtime == fresh.mtime;
+	}
+}
+
+OpenFileCache::Entry::Entry()
+	: exists(false),
+	  isDir(false),
+	  isFile(false),
+	  size(0),
+	  mtime(0),
+	  fd(-1),
+	  path(),
+	  cache(NULL),
+	  dev(0),
+	  ino(0),
+	  refs(0),
+	  uses(0),
+	  validatedAt(0),
+	  lastUse(0),
+	  cached(false),
+	  lruPrev(NULL),
+	  lruNext(NULL)
+{
+}
+
+OpenFileCache::OpenFileCache(std::size_t maxEntries, unsigned long inactiveMs,
+                             unsigned long validMs, unsigned minUses)
+	: _mutex(),
+	  _entries(),
+	  _lruHead(NULL),
+	  _lruTail(NULL),
+	  _maxEntries(maxEntries),
+	  _inactiveMs(inactiveMs),
+	  _validMs(validMs),
+	  _minUses(minUses)
+{
+}
+
+OpenFileCache::~OpenFileCache()
+{
+	// Les entrées encore référencées sont détruites par leur release()
+	while (_lruHead)
+		detach(_lruHead);
+}
+
+OpenFileCache::Entry *OpenFileCache::createEntry(const std::string &path,
+                                                 unsigned long nowMs)
+{
+	Entry *e = new Entry();
+	e->path = path;
+	e->cache = this;
+	e->validatedAt = nowMs;
+	fillFromStat(*e, path);
+	return e;
+}
+
+void OpenFileCache::lruUnlink(Entry *e)
+{
+	if (e->lruPrev)
+		e->lruPrev->lruNext = e->lruNext;
+	else
+		_lruHead = e->lruNext;
+
+	if (e->lruNext)
+		e->lruNext->lruPrev = e->lruPrev;
+	else
+		_lruTail = e->lruPrev;
+
+	e->lruPrev = NULL;
+	e->lruNext = NULL;
+}
+
+void OpenFileCache::lruPushFront(Entry *e)
+{
+	e->lruPrev = NULL;
+	e->lruNext = _lruHead;
+	if (_lruHead)
+		_lruHead->lruPrev = e;
+	_lruHead = e;
+	if (!_lruTail)
+		_lruTail = e;
+}
+
+void OpenFileCache::destroy(Entry *e)
+{
+	if (e->fd >= 0)
+		close(e->fd);
+	delete e;
+}
+
+/*
+ * detach()
+ *
+ *  - retire l'entrée de la table. Si elle est encore utilisée, elle
+ *    sera détruite par le dernier release().
+ */
+void OpenFileCache::detach(Entry *e)
+{
+	if (!e->cached)
+		return;
+
+	_entries.erase(e->path);
+	lruUnlink(e);
+	e->cached = false;
+
+	if (e->refs == 0)
+		destroy(e);
+}
+
+/*
+ * expire()
+ *
+ *  - les entrées inutilisées depuis inactive sont en fin de LRU.
+ */
+void OpenFileCache::expire(unsigned long nowMs)
+{
+	while (_lruTail && nowMs >= _lruTail->lastUse &&
+	       nowMs - _lruTail->lastUse >= _inactiveMs)
+		detach(_lruTail);
+}
+
+/*
+ * acquire()
+ *
+ *  - le lock est partagé par tous les reactors : stat(), open() et
+ *    posix_fadvise() se font hors lock (un stat lent, NFS ou disque
+ *    froid, ne bloque pas les autres threads). Sous lock : recherche,
+ *    références, LRU, puis insertion de l'entrée construite entre-temps.
+ *  - course : si un autre thread a mis le chemin en cache (ou le fd
+ *    ouvert) pendant ce temps, on garde le sien et on jette le nôtre.
+ */
+OpenFileCache::Entry *OpenFileCache::acquire(const std::string &path,
+                                             bool wantFd,
+                                             unsigned long nowMs)
+{
+	Entry *e = NULL;
+	bool needFd;
+
+	if (_maxEntries == 0)
+	{
+		// Cache désactivé : entrée jetable, vue par ce seul appelant
+		e = createEntry(path, nowMs);
+		take(e, nowMs);
+		needFd = wantFd && e->isFile;
+	}
+	else
+	{
+		{
+			ScopedLock lock(_mutex);
+			expire(nowMs);
+			e = lookup(path, nowMs);
+			needFd = e && wantFd && e->isFile && e->fd < 0;
+		}
+		if (!e)
+		{
+			Entry *fresh = createEntry(path, nowMs);   // stat()
+
+			ScopedLock lock(_mutex);
+			e = insert(fresh, nowMs);
+			needFd = wantFd && e->isFile && e->fd < 0;
+		}
+	}
+
+	if (needFd)
+		openFd(e);
+	return e;
+}
+
+// Entrée encore valide (référencée), sinon NULL : absente, ou à
+// revérifier par stat(). Sous lock.
+OpenFileCache::Entry *OpenFileCache::lookup(const std::string &path,
+                                            unsigned long nowMs)
+{
+	EntryMap::iterator it = _entries.find(path);
+	if (it == _entries.end() || !isValid(*it->second, nowMs))
+		return NULL;
+
+	Entry *e = it->second;
+	lruUnlink(e);
+	lruPushFront(e);
+	take(e, nowMs);
+	return e;
+}
+
+/*
+ * insert()
+ *
+ *  - fresh : entrée construite hors lock (stat() fait). Sous lock.
+ *  - l'entrée en cache reste si un autre thread l'a revalidée entre-temps
+ *    ou si le fichier n'a pas changé (fresh est jetée) ; sinon fresh la
+ *    remplace.
+ */
+OpenFileCache::Entry *OpenFileCache::insert(Entry *fresh, unsigned long nowMs)
+{
+	EntryMap::iterator it = _entries.find(fresh->path);
+	Entry *e = (it != _entries.end()) ? it->second : NULL;
+
+	if (e && (isValid(*e, nowMs) || sameFile(*e, *fresh)))
+	{
+		if (!isValid(*e, nowMs))
+			e->validatedAt = nowMs;
+		delete fresh; // pas encore de fd
+		lruUnlink(e);
+	}
+	else
+	{
+		if (e)
+			detach(e); // fichier modifié ou remplacé
+		e = fresh;
+		e->cached = true;
+		_entries[e->path] = e;
+
+		if (_entries.size() > _maxEntries)
+			detach(_lruTail);
+	}
+	lruPushFront(e);
+	take(e, nowMs);
+	return e;
+}
+
+void OpenFileCache::take(Entry *e, unsigned long nowMs)
+{
+	++e->refs;
+	++e->uses;
+	e->lastUse = nowMs;
+}
+
+// Revérifiée depuis moins de valid (un autre reactor a pu la
+// revalider avec une horloge un peu en avance sur la nôtre).
+bool OpenFileCache::isValid(const Entry &e, unsigned long nowMs) const
+{
+	return nowMs < e.validatedAt || nowMs - e.validatedAt < _validMs;
+}
+
+// open() + posix_fadvise() hors lock ; le fd est posé sous lock, sauf
+// si un autre thread en a ouvert un entre-temps.
+void OpenFileCache::openFd(Entry *e)
+{
+	int fd = open(e->path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	{
+		ScopedLock lock(_mutex);
+		if (e->fd < 0)
+		{
+			e->fd = fd;
+			return;
+		}
+	}
+	close(fd);
+}
+
+void OpenFileCache::releaseLocked(Entry *e)
+{
+	if (--e->refs > 0)
+		return;
+
+	if (!e->cached)
+	{
+		destroy(e);
+		return;
+	}
+
+	// Fichier peu demandé : on garde les métadonnées, pas le fd
+	if (e->uses < _minUses && e->fd >= 0)
+	{
+		close(e->fd);
+		e->fd = -1;
+	}
+}
+
+void OpenFileCache::retain(Entry *entry)
+{
+	ScopedLock lock(entry->cache->_mutex);
+	++entry->refs;
+}
+
+void OpenFileCache::release(Entry *entry)
+{
+	if (!entry)
+		return;
+
+	OpenFileCache *cache = entry->cache;
+	ScopedLock lock(cache->_mutex);
+	cache->releaseLocked(entry);
+}
+
+void OpenFileCache::invalidate(const std::string &path)
+{
+	ScopedLock lock(_mutex);
+
+	EntryMap::iterator it = _entries.find(path);
+	if (it != _entries.end())
+		detach(it->second);
+}
@@ -0,0 +1,212 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   OutputQueue.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "OutputQueue.hpp"
+
+OutputQueue::Segment::Segment()
+	: data(),
+	  offset(0),
+	  cached(NULL),
+	  end(0),
+	  file(NULL),
+	  fileOffset(0),
+	  fileLeft(0),
+	  pipeFd(-1)
+{
+}
+
+const char *OutputQueue::Segment::bytes() const
+{
+	if (cached)
+		return cached->bytes.data() + offset;
+	return data.data() + offset;
+}
+
+std::size_t OutputQueue::Segment::left() const
+{
+	if (cached)
+		return end - offset;
+	return data.size() - offset;
+}
+
+OutputQueue::OutputQueue()
+	: _segments(),
+	  _pending(0),
+	  _pipes(0)
+{
+}
+
+OutputQueue::~OutputQueue()
+{
+	// Réponse abandonnée (client fermé) : on rend les références restantes
+	for (std::size_t i = 0; i < _segments.size(); ++i)
+	{
+		OpenFileCache::release(_segments[i].file);
+		ResponseCache::release(_segments[i].cached);
+	}
+}
+
+void OutputQueue::append(std::string &data)
+{
+	if (data.empty())
+		return;
+
+	// Segment vide en place puis swap : pas de copie du contenu
+	_segments.push_back(Segment());
+	_segments.back().data.swap(data);
+	_pending += _segments.back().data.size();
+}
+
+void OutputQueue::appendFile(OpenFileCache::Entry *file, off_t offset,
+                             std::size_t length)
+{
+	if (length == 0)
+	{
+		OpenFileCache::release(file);
+		return;
+	}
+
+	_segments.push_back(Segment());
+	Segment &seg = _segments.back();
+	seg.file = file;
+	seg.fileOffset = offset;
+	seg.fileLeft = length;
+	_pending += length;
+}
+
+void OutputQueue::appendCached(ResponseCache::Entry *entry,
+                               std::size_t begin, std::size_t end)
+{
+	if (begin >= end)
+	{
+		ResponseCache::release(entry);
+		return;
+	}
+
+	_segments.push_back(Segment());
+	Segment &seg = _segments.back();
+	seg.cached = entry;
+	seg.offset = begin;
+	seg.end = end;
+	_pending += end - begin;
+}
+
+void OutputQueue::appendPipe(int pipeFd, std::size_t length)
+{
+	if (length == 0)
+		return;
+
+	_segments.push_back(Segment());
+	Segment &seg = _segments.back();
+	seg.pipeFd = pipeFd;
+	seg.fileLeft = length;
+	_pending += length;
+	++_pipes;
+}
+
+bool OutputQueue::empty() const
+{
+	return _pending == 0;
+}
+
+std::size_t OutputQueue::pending() const
+{
+	return _pending;
+}
+
+int OutputQueue::fillIovec(struct iovec *iov, int max, bool &whole) const
+{
+	int count = 0;
+	std::size_t i = 0;
+
+	for (; i < _segments.size() && count < max; ++i)
+	{
+		const Segment &seg = _segments[i];
+		if (seg.file || seg.pipeFd >= 0)
+			break; // segment fichier / pipe : envoyé à part (sendfile, splice)
+
+		iov[count].iov_base = const_cast<char *>(seg.bytes());
+		iov[count].iov_len = seg.left();
+		++count;
+	}
+
+	whole = (i == _segments.size());
+	return count;
+}
+
+bool OutputQueue::frontFile(int &fd, off_t &offset, std::size_t &left) const
+{
+	if (_segments.empty() || !_segments.front().file)
+		return false;
+
+	const Segment &seg = _segments.front();
+	fd = seg.file->fd;
+	offset = seg.fileOffset;
+	left = seg.fileLeft;
+	return true;
+}
+
+bool OutputQueue::frontPipe(int &fd, std::size_t &left) const
+{
+	if (_segments.empty() || _segments.front().pipeFd < 0)
+		return false;
+
+	fd = _segments.front().pipeFd;
+	left = _segments.front().fileLeft;
+	return true;
+}
+
+bool OutputQueue::hasPipe() const
+{
+	return _pipes > 0;
+}
+
+void OutputQueue::consume(std::size_t n)
+{
+	while (n > 0 && !_segments.empty())
+	{
+		Segment &seg = _segments.front();
+
+		if (seg.file || seg.pipeFd >= 0)
+		{
+			if (n < seg.fileLeft)
+			{
+				seg.fileOffset += static_cast<off_t>(n);
+				seg.fileLeft -= n;
+				_pending -= n;
+				return;
+			}
+
+			n -= seg.fileLeft;
+			_pending -= seg.fileLeft;
+			if (seg.pipeFd >= 0)
+				--_pipes;
+			OpenFileCache::release(seg.file);
+			_segments.pop_front();
+			continue;
+		}
+
+		std::size_t left = seg.left();
+
+		if (n < left)
+		{
+			seg.offset += n;
+			_pending -= n;
+			return;
+		}
+
+		n -= left;
+		_pending -= left;
+		ResponseCache::release(seg.cached);
+		_segments.pop_front();
+	}
+}
@@ -0,0 +1,331 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Poller.cpp                                         :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Poller.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <stdexcept>
+#include <cerrno>
+#include <unistd.h>
+
+namespace
+{
+	// Bit haut de _interest[fd] : le fd est enregistré dans le Poller.
+	static const unsigned TRACKED = 0x80000000u;
+}
+
+Poller::Poller(Backend backend)
+	: _backend(backend),
+	  _count(0),
+	  _interest(),
+	  _pollFds(),
+	  _pollIndex(),
+	  _epollFd(-1)
+#ifdef WEBSERV_HAVE_EPOLL
+	  , _epollEvents()
+#endif
+{
+#ifdef WEBSERV_HAVE_EPOLL
+	if (_backend == BACKEND_EPOLL)
+	{
+		_epollFd = epoll_create1(EPOLL_CLOEXEC);
+		if (_epollFd < 0)
+		{
+			std::cerr << "Error: epoll_create1() failed: "
+			          << std::strerror(errno) << std::endl;
+			throw std::runtime_error("epoll_create1() failed");
+		}
+		_epollEvents.resize(256);
+	}
+#else
+	if (_backend == BACKEND_EPOLL)
+	{
+		std::cerr << "Warning: epoll not available, falling back to poll"
+		          << std::endl;
+		_backend = BACKEND_POLL;
+	}
+#endif
+}
+
+Poller::~Poller()
+{
+	if (_epollFd >= 0)
+		close(_epollFd);
+}
+
+Poller::Backend Poller::getBackend() const
+{
+	return _backend;
+}
+
+const char *Poller::getBackendName() const
+{
+	return (_backend == BACKEND_EPOLL) ? "epoll" : "poll";
+}
+
+bool Poller::parseBackend(const std::string &name, Backend &out)
+{
+	if (name == "epoll")
+	{
+		out = BACKEND_EPOLL;
+		return true;
+	}
+	if (name == "poll")
+	{
+		out = BACKEND_POLL;
+		return true;
+	}
+	return false;
+}
+
+Poller::Backend Poller::defaultBackend()
+{
+#ifdef WEBSERV_HAVE_EPOLL
+	return BACKEND_EPOLL;
+#else
+	return BACKEND_POLL;
+#endif
+}
+
+bool Poller::empty() const
+{
+	return _count == 0;
+}
+
+std::size_t Poller::size() const
+{
+	return _count;
+}
+
+/*
+ * add()
+ *
+ *  - enregistre un nouveau fd avec le masque d'intérêt donné.
+ */
+void Poller::add(int fd, unsigned events)
+{
+	if (fd < 0)
+		return;
+
+	if (static_cast<std::size_t>(fd) >= _interest.size())
+		_interest.resize(static_cast<std::size_t>(fd) + 1, 0);
+
+#ifdef WEBSERV_HAVE_EPOLL
+	if (_backend == BACKEND_EPOLL)
+	{
+		struct epoll_event ev;
+		std::memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLET;
+		if (events & EV_READ)
+			ev.events |= EPOLLIN;
+		if (events & EV_WRITE)
+			ev.events |= EPOLLOUT;
+		ev.data.fd = fd;
+
+		if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		{
+			std::cerr << "Error: epoll_ctl(ADD) failed on fd " << fd
+			          << ": " << std::strerror(errno) << std::endl;
+			return;
+		}
+		_interest[fd] = events | TRACKED;
+		++_count;
+		return;
+	}
+#endif
+
+	if (static_cast<std::size_t>(fd) >= _pollIndex.size())
+		_pollIndex.resize(static_cast<std::size_t>(fd) + 1, -1);
+
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = 0;
+	if (events & EV_READ)
+		pfd.events |= POLLIN;
+	if (events & EV_WRITE)
+		pfd.events |= POLLOUT;
+	pfd.revents = 0;
+
+	_pollIndex[fd] = static_cast<int>(_pollFds.size());
+	_pollFds.push_back(pfd);
+	_interest[fd] = events | TRACKED;
+	++_count;
+}
+
+/*
+ * modify()
+ *
+ *  - change le masque d'intérêt d'un fd déjà suivi.
+ *  - ne fait aucun appel système si le masque est inchangé.
+ */
+void Poller::modify(int fd, unsigned events)
+{
+	if (fd < 0 || static_cast<std::size_t>(fd) >= _interest.size())
+		return;
+	if (!(_interest[fd] & TRACKED))
+		return;
+	if ((_interest[fd] & ~TRACKED) == events)
+		return;
+
+#ifdef WEBSERV_HAVE_EPOLL
+	if (_backend == BACKEND_EPOLL)
+	{
+		struct epoll_event ev;
+		std::memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLET;
+		if (events & EV_READ)
+			ev.events |= EPOLLIN;
+		if (events & EV_WRITE)
+			ev.events |= EPOLLOUT;
+		ev.data.fd = fd;
+
+		if (epoll_ctl(_epollFd, EPOLL_CTL_MOD, fd, &ev) < 0)
+		{
+			std::cerr << "Error: epoll_ctl(MOD) failed on fd " << fd
+			          << ": " << std::strerror(errno) << std::endl;
+			return;
+		}
+		_interest[fd] = events | TRACKED;
+		return;
+	}
+#endif
+
+	int idx = _pollIndex[fd];
+	if (idx < 0)
+		return;
+
+	short pev = 0;
+	if (events & EV_READ)
+		pev |= POLLIN;
+	if (events & EV_WRITE)
+		pev |= POLLOUT;
+	_pollFds[idx].events = pev;
+	_interest[fd] = events | TRACKED;
+}
+
+/*
+ * remove()
+ *
+ *  - à appeler AVANT close(fd).
+ *  - en poll, on remplace l'entrée par la dernière (pas de "trou").
+ */
+void Poller::remove(int fd)
+{
+	if (fd < 0 || static_cast<std::size_t>(fd) >= _interest.size())
+		return;
+	if (!(_interest[fd] & TRACKED))
+		return;
+
+	_interest[fd] = 0;
+	--_count;
+
+#ifdef WEBSERV_HAVE_EPOLL
+	if (_backend == BACKEND_EPOLL)
+	{
+		// Le noyau retire de toute façon le fd à sa fermeture, mais on
+		// le fait explicitement au cas où il aurait été dupliqué.
+		struct epoll_event ev;
+		std::memset(&ev, 0, sizeof(ev));
+		epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, &ev);
+		return;
+	}
+#endif
+
+	int idx = _pollIndex[fd];
+	if (idx < 0)
+		return;
+
+	_pollIndex[fd] = -1;
+
+	std::size_t last = _pollFds.size() - 1;
+	if (static_cast<std::size_t>(idx) != last)
+	{
+		_pollFds[idx] = _pollFds[last];
+		_pollIndex[_pollFds[idx].fd] = idx;
+	}
+	_pollFds.pop_back();
+}
+
+/*
+ * wait()
+ *
+ *  - out est vidé puis rempli avec les fds prêts uniquement.
+ */
+int Poller::wait(std::vector<Event> &out, int timeoutMs)
+{
+	out.clear();
+
+#ifdef WEBSERV_HAVE_EPOLL
+	if (_backend == BACKEND_EPOLL)
+	{
+		int n = epoll_wait(_epollFd, &_epollEvents[0],
+		                   static_cast<int>(_epollEvents.size()), timeoutMs);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				return 0;
+			return -1;
+		}
+
+		for (int i = 0; i < n; ++i)
+		{
+			Event ev;
+			ev.fd = _epollEvents[i].data.fd;
+			ev.events = 0;
+			if (_epollEvents[i].events & EPOLLIN)
+				ev.events |= EV_READ;
+			if (_epollEvents[i].events & EPOLLOUT)
+				ev.events |= EV_WRITE;
+			if (_epollEvents[i].events & (EPOLLERR | EPOLLHUP))
+				ev.events |= EV_ERROR;
+			out.push_back(ev);
+		}
+
+		// Buffer plein : on l'agrandit pour le prochain tour
+		if (static_cast<std::size_t>(n) == _epollEvents.size())
+			_epollEvents.resize(_epollEvents.size() * 2);
+
+		return n;
+	}
+#endif
+
+	// Aucun fd : poll() dort quand même jusqu'au timeout (pas de busy-loop)
+	int ret = poll(_pollFds.empty() ? NULL : &_pollFds[0],
+	               _pollFds.size(), timeoutMs);
+	if (ret < 0)
+	{
+		if (errno == EINTR)
+			return 0;
+		return -1;
+	}
+
+	for (std::size_t i = 0; i < _pollFds.size() && out.size() < static_cast<std::size_t>(ret); ++i)
+	{
+		short rev = _pollFds[i].revents;
+		if (rev == 0)
+			continue;
+
+		Event ev;
+		ev.fd = _pollFds[i].fd;
+		ev.events = 0;
+		if (rev & POLLIN)
+			ev.events |= EV_READ;
+		if (rev & POLLOUT)
+			ev.events |= EV_WRITE;
+		if (rev & (POLLERR | POLLHUP | POLLNVAL))
+			ev.events |= EV_ERROR;
+		out.push_back(ev);
+	}
+
+	return static_cast<int>(out.size());
+}
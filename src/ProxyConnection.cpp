@@ -0,0 +1,872 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ProxyConnection.cpp                                :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ProxyConnection.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <algorithm>   // std::min
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>       // sockaddr_un
+#include <netinet/in.h>
+#include <netinet/tcp.h>  // TCP_NODELAY
+#include <arpa/inet.h>    // inet_pton
+
+namespace
+{
+	// Ligne de status / header / taille de chunk, et bloc de headers
+	static const std::size_t PROXY_MAX_LINE = 16 * 1024;
+	static const std::size_t PROXY_MAX_HEADERS = 64 * 1024;
+
+	static void closeFd(int &fd)
+	{
+		if (fd >= 0)
+			close(fd);
+		fd = -1;
+	}
+
+	// Non bloquant + close-on-exec dès la création : un CGI lancé par un
+	// autre thread entre socket() et fcntl() n'hérite pas du fd
+	static int openSocket(int family)
+	{
+#ifdef __linux__
+		return socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+#else
+		int fd = socket(family, SOCK_STREAM, 0);
+		if (fd < 0)
+			return -1;
+		int flags = fcntl(fd, F_GETFL, 0);
+		if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0 ||
+		    fcntl(fd, F_SETFD, FD_CLOEXEC) < 0)
+		{
+			close(fd);
+			return -1;
+		}
+		return fd;
+#endif
+	}
+
+	static std::string toLower(const std::string &s)
+	{
+		std::string out(s);
+		for (std::size_t i = 0; i < out.size(); ++i)
+		{
+			if (out[i] >= 'A' && out[i] <= 'Z')
+				out[i] = static_cast<char>(out[i] - 'A' + 'a');
+		}
+		return out;
+	}
+
+	static std::string trimSpaces(const std::string &s)
+	{
+		std::size_t b = s.find_first_not_of(" \t");
+		if (b == std::string::npos)
+			return std::string();
+		std::size_t e = s.find_last_not_of(" \t");
+		return s.substr(b, e - b + 1);
+	}
+
+	// Liste "a, b, c" (Connection, Transfer-Encoding) : token présent ?
+	static bool hasToken(const std::string &list, const std::string &token)
+	{
+		std::istringstream iss(list);
+		std::string item;
+		while (std::getline(iss, item, ','))
+		{
+			if (toLower(trimSpaces(item)) == token)
+				return true;
+		}
+		return false;
+	}
+
+	static std::string lastToken(const std::string &list)
+	{
+		std::size_t comma = list.rfind(',');
+		std::string item = comma == std::string::npos ? list : list.substr(comma + 1);
+		return toLower(trimSpaces(item));
+	}
+
+	// Headers d'une seule connexion (RFC 7230, 6.1), plus ceux que
+	// nomme le header Connection : ils ne traversent pas le proxy.
+	static bool isHopByHop(const std::string &lowerName,
+	                       const std::string &connection)
+	{
+		static const char *names[] = {
+			"connection", "keep-alive", "proxy-connection",
+			"proxy-authenticate", "proxy-authorization", "te",
+			"trailer", "transfer-encoding", "upgrade", 0
+		};
+		for (std::size_t i = 0; names[i]; ++i)
+		{
+			if (lowerName == names[i])
+				return true;
+		}
+		return !connection.empty() && hasToken(connection, lowerName);
+	}
+}
+
+/*
+ * Implémentation de ProxyRequest
+ */
+
+ProxyRequest::ProxyRequest()
+	: CgiOutput(),
+	  job(NULL),
+	  _conn(NULL),
+	  _failed(false),
+	  _error(),
+	  _method(),
+	  _target(),
+	  _headers(),
+	  _body()
+{
+}
+
+ProxyRequest::~ProxyRequest()
+{
+	if (_conn)
+		_conn->detach(*this);
+}
+
+ProxyConnection *ProxyRequest::connection() const
+{
+	return _conn;
+}
+
+// RFC 7231, 4.2.2 ; sans body, le backend n'a rien pu consommer
+bool ProxyRequest::replayable() const
+{
+	return _method == "GET" || _method == "HEAD" || _method == "OPTIONS" ||
+	       _method == "PUT" || _method == "DELETE" || _body.empty();
+}
+
+bool ProxyRequest::succeeded() const
+{
+	if (!_failed)
+		return true;
+
+	std::cerr << "Proxy request failed: " << _scriptPath
+	          << " (" << _error << ")" << std::endl;
+	return false;
+}
+
+/*
+ * Implémentation de ProxyConnection
+ */
+
+ProxyConnection::ProxyConnection(const std::string &address)
+	: timer(),
+	  dispatching(false),
+	  _fd(-1),
+	  _address(address),
+	  _connecting(false),
+	  _broken(false),
+	  _keepAlive(true),
+	  _paused(false),
+	  _wbuf(),
+	  _wOff(0),
+	  _line(),
+	  _req(NULL),
+	  _requests(0),
+	  _received(0),
+	  _state(ST_IDLE),
+	  _left(0),
+	  _status(0),
+	  _reason(),
+	  _fields(),
+	  _headerBytes(0),
+	  _http11(false),
+	  _chunked(false),
+	  _hasLength(false),
+	  _length(0),
+	  _connection()
+{
+}
+
+ProxyConnection::~ProxyConnection()
+{
+	// Requête encore attachée : elle ne recevra plus rien
+	if (_req)
+	{
+		_req->_failed = true;
+		_req->_error = "connection closed";
+		_req->_eof = true;
+		_req->_conn = NULL;
+	}
+	closeFd(_fd);
+}
+
+/*
+ * open()
+ *
+ *  - address : "unix:/chemin" ou "ip:port" (résolu par Config).
+ *  - le connect() se termine plus tard (EV_WRITE, voir flush()).
+ */
+bool ProxyConnection::open()
+{
+	struct sockaddr_un sun;
+	struct sockaddr_in sin;
+	struct sockaddr   *sa;
+	socklen_t          saLen;
+
+	if (_address.compare(0, 5, "unix:") == 0)
+	{
+		std::memset(&sun, 0, sizeof(sun));
+		sun.sun_family = AF_UNIX;
+		std::strncpy(sun.sun_path, _address.c_str() + 5, sizeof(sun.sun_path) - 1);
+		sa = reinterpret_cast<struct sockaddr *>(&sun);
+		saLen = sizeof(sun);
+	}
+	else
+	{
+		std::size_t colon = _address.rfind(':');
+		std::memset(&sin, 0, sizeof(sin));
+		sin.sin_family = AF_INET;
+		sin.sin_port = htons(static_cast<uint16_t>(
+		    std::atoi(_address.c_str() + colon + 1)));
+		if (inet_pton(AF_INET, _address.substr(0, colon).c_str(),
+		              &sin.sin_addr) != 1)
+			return false;
+		sa = reinterpret_cast<struct sockaddr *>(&sin);
+		saLen = sizeof(sin);
+	}
+
+	_fd = openSocket(sa->sa_family);
+	if (_fd < 0)
+	{
+		std::cerr << "Error: socket() for proxy failed: "
+		          << std::strerror(errno) << std::endl;
+		closeFd(_fd);
+		return false;
+	}
+
+	if (sa->sa_family == AF_INET)
+	{
+		int one = 1;
+		setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	}
+
+	if (connect(_fd, sa, saLen) < 0)
+	{
+		if (errno != EINPROGRESS)
+		{
+			std::cerr << "Error: connect() to proxy backend " << _address
+			          << " failed: " << std::strerror(errno) << std::endl;
+			closeFd(_fd);
+			return false;
+		}
+		_connecting = true;
+	}
+
+	timer.fd = _fd;
+	return true;
+}
+
+int ProxyConnection::fd() const
+{
+	return _fd;
+}
+
+const std::string &ProxyConnection::address() const
+{
+	return _address;
+}
+
+bool ProxyConnection::idle() const
+{
+	return _req == NULL;
+}
+
+bool ProxyConnection::broken() const
+{
+	return _broken;
+}
+
+bool ProxyConnection::reusable() const
+{
+	return !_broken && _keepAlive && !_req && !wantsWrite();
+}
+
+bool ProxyConnection::reused() const
+{
+	return _requests > 1;
+}
+
+bool ProxyConnection::connecting() const
+{
+	return _connecting;
+}
+
+bool ProxyConnection::untouched() const
+{
+	return _req && _received == 0;
+}
+
+ProxyRequest *ProxyConnection::current() const
+{
+	return _req;
+}
+
+/*
+ * submit()
+ *
+ *  - HTTP/1.1 vers le backend, même si le client parle HTTP/1.0 : la
+ *    connexion reste ouverte pour les requêtes suivantes.
+ *  - Host du client gardé (virtual hosts du backend) ; body envoyé avec
+ *    son Content-Length (déjà déchunké), Expect retiré : le body est là.
+ */
+void ProxyConnection::submit(ProxyRequest &req, const std::string &method,
+                             const std::string &target,
+                             const HeaderMap &headers,
+                             const std::string &body)
+{
+	req._method = method;
+	req._target = target;
+	req._headers = headers;
+	req._body = body;
+	send(req);
+}
+
+void ProxyConnection::resubmit(ProxyRequest &req)
+{
+	send(req);
+}
+
+ProxyRequest *ProxyConnection::withdraw()
+{
+	ProxyRequest *req = _req;
+	if (req)
+	{
+		req->_conn = NULL;
+		_req = NULL;
+		_state = ST_IDLE;
+	}
+	_broken = true;
+	return req;
+}
+
+void ProxyConnection::send(ProxyRequest &req)
+{
+	const std::string &method = req._method;
+	const std::string &target = req._target;
+	const HeaderMap &headers = req._headers;
+	const std::string &body = req._body;
+
+	req._conn = this;
+	req._scriptPath = _address + " " + method + " " + target;
+	_req = &req;
+	++_requests;
+	_received = 0;
+
+	_state = ST_STATUS;
+	_keepAlive = true;
+	_line.clear();
+	_fields.clear();
+	_headerBytes = 0;
+
+	std::string connection;
+	HeaderMap::const_iterator c = headers.find("connection");
+	if (c != headers.end())
+		connection = c->second;
+
+	std::string head = method + " " + target + " HTTP/1.1\r\n";
+	bool hasHost = false;
+	for (HeaderMap::const_iterator it = headers.begin(); it != headers.end(); ++it)
+	{
+		if (isHopByHop(it->first, connection) ||
+		    it->first == "content-length" || it->first == "expect")
+			continue;
+		if (it->first == "host")
+			hasHost = true;
+		head += it->first + ": " + it->second + "\r\n";
+	}
+	if (!hasHost)
+		head += "Host: " + (_address.compare(0, 5, "unix:") == 0
+		                    ? std::string("localhost") : _address) + "\r\n";
+	if (!body.empty() || method == "POST")
+	{
+		std::ostringstream len;
+		len << body.size();
+		head += "Content-Length: " + len.str() + "\r\n";
+	}
+	head += "Connection: keep-alive\r\n\r\n";
+
+	_wbuf += head;
+	_wbuf += body;
+}
+
+// Requête détruite avant la fin de sa réponse : le reste arriverait
+// sur la requête suivante, la connexion ne peut plus servir.
+void ProxyConnection::detach(ProxyRequest &req)
+{
+	req._conn = NULL;
+	_req = NULL;
+	_broken = true;
+}
+
+bool ProxyConnection::wantsWrite() const
+{
+	return _connecting || _wOff < _wbuf.size();
+}
+
+bool ProxyConnection::flush()
+{
+	if (_broken)
+		return false;
+
+	if (_connecting)
+	{
+		int err = 0;
+		socklen_t len = sizeof(err);
+		if (getsockopt(_fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+			err = errno;
+		if (err != 0)
+		{
+			std::cerr << "Error: connect() to proxy backend " << _address
+			          << " failed: " << std::strerror(err) << std::endl;
+			_broken = true;
+			return false;
+		}
+		_connecting = false;
+	}
+
+	while (_wOff < _wbuf.size())
+	{
+		ssize_t n = write(_fd, _wbuf.data() + _wOff, _wbuf.size() - _wOff);
+		if (n > 0)
+		{
+			_wOff += static_cast<std::size_t>(n);
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return true; // on attend EV_WRITE
+		if (n < 0 && errno == ENOTCONN)
+		{
+			_connecting = true; // connect() pas encore terminé
+			return true;
+		}
+
+		std::cerr << "Error: write() to proxy backend " << _address
+		          << " failed: " << std::strerror(errno) << std::endl;
+		_broken = true;
+		return false;
+	}
+
+	// Tout est parti : un gros body POST ne garde pas sa mémoire
+	if (_wbuf.capacity() > 64 * 1024)
+		std::string().swap(_wbuf);
+	else
+		_wbuf.clear();
+	_wOff = 0;
+	return true;
+}
+
+/*
+ * readResponse()
+ *
+ *  - lit par blocs jusqu'à EAGAIN, la limite, ou la fin de la réponse
+ *    (on ne lit pas au-delà : la connexion retourne au pool).
+ *  - EOF : fin normale d'un body sans longueur, sinon réponse tronquée.
+ *  - EOF ou erreur avant le moindre octet de réponse : la requête reste
+ *    attachée, sans échec ; la boucle peut la renvoyer (withdraw()) ou
+ *    la faire échouer (fail()).
+ */
+ProxyConnection::ReadResult
+ProxyConnection::readResponse(std::size_t limit, ProxyRequest *&touched)
+{
+	touched = NULL;
+	if (_connecting)
+		return READ_WAIT; // rien à lire avant la fin du connect()
+
+	ProxyRequest *req = _req;
+	char buf[16384];
+	std::size_t got = 0;
+	ReadResult result = READ_MORE;
+	bool eof = false;
+
+	while (got < limit)
+	{
+		ssize_t n = read(_fd, buf, sizeof(buf));
+		if (n > 0)
+		{
+			// Plus de nouvel essai possible : la copie du body est libérée
+			if (_req && _received == 0)
+				std::string().swap(_req->_body);
+			_received += static_cast<std::size_t>(n);
+			got += static_cast<std::size_t>(n);
+			if (!consume(buf, static_cast<std::size_t>(n)))
+			{
+				eof = true;
+				break;
+			}
+			if (req && !_req)
+			{
+				result = READ_WAIT; // réponse complète
+				break;
+			}
+			continue;
+		}
+		if (n == 0)
+		{
+			if (_req && _state == ST_CLOSE)
+				complete();
+			else if (_req && _received > 0)
+				error("connection closed before the end of the response");
+			eof = true;
+			break;
+		}
+		if (errno == EINTR)
+			continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+		{
+			result = READ_WAIT;
+			break;
+		}
+
+		if (!untouched())
+			error(std::string("read() failed: ") + std::strerror(errno));
+		eof = true;
+		break;
+	}
+
+	if (req && (got > 0 || (eof && _req != req)))
+		touched = req;
+
+	if (eof)
+	{
+		_broken = true;
+		return READ_EOF;
+	}
+	return result;
+}
+
+// Octets reçus : headers et tailles de chunk ligne par ligne, body
+// ajouté directement à la sortie de la requête.
+bool ProxyConnection::consume(const char *data, std::size_t len)
+{
+	while (len > 0)
+	{
+		if (_state == ST_IDLE)
+		{
+			error("unexpected data after the response");
+			return false;
+		}
+
+		if (_state == ST_CLOSE)
+		{
+			_req->_output.append(data, len);
+			return true;
+		}
+
+		if (_state == ST_LENGTH || _state == ST_CHUNK_DATA)
+		{
+			std::size_t n = std::min(len, _left);
+			_req->_output.append(data, n);
+			data += n;
+			len -= n;
+			_left -= n;
+			if (_left == 0)
+			{
+				if (_state == ST_LENGTH)
+					complete();
+				else
+					_state = ST_CHUNK_END;
+			}
+			continue;
+		}
+
+		std::string line;
+		if (!takeLine(data, len, line))
+		{
+			if (_line.size() > PROXY_MAX_LINE)
+			{
+				error("response line too long");
+				return false;
+			}
+			return true;
+		}
+		if (!handleLine(line))
+			return false;
+	}
+	return true;
+}
+
+// Ligne complète (sans CRLF) ; sinon le début est gardé dans _line.
+bool ProxyConnection::takeLine(const char *&data, std::size_t &len,
+                               std::string &line)
+{
+	const void *nl = std::memchr(data, '\n', len);
+	if (!nl)
+	{
+		_line.append(data, len);
+		len = 0;
+		return false;
+	}
+
+	std::size_t n = static_cast<const char *>(nl) - data;
+	line.swap(_line);
+	line.append(data, n);
+	_line.clear();
+	data += n + 1;
+	len -= n + 1;
+	if (!line.empty() && line[line.size() - 1] == '\r')
+		line.erase(line.size() - 1);
+	return true;
+}
+
+bool ProxyConnection::handleLine(const std::string &line)
+{
+	if (_state == ST_STATUS || _state == ST_HEADER)
+	{
+		_headerBytes += line.size() + 2;
+		if (_headerBytes > PROXY_MAX_HEADERS)
+		{
+			error("response headers too large");
+			return false;
+		}
+	}
+
+	switch (_state)
+	{
+		case ST_STATUS:
+		{
+			if (line.empty())
+				return true; // CRLF parasite avant la réponse
+
+			// "HTTP/1.1 200 OK"
+			std::istringstream iss(line);
+			std::string version;
+			int code = 0;
+			iss >> version >> code;
+			if (version.compare(0, 7, "HTTP/1.") != 0 || version.size() != 8 ||
+			    code < 100 || code > 599)
+			{
+				error("invalid status line");
+				return false;
+			}
+			std::string reason;
+			std::getline(iss, reason);
+			_status = code;
+			_reason = trimSpaces(reason);
+			_http11 = version[7] != '0';
+			_fields.clear();
+			_chunked = false;
+			_hasLength = false;
+			_length = 0;
+			_connection.clear();
+			_state = ST_HEADER;
+			return true;
+		}
+
+		case ST_HEADER:
+		{
+			if (line.empty())
+				return endHeaders();
+
+			if ((line[0] == ' ' || line[0] == '\t') && !_fields.empty())
+			{
+				// obs-fold : suite de la valeur précédente
+				_fields.back().second += " " + trimSpaces(line);
+				return true;
+			}
+
+			std::size_t colon = line.find(':');
+			if (colon == std::string::npos || colon == 0)
+			{
+				error("invalid header line");
+				return false;
+			}
+			std::string name = trimSpaces(line.substr(0, colon));
+			std::string value = trimSpaces(line.substr(colon + 1));
+			std::string lower = toLower(name);
+
+			if (lower == "content-length")
+			{
+				std::size_t len = 0;
+				std::istringstream num(value);
+				if (!(num >> len) || !num.eof() ||
+				    value.find_first_not_of("0123456789") != std::string::npos ||
+				    (_hasLength && len != _length))
+				{
+					error("invalid Content-Length");
+					return false;
+				}
+				_hasLength = true;
+				_length = len;
+			}
+			else if (lower == "transfer-encoding")
+				_chunked = lastToken(value) == "chunked";
+			else if (lower == "connection")
+				_connection += (_connection.empty() ? "" : ", ") + value;
+
+			_fields.push_back(std::make_pair(name, value));
+			return true;
+		}
+
+		case ST_CHUNK_SIZE:
+		{
+			// "1a2b;ext=..." : les extensions sont ignorées
+			std::string hex = trimSpaces(line.substr(0, line.find(';')));
+			if (hex.empty() || hex.size() > 15 ||
+			    hex.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+			{
+				error("invalid chunk size");
+				return false;
+			}
+			_left = static_cast<std::size_t>(std::strtoul(hex.c_str(), NULL, 16));
+			_state = _left == 0 ? ST_TRAILER : ST_CHUNK_DATA;
+			return true;
+		}
+
+		case ST_CHUNK_END:
+			if (!line.empty())
+			{
+				error("invalid chunk terminator");
+				return false;
+			}
+			_state = ST_CHUNK_SIZE;
+			return true;
+
+		case ST_TRAILER:
+			if (line.empty())
+				complete();
+			return true;
+
+		default:
+			return true;
+	}
+}
+
+/*
+ * endHeaders()
+ *
+ *  - 1xx (100 Continue, 103 Early Hints) : réponse intermédiaire,
+ *    ignorée ; la vraie suit.
+ *  - sinon le bloc CGI part dans la sortie : "Status:", puis les headers
+ *    de bout en bout (Content-Length gardé s'il décrit le body reçu :
+ *    pas en chunked, ni pour 204 / 304).
+ *  - framing du body : pas de body (204, 304), chunked, Content-Length,
+ *    ou jusqu'à la fermeture (connexion alors non réutilisable).
+ */
+bool ProxyConnection::endHeaders()
+{
+	if (_status < 200)
+	{
+		if (_status == 101)
+		{
+			error("unexpected protocol switch");
+			return false;
+		}
+		_state = ST_STATUS;
+		return true;
+	}
+
+	_keepAlive = _http11 ? !hasToken(_connection, "close")
+	                     : hasToken(_connection, "keep-alive");
+
+	std::ostringstream block;
+	block << "Status: " << _status << " "
+	      << (_reason.empty() ? "Unknown" : _reason) << "\r\n";
+	for (std::size_t i = 0; i < _fields.size(); ++i)
+	{
+		std::string lower = toLower(_fields[i].first);
+		if (isHopByHop(lower, _connection) || lower == "status" ||
+		    (lower == "content-length" &&
+		     (_chunked || _status == 204 || _status == 304)))
+			continue;
+		block << _fields[i].first << ": " << _fields[i].second << "\r\n";
+	}
+	block << "\r\n";
+	_req->_output += block.str();
+	_fields.clear();
+
+	if (_status == 204 || _status == 304)
+		complete();
+	else if (_chunked)
+		_state = ST_CHUNK_SIZE;
+	else if (_hasLength && _length == 0)
+		complete();
+	else if (_hasLength)
+	{
+		_left = _length;
+		_state = ST_LENGTH;
+	}
+	else
+	{
+		_keepAlive = false;
+		_state = ST_CLOSE;
+	}
+	return true;
+}
+
+// Réponse complète : la requête est détachée, la connexion au repos.
+void ProxyConnection::complete()
+{
+	ProxyRequest *req = _req;
+	req->_eof = true;
+	req->_conn = NULL;
+	_req = NULL;
+	_state = ST_IDLE;
+
+	// Réponse arrivée avant la fin du body (413...) : le backend lirait
+	// le reste comme une nouvelle requête
+	if (_wOff < _wbuf.size())
+		_keepAlive = false;
+}
+
+void ProxyConnection::error(const std::string &reason)
+{
+	_broken = true;
+	if (!_req)
+	{
+		std::cerr << "Error: proxy backend " << _address << ": "
+		          << reason << std::endl;
+		return;
+	}
+	_req->_failed = true;
+	_req->_error = reason;
+	_req->_eof = true;
+	_req->_conn = NULL;
+	_req = NULL;
+	_state = ST_IDLE;
+}
+
+ProxyRequest *ProxyConnection::fail()
+{
+	ProxyRequest *req = _req;
+	if (req)
+		error("connection lost");
+	_broken = true;
+	return req;
+}
+
+void ProxyConnection::pause()
+{
+	_paused = true;
+}
+
+void ProxyConnection::resume()
+{
+	_paused = false;
+}
+
+bool ProxyConnection::paused() const
+{
+	return _paused;
+}
@@ -0,0 +1,90 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ProxyPool.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ProxyPool.hpp"
+
+ProxyPool::ProxyPool()
+	: _conns()
+{
+}
+
+ProxyPool::~ProxyPool()
+{
+	for (ConnMap::iterator it = _conns.begin(); it != _conns.end(); ++it)
+	{
+		for (std::size_t i = 0; i < it->second.size(); ++i)
+			delete it->second[i];
+	}
+}
+
+ProxyConnection *ProxyPool::find(const std::string &address)
+{
+	ConnMap::iterator it = _conns.find(address);
+	if (it == _conns.end())
+		return NULL;
+
+	for (std::size_t i = it->second.size(); i > 0; --i)
+	{
+		ProxyConnection *conn = it->second[i - 1];
+		if (conn->reusable())
+			return conn;
+	}
+	return NULL;
+}
+
+ProxyConnection *ProxyPool::open(const std::string &address)
+{
+	ProxyConnection *conn = new ProxyConnection(address);
+	if (!conn->open())
+	{
+		delete conn;
+		return NULL;
+	}
+
+	_conns[address].push_back(conn);
+	return conn;
+}
+
+void ProxyPool::close(ProxyConnection *conn)
+{
+	ConnMap::iterator it = _conns.find(conn->address());
+	if (it != _conns.end())
+	{
+		std::vector<ProxyConnection *> &list = it->second;
+		for (std::size_t i = 0; i < list.size(); ++i)
+		{
+			if (list[i] == conn)
+			{
+				list.erase(list.begin() + i);
+				break;
+			}
+		}
+		if (list.empty())
+			_conns.erase(it);
+	}
+	delete conn;
+}
+
+std::size_t ProxyPool::idle(const std::string &address) const
+{
+	ConnMap::const_iterator it = _conns.find(address);
+	if (it == _conns.end())
+		return 0;
+
+	std::size_t count = 0;
+	for (std::size_t i = 0; i < it->second.size(); ++i)
+	{
+		if (it->second[i]->idle())
+			++count;
+	}
+	return count;
+}
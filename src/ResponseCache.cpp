@@ -0,0 +1,192 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ResponseCache.cpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ResponseCache.hpp"
+
+namespace
+{
+	// L'entrée correspond-elle encore au fichier sur disque ?
+	static bool sameFile(const ResponseCache::Entry &e,
+	                     const OpenFileCache::Entry &file)
+	{
+		return file.isFile &&
+		       file.ino == e.ino && file.dev == e.dev &&
+		       file.size == e.size && file.mtime == e.mtime;
+	}
+}
+
+ResponseCache::Entry::Entry()
+	: bytes(),
+	  headLen(0),
+	  key(),
+	  cache(NULL),
+	  dev(0),
+	  ino(0),
+	  size(0),
+	  mtime(0),
+	  refs(0),
+	  cached(false),
+	  lruPrev(NULL),
+	  lruNext(NULL)
+{
+}
+
+ResponseCache::ResponseCache(std::size_t maxBytes, std::size_t maxEntrySize)
+	: _mutex(),
+	  _entries(),
+	  _lruHead(NULL),
+	  _lruTail(NULL),
+	  _maxBytes(maxBytes),
+	  _maxEntrySize(maxEntrySize),
+	  _bytes(0)
+{
+}
+
+ResponseCache::~ResponseCache()
+{
+	while (_lruHead)
+		detach(_lruHead);
+}
+
+bool ResponseCache::enabled() const
+{
+	return _maxBytes > 0;
+}
+
+std::size_t ResponseCache::maxEntrySize() const
+{
+	return _maxEntrySize;
+}
+
+void ResponseCache::lruUnlink(Entry *e)
+{
+	if (e->lruPrev)
+		e->lruPrev->lruNext = e->lruNext;
+	else
+		_lruHead = e->lruNext;
+
+	if (e->lruNext)
+		e->lruNext->lruPrev = e->lruPrev;
+	else
+		_lruTail = e->lruPrev;
+
+	e->lruPrev = NULL;
+	e->lruNext = NULL;
+}
+
+void ResponseCache::lruPushFront(Entry *e)
+{
+	e->lruPrev = NULL;
+	e->lruNext = _lruHead;
+	if (_lruHead)
+		_lruHead->lruPrev = e;
+	_lruHead = e;
+	if (!_lruTail)
+		_lruTail = e;
+}
+
+/*
+ * detach()
+ *
+ *  - retire l'entrée de la table et du budget. Si une réponse en cours
+ *    d'envoi la tient encore, elle sera détruite par le dernier release().
+ */
+void ResponseCache::detach(Entry *e)
+{
+	if (!e->cached)
+		return;
+
+	_entries.erase(e->key);
+	lruUnlink(e);
+	_bytes -= e->bytes.size();
+	e->cached = false;
+
+	if (e->refs == 0)
+		delete e;
+}
+
+ResponseCache::Entry *ResponseCache::lookup(const std::string &key,
+                                            const OpenFileCache::Entry &file)
+{
+	ScopedLock lock(_mutex);
+
+	EntryMap::iterator it = _entries.find(key);
+	if (it == _entries.end())
+		return NULL;
+
+	Entry *e = it->second;
+	if (!sameFile(*e, file))
+	{
+		// Fichier modifié ou supprimé : la prochaine requête le recharge
+		detach(e);
+		return NULL;
+	}
+
+	lruUnlink(e);
+	lruPushFront(e);
+	__sync_add_and_fetch(&e->refs, 1);
+	return e;
+}
+
+ResponseCache::Entry *ResponseCache::insert(const std::string &key,
+                                            const OpenFileCache::Entry &file,
+                                            std::string &bytes,
+                                            std::size_t headLen)
+{
+	Entry *e = new Entry();
+	e->bytes.swap(bytes);
+	e->headLen = headLen;
+	e->key = key;
+	e->cache = this;
+	e->dev = file.dev;
+	e->ino = file.ino;
+	e->size = file.size;
+	e->mtime = file.mtime;
+	e->refs = 1;
+
+	ScopedLock lock(_mutex);
+
+	// Trop gros pour le budget : entrée jetable (détruite au release)
+	if (e->bytes.size() > _maxBytes)
+		return e;
+
+	// Une autre requête (ou un autre thread) a pu insérer la même clé
+	EntryMap::iterator it = _entries.find(key);
+	if (it != _entries.end())
+		detach(it->second);
+
+	while (_lruTail && _bytes + e->bytes.size() > _maxBytes)
+		detach(_lruTail);
+
+	_entries[key] = e;
+	lruPushFront(e);
+	_bytes += e->bytes.size();
+	e->cached = true;
+	return e;
+}
+
+void ResponseCache::retain(Entry *entry)
+{
+	__sync_add_and_fetch(&entry->refs, 1);
+}
+
+void ResponseCache::release(Entry *entry)
+{
+	if (!entry)
+		return;
+
+	ResponseCache *cache = entry->cache;
+	ScopedLock lock(cache->_mutex);
+
+	if (__sync_sub_and_fetch(&entry->refs, 1) == 0 && !entry->cached)
+		delete entry;
+}
@@ -0,0 +1,257 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   TimerWheel.cpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "TimerWheel.hpp"
+
+#include <ctime>   // clock_gettime, CLOCK_MONOTONIC
+
+namespace
+{
+	// Résolution de la roue
+	static const unsigned long TIMER_TICK_MS = 10;
+
+	static void unlinkNode(TimerNode &node)
+	{
+		node.prev->next = node.next;
+		node.next->prev = node.prev;
+		node.prev = &node;
+		node.next = &node;
+	}
+}
+
+TimerNode::TimerNode()
+	: prev(this),
+	  next(this),
+	  expires(0),
+	  fd(-1),
+	  armed(false)
+{
+}
+
+TimerWheel::TimerWheel()
+	: _current(monotonicMs() / TIMER_TICK_MS),
+	  _count(0)
+{
+	for (int l = 0; l < LEVELS; ++l)
+	{
+		for (int i = 0; i < SLOTS; ++i)
+		{
+			_slots[l][i].prev = &_slots[l][i];
+			_slots[l][i].next = &_slots[l][i];
+		}
+	}
+}
+
+TimerWheel::~TimerWheel()
+{
+	// Les nodes appartiennent à l'appelant : on les détache seulement
+	for (int l = 0; l < LEVELS; ++l)
+	{
+		for (int i = 0; i < SLOTS; ++i)
+		{
+			TimerNode *head = &_slots[l][i];
+			while (head->next != head)
+			{
+				TimerNode *node = head->next;
+				unlinkNode(*node);
+				node->armed = false;
+			}
+		}
+	}
+}
+
+unsigned long TimerWheel::monotonicMs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<unsigned long>(ts.tv_sec) * 1000UL
+	     + static_cast<unsigned long>(ts.tv_nsec) / 1000000UL;
+}
+
+bool TimerWheel::empty() const
+{
+	return _count == 0;
+}
+
+std::size_t TimerWheel::size() const
+{
+	return _count;
+}
+
+/*
+ * link()
+ *
+ *  - range node dans la case correspondant à son échéance.
+ *  - minTick : premier tick autorisé (_current + 1 pour un nouveau timer,
+ *    _current pendant une cascade : la case courante est traitée juste
+ *    après).
+ */
+void TimerWheel::link(TimerNode &node, unsigned long minTick)
+{
+	unsigned long tick = (node.expires + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+	if (tick < minTick)
+		tick = minTick;
+
+	unsigned long delta = tick - _current;
+	unsigned long maxDelta = 1UL << (SLOT_BITS * LEVELS);
+	if (delta >= maxDelta)
+	{
+		// Au-delà de la roue : on range au plus loin, il sera recascadé
+		delta = maxDelta - 1;
+		tick = _current + delta;
+	}
+
+	int level = 0;
+	while (level < LEVELS - 1 &&
+	       delta >= (1UL << (SLOT_BITS * (level + 1))))
+		++level;
+
+	TimerNode &head = _slots[level][(tick >> (SLOT_BITS * level)) & SLOT_MASK];
+	node.prev = head.prev;
+	node.next = &head;
+	head.prev->next = &node;
+	head.prev = &node;
+}
+
+void TimerWheel::schedule(TimerNode &node, unsigned long expiresMs)
+{
+	if (node.armed)
+		unlinkNode(node);
+	else
+		++_count;
+
+	node.expires = expiresMs;
+	node.armed = true;
+	link(node, _current + 1);
+}
+
+void TimerWheel::cancel(TimerNode &node)
+{
+	if (!node.armed)
+		return;
+
+	unlinkNode(node);
+	node.armed = false;
+	--_count;
+}
+
+/*
+ * cascade()
+ *
+ *  - vide une case d'un niveau supérieur et redistribue ses timers
+ *    dans les niveaux inférieurs.
+ */
+void TimerWheel::cascade(int level, unsigned long index)
+{
+	TimerNode &head = _slots[level][index & SLOT_MASK];
+	if (head.next == &head)
+		return;
+
+	// On détache la liste entière avant de la redistribuer
+	TimerNode *node = head.next;
+	head.prev->next = NULL;
+	head.prev = &head;
+	head.next = &head;
+
+	while (node)
+	{
+		TimerNode *next = node->next;
+		link(*node, _current);
+		node = next;
+	}
+}
+
+/*
+ * advance()
+ *
+ *  - traite les ticks écoulés depuis le dernier appel.
+ *  - roue vide : on saute directement au tick courant.
+ */
+void TimerWheel::advance(unsigned long nowMs, std::vector<TimerNode *> &expired)
+{
+	unsigned long target = nowMs / TIMER_TICK_MS;
+
+	while (_current < target)
+	{
+		if (_count == 0)
+		{
+			_current = target;
+			break;
+		}
+
+		++_current;
+
+		// Tour complet d'un niveau => cascade du niveau au-dessus
+		for (int l = 1; l < LEVELS; ++l)
+		{
+			if ((_current & ((1UL << (SLOT_BITS * l)) - 1)) != 0)
+				break;
+			cascade(l, _current >> (SLOT_BITS * l));
+		}
+
+		TimerNode &head = _slots[0][_current & SLOT_MASK];
+		while (head.next != &head)
+		{
+			TimerNode *node = head.next;
+			unlinkNode(*node);
+			node->armed = false;
+			--_count;
+			expired.push_back(node);
+		}
+	}
+}
+
+/*
+ * nextTimeout()
+ *
+ *  - niveau 0 : échéance exacte (au tick près).
+ *  - niveaux supérieurs : instant de la prochaine cascade d'une case
+ *    non vide (borne inférieure : au réveil, la cascade affine).
+ */
+int TimerWheel::nextTimeout(unsigned long nowMs) const
+{
+	if (_count == 0)
+		return -1;
+
+	unsigned long best = 1UL << (SLOT_BITS * LEVELS);
+
+	for (unsigned long j = 1; j < SLOTS; ++j)
+	{
+		if (_slots[0][(_current + j) & SLOT_MASK].next
+		    != &_slots[0][(_current + j) & SLOT_MASK])
+		{
+			best = j;
+			break;
+		}
+	}
+
+	for (int l = 1; l < LEVELS; ++l)
+	{
+		unsigned long pos = _current >> (SLOT_BITS * l);
+		for (unsigned long j = 1; j <= SLOTS; ++j)
+		{
+			const TimerNode &head = _slots[l][(pos + j) & SLOT_MASK];
+			if (head.next == &head)
+				continue;
+
+			unsigned long ticks = ((pos + j) << (SLOT_BITS * l)) - _current;
+			if (ticks < best)
+				best = ticks;
+			break;
+		}
+	}
+
+	unsigned long deadline = (_current + best) * TIMER_TICK_MS;
+	if (deadline <= nowMs)
+		return 0;
+	return static_cast<int>(deadline - nowMs);
+}
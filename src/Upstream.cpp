@@ -0,0 +1,248 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Upstream.cpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: you <you@student.42.fr>                    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 by you                       #+#    #+#             */
+/*   Updated: 2026/10/17 by you                       ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Upstream.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+
+namespace
+{
+	// Points de l'anneau par unité de poids
+	static const std::size_t HASH_POINTS = 160;
+
+	static const std::size_t NO_PEER = static_cast<std::size_t>(-1);
+
+	// FNV-1a puis mélange final (murmur3) : des clés voisines ("/a1",
+	// "/a2", "ip:port-1"...) se répartissent sur tout l'anneau.
+	static unsigned int hashBytes(const void *data, std::size_t len)
+	{
+		const unsigned char *p = static_cast<const unsigned char *>(data);
+		unsigned int h = 2166136261U;
+		for (std::size_t i = 0; i < len; ++i)
+		{
+			h ^= p[i];
+			h *= 16777619U;
+		}
+		h ^= h >> 16;
+		h *= 0x85ebca6bU;
+		h ^= h >> 13;
+		h *= 0xc2b2ae35U;
+		h ^= h >> 16;
+		return h;
+	}
+}
+
+Upstream::Upstream(const UpstreamConfig &config)
+	: _name(config.name),
+	  _balance(config.balance),
+	  _peers(),
+	  _ring(),
+	  _next(0),
+	  _mutex()
+{
+	for (std::size_t i = 0; i < config.servers.size(); ++i)
+	{
+		const UpstreamServerConfig &s = config.servers[i];
+		Peer p;
+		p.address = s.address;
+		p.weight = s.weight;
+		p.maxFails = s.maxFails;
+		p.failTimeout = s.failTimeout * 1000UL;
+		p.current = 0;
+		p.active = 0;
+		p.fails = 0;
+		p.failStart = 0;
+		p.downUntil = 0;
+		_peers.push_back(p);
+	}
+
+	if (_balance == UpstreamConfig::BALANCE_HASH_URI ||
+	    _balance == UpstreamConfig::BALANCE_HASH_IP)
+	{
+		for (std::size_t i = 0; i < _peers.size(); ++i)
+		{
+			std::size_t points = HASH_POINTS * _peers[i].weight;
+			for (std::size_t n = 0; n < points; ++n)
+			{
+				std::ostringstream key;
+				key << _peers[i].address << '-' << n;
+				std::string k = key.str();
+				_ring.push_back(std::make_pair(hashBytes(k.data(), k.size()), i));
+			}
+		}
+		std::sort(_ring.begin(), _ring.end());
+	}
+}
+
+Upstream::~Upstream()
+{
+}
+
+const std::string &Upstream::name() const
+{
+	return _name;
+}
+
+std::size_t Upstream::size() const
+{
+	return _peers.size();
+}
+
+// Les adresses ne changent jamais : lecture sans lock
+const std::string &Upstream::address(std::size_t peer) const
+{
+	return _peers[peer].address;
+}
+
+std::size_t Upstream::select(const std::string &uri, unsigned int clientIp,
+                             unsigned long now, std::vector<bool> &tried)
+{
+	ScopedLock lock(_mutex);
+
+	tried.resize(_peers.size(), false);
+	if (std::find(tried.begin(), tried.end(), false) == tried.end())
+		tried.assign(_peers.size(), false); // tous essayés : nouveau tour
+	bool all = true;
+	for (std::size_t i = 0; i < _peers.size() && all; ++i)
+		all = !available(i, tried, now, false);
+
+	std::size_t peer;
+	if (_balance == UpstreamConfig::BALANCE_HASH_URI)
+		peer = pickHash(hashBytes(uri.data(), uri.size()), tried, now, all);
+	else if (_balance == UpstreamConfig::BALANCE_HASH_IP)
+		peer = pickHash(hashBytes(&clientIp, sizeof(clientIp)), tried, now, all);
+	else if (_balance == UpstreamConfig::BALANCE_LEAST_CONN)
+		peer = pickLeastConn(tried, now, all);
+	else
+		peer = pickRoundRobin(tried, now, all);
+
+	tried[peer] = true;
+	++_peers[peer].active;
+	return peer;
+}
+
+void Upstream::release(std::size_t peer)
+{
+	ScopedLock lock(_mutex);
+	if (_peers[peer].active > 0)
+		--_peers[peer].active;
+}
+
+void Upstream::report(std::size_t peer, bool ok, unsigned long now)
+{
+	ScopedLock lock(_mutex);
+	Peer &p = _peers[peer];
+
+	if (ok)
+	{
+		p.fails = 0;
+		p.downUntil = 0;
+		return;
+	}
+	if (p.maxFails == 0)
+		return;
+
+	// Fenêtre de fail_timeout ouverte au premier échec
+	if (p.fails == 0 || now - p.failStart > p.failTimeout)
+	{
+		p.fails = 0;
+		p.failStart = now;
+	}
+	if (++p.fails < p.maxFails)
+		return;
+
+	p.fails = 0;
+	p.downUntil = now + p.failTimeout;
+	std::cerr << "Upstream " << _name << ": server " << p.address
+	          << " marked down for " << p.failTimeout / 1000UL << "s"
+	          << std::endl;
+}
+
+// all : tous les serveurs pas encore essayés sont écartés, on les prend
+// quand même
+bool Upstream::available(std::size_t peer, const std::vector<bool> &tried,
+                         unsigned long now, bool all) const
+{
+	if (tried[peer])
+		return false;
+	return all || _peers[peer].downUntil <= now;
+}
+
+/*
+    pickRoundRobin()
+
+    Round-robin pondéré "lisse" (comme nginx) : chaque serveur gagne son
+    poids à chaque tour, le plus haut est choisi et perd le total. Poids
+    5/1/1 : a a b a c a a, pas a a a a a b c.
+*/
+std::size_t Upstream::pickRoundRobin(const std::vector<bool> &tried,
+                                     unsigned long now, bool all)
+{
+	std::size_t best = NO_PEER;
+	long total = 0;
+
+	for (std::size_t i = 0; i < _peers.size(); ++i)
+	{
+		if (!available(i, tried, now, all))
+			continue;
+		Peer &p = _peers[i];
+		p.current += p.weight;
+		total += p.weight;
+		if (best == NO_PEER || p.current > _peers[best].current)
+			best = i;
+	}
+
+	_peers[best].current -= total;
+	return best;
+}
+
+std::size_t Upstream::pickLeastConn(const std::vector<bool> &tried,
+                                    unsigned long now, bool all)
+{
+	std::size_t best = NO_PEER;
+	std::size_t n = _peers.size();
+
+	for (std::size_t k = 0; k < n; ++k)
+	{
+		std::size_t i = (_next + k) % n;
+		if (!available(i, tried, now, all))
+			continue;
+		const Peer &p = _peers[i];
+		// active / weight < best.active / best.weight, sans division
+		if (best == NO_PEER ||
+		    p.active * _peers[best].weight < _peers[best].active * p.weight)
+			best = i;
+	}
+
+	_next = (best + 1) % n;
+	return best;
+}
+
+// Premier point de l'anneau après la clé dont le serveur est disponible
+// (et pas déjà essayé : un serveur mort renvoie au suivant sur l'anneau)
+std::size_t Upstream::pickHash(unsigned int key, const std::vector<bool> &tried,
+                               unsigned long now, bool all) const
+{
+	Ring::const_iterator it = std::lower_bound(
+	    _ring.begin(), _ring.end(), std::make_pair(key, static_cast<std::size_t>(0)));
+
+	for (std::size_t k = 0; k < _ring.size(); ++k, ++it)
+	{
+		if (it == _ring.end())
+			it = _ring.begin();
+		if (available(it->second, tried, now, all))
+			return it->second;
+	}
+	return _ring.begin()->second;
+}
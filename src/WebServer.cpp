@@ -11,6 +11,7 @@
 /* ************************************************************************** */
 
 #include "WebServer.hpp"
+#include "Compressor.hpp"
 
 #include <iostream>
 #include <cstring>
@@ -20,18 +21,21 @@
 #include <cstdio>      // std::remove
 #include <sys/stat.h>  // stat, S_ISDIR
 #include <dirent.h>    // opendir, readdir, closedir
-#include <unistd.h>    // pipe, fork, dup2, execve, close, read, write, chdir
+#include <unistd.h>    // pipe, close, read, write
 #include <sys/types.h> // pid_t, ssize_t
-#include <sys/wait.h>  // waitpid, WIFEXITED, WEXITSTATUS, WIFSIGNALED, WTERMSIG
 #include <sys/socket.h>
+#include <sys/uio.h>   // writev
+#ifdef __linux__
+# include <sys/sendfile.h>
+#endif
 #include <netinet/in.h>
-#include <fcntl.h>
+#include <fcntl.h>     // splice
+#include <sys/ioctl.h> // FIONREAD
 #include <cerrno>
 #include <map>
 #include <vector>
+#include <algorithm>   // std::min, std::find
 #include <ctime>       // std::time
-#include <poll.h>      // poll()
-#include <signal.h>    // kill, SIGKILL
 
 /*
  * Petit namespace anonyme pour les fonctions internes à ce fichier.
@@ -44,9 +48,87 @@ namespace
 	// Timeout client : 30 secondes d'inactivité
 	static const int CLIENT_TIMEOUT_SECONDS = 30;
 
+	// iovec max par writev() (sous IOV_MAX)
+	static const int WRITEV_MAX_IOV = 64;
+
+	// Budget des variantes compressées des fichiers statiques
+	static const std::size_t VARIANT_CACHE_SIZE = 4 * 1024 * 1024;
+
+	// accept() en échec (EMFILE, ENFILE, ENOBUFS...) : le listener est
+	// réessayé après ce délai
+	static const unsigned long ACCEPT_RETRY_MS = 100;
+
+	/*
+	 * sendFileChunk()
+	 *
+	 *  - envoie jusqu'à len octets de fileFd (à partir de offset) sur la
+	 *    socket. Linux : sendfile() depuis le page cache. Ailleurs :
+	 *    pread() + send() par petits blocs.
+	 */
+	static ssize_t sendFileChunk(int sockFd, int fileFd, off_t offset,
+	                             std::size_t len)
+	{
+#ifdef __linux__
+		return sendfile(sockFd, fileFd, &offset, len);
+#else
+		char buf[16384];
+		if (len > sizeof(buf))
+			len = sizeof(buf);
+		ssize_t n = pread(fileFd, buf, len, offset);
+		if (n <= 0)
+			return n;
+		return send(sockFd, buf, static_cast<std::size_t>(n), 0);
+#endif
+	}
+
+	/*
+	 * splicePipe()
+	 *
+	 *  - déplace jusqu'à len octets du pipe (stdout d'un CGI) vers la
+	 *    socket avec splice() : les pages du pipe passent à la socket
+	 *    sans copie en espace utilisateur. Les octets sont déjà dans le
+	 *    pipe (FIONREAD) : EAGAIN ne peut venir que de la socket.
+	 *  - hors Linux, aucun segment pipe n'est créé.
+	 */
+	static ssize_t splicePipe(int sockFd, int pipeFd, std::size_t len)
+	{
+#ifdef __linux__
+		return splice(pipeFd, NULL, sockFd, NULL, len,
+		              SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+#else
+		(void)sockFd;
+		(void)pipeFd;
+		(void)len;
+		errno = ENOSYS;
+		return -1;
+#endif
+	}
+
+	// Nombre de cases par page de la FdTable
+	static const std::size_t FDTABLE_PAGE_SIZE = 256;
+
 	// Timeout pour un CGI (en secondes)
 	static const int CGI_TIMEOUT_SECONDS = 30;
 
+	// Sans pidfd : intervalle entre deux waitpid(WNOHANG) après l'EOF
+	static const unsigned long CGI_REAP_RETRY_MS = 10;
+
+	// Sortie CGI streamée : le pipe est lu par blocs de CGI_BUFFER_SIZE
+	// (c'est aussi la taille max d'un bloc de headers). Au-delà de
+	// CGI_STREAM_HIGH_WATER octets en attente d'envoi au client, on
+	// arrête de lire (le script bloque sur son write) jusqu'à ce que la
+	// réponse redescende sous CGI_BUFFER_SIZE.
+	static const std::size_t CGI_BUFFER_SIZE = 64 * 1024;
+	static const std::size_t CGI_STREAM_HIGH_WATER = 256 * 1024;
+
+	// Connexions FastCGI au repos gardées ouvertes, par adresse et par boucle
+	static const std::size_t FASTCGI_MAX_IDLE = 8;
+
+	// proxy_pass : connexions keep-alive au repos gardées par backend et
+	// par boucle, fermées après PROXY_IDLE_TIMEOUT_SECONDS sans requête
+	static const std::size_t PROXY_MAX_IDLE = 32;
+	static const int PROXY_IDLE_TIMEOUT_SECONDS = 60;
+
 	// Trim de base (enlève espaces / tab / \r / \n en début et fin de chaîne)
 	static std::string trimString(const std::string &s)
 	{
@@ -271,39 +353,16 @@ namespace
 	}
 
 	/*
-	 * executeCgi()
+	 * prepareCgiBody()
 	 *
-	 * - lance le CGI via fork + execve
-	 * - envoie le body (POST) sur stdin du CGI
-	 * - lit stdout du CGI AVEC UN TIMEOUT (CGI_TIMEOUT_SECONDS)
-	 * - si le CGI se termine avec un code != 0, on considère que c'est une erreur
-	 *
-	 * - IMPORTANT :
-	 *   - on met CONTENT_LENGTH = taille réelle du body qu'on envoie
-	 *   - on essaie de déchunker request.getBody() si jamais il ressemble
-	 *     encore à du chunked (fallback robuste).
+	 *  - body envoyé sur stdin du CGI.
+	 *  - fallback : si, pour une raison X, le body est encore au format
+	 *    chunked, on essaie de le déchunker (sans casser les bodies normaux).
 	 */
-	static bool executeCgi(const HttpRequest &request,
-	                       const ServerConfig &serverCfg,
-	                       const LocationConfig *loc,
-	                       const std::string &scriptPath,
-	                       std::string &outBody,
-	                       std::map<std::string, std::string> &outHeaders,
-	                       int &outStatusCode,
-	                       std::string &outReason)
-	{
-		outBody.clear();
-		outHeaders.clear();
-		outStatusCode = 200;
-		outReason = "OK";
-
-		// -------------------------------
-		// 1) Préparer le body pour le CGI
-		// -------------------------------
+	static std::string prepareCgiBody(const HttpRequest &request)
+	{
 		std::string bodyForCgi = request.getBody();
 
-		// Fallback : si, pour une raison X, le body est encore au format chunked,
-		// on essaie de le déchunker ici (sans casser les bodies normaux).
 		if (!bodyForCgi.empty())
 		{
 			std::string buffer = bodyForCgi;
@@ -322,418 +381,979 @@ namespace
 			if (ok && finished && !tooLarge)
 			{
 				// Ça ressemble à du vrai chunked -> on garde la version déchunkée
-				bodyForCgi = decoded;
+				bodyForCgi.swap(decoded);
 			}
 		}
+		return bodyForCgi;
+	}
+
+	/*
+	 * buildCgiEnv()
+	 *
+	 *  - variables CGI/1.1 du script.
+	 *  - CONTENT_LENGTH = taille réelle du body envoyé au CGI (POST).
+	 */
+	static std::vector<std::string> buildCgiEnv(const HttpRequest &request,
+	                                            const ServerConfig &serverCfg,
+	                                            const std::string &scriptPath,
+	                                            std::size_t bodySize)
+	{
+		std::vector<std::string> env;
 
-		// -------------------------------
-		// 2) Création des pipes + fork
-		// -------------------------------
-		int inPipe[2];
-		int outPipe[2];
+		env.push_back("GATEWAY_INTERFACE=CGI/1.1");
+		env.push_back("SERVER_PROTOCOL=HTTP/1.1");
+		env.push_back("SERVER_SOFTWARE=webserv/0.1");
 
-		if (pipe(inPipe) < 0)
-			return false;
-		if (pipe(outPipe) < 0)
-		{
-			close(inPipe[0]);
-			close(inPipe[1]);
-			return false;
-		}
+		env.push_back("REQUEST_METHOD=" + request.getMethod());
+		env.push_back("QUERY_STRING=" + extractQueryString(request.getTarget()));
 
-		pid_t pid = fork();
-		if (pid < 0)
+		env.push_back("SCRIPT_FILENAME=" + scriptPath);
+		env.push_back("SCRIPT_NAME=" + scriptPath);
+
+		env.push_back("SERVER_NAME=" + serverCfg.host);
 		{
-			close(inPipe[0]);
-			close(inPipe[1]);
-			close(outPipe[0]);
-			close(outPipe[1]);
-			return false;
+			std::ostringstream oss;
+			oss << serverCfg.port;
+			env.push_back("SERVER_PORT=" + oss.str());
 		}
 
-		if (pid == 0)
-		{
-			// ===== Enfant : exécution du CGI =====
+		// Content-Type
+		std::string contentType = request.getHeader("Content-Type");
+		if (!contentType.empty())
+			env.push_back("CONTENT_TYPE=" + contentType);
 
-			// On redirige stdin/stdout vers nos pipes
-			if (dup2(inPipe[0], STDIN_FILENO) < 0)
-				_exit(1);
-			if (dup2(outPipe[1], STDOUT_FILENO) < 0)
-				_exit(1);
+		if (request.getMethod() == "POST")
+		{
+			std::ostringstream oss;
+			oss << bodySize;
+			env.push_back("CONTENT_LENGTH=" + oss.str());
+		}
 
-			close(inPipe[0]);
-			close(inPipe[1]);
-			close(outPipe[0]);
-			close(outPipe[1]);
+		// HTTP_HOST
+		std::string hostHeader = request.getHeader("Host");
+		if (!hostHeader.empty())
+			env.push_back("HTTP_HOST=" + hostHeader);
 
-			// --- IMPORTANT : se placer dans le dossier du script (chdir) ---
-			std::string scriptDir;
-			std::string scriptName;
-			std::size_t slashPos = scriptPath.rfind('/');
-			if (slashPos != std::string::npos)
-			{
-				scriptDir  = scriptPath.substr(0, slashPos);
-				scriptName = scriptPath.substr(slashPos + 1);
-				if (scriptDir.empty())
-					scriptDir = ".";
-			}
-			else
-			{
-				scriptDir  = ".";
-				scriptName = scriptPath;
-			}
+		return env;
+	}
 
-			if (chdir(scriptDir.c_str()) < 0)
-				_exit(1);
+	// Réponse de tête envoyable : prête, avec des octets en attente, ou
+	// terminée (slot vide à retirer de la file).
+	static bool canSend(const ResponseSlot &rs)
+	{
+		return rs.ready && (!rs.out.empty() || !rs.cgi);
+	}
 
-			// -----------------------
-			// Construction de l'env CGI
-			// -----------------------
-			std::vector<std::string> env;
+	// Morceau de body streamé : "<taille hexa>\r\n<data>\r\n" en chunked,
+	// brut sinon. data est vidé (swap dans la file).
+	static void appendBodyChunk(OutputQueue &out, std::string &data,
+	                            bool chunked)
+	{
+		if (data.empty())
+			return;
+		if (!chunked)
+		{
+			out.append(data);
+			return;
+		}
 
-			env.push_back("GATEWAY_INTERFACE=CGI/1.1");
-			env.push_back("SERVER_PROTOCOL=HTTP/1.1");
-			env.push_back("SERVER_SOFTWARE=webserv/0.1");
+		std::ostringstream size;
+		size << std::hex << data.size() << "\r\n";
+		std::string head = size.str();
+		std::string crlf = "\r\n";
+		out.append(head);
+		out.append(data);
+		out.append(crlf);
+	}
 
-			env.push_back("REQUEST_METHOD=" + request.getMethod());
-			env.push_back("QUERY_STRING=" + extractQueryString(request.getTarget()));
+	/*
+	 * makeETag()
+	 *
+	 *  - ETag fort dérivé de l'inode, de la taille et du mtime :
+	 *    "<mtime>-<taille>-<inode>" en hexa. Change dès que le fichier
+	 *    est modifié ou remplacé.
+	 *  - variant : suffixe pour une version compressée à la volée
+	 *    ("-gzip") ou un sidecar gzip_static ("-gzip_static") : autres
+	 *    octets que le fichier servi seul, donc autre ETag.
+	 */
+	static std::string makeETag(const OpenFileCache::Entry &file,
+	                            const std::string &variant = std::string())
+	{
+		std::ostringstream oss;
+		oss << std::hex << '"'
+		    << static_cast<unsigned long>(file.mtime) << '-'
+		    << static_cast<unsigned long>(file.size) << '-'
+		    << static_cast<unsigned long>(file.ino);
+		if (!variant.empty())
+			oss << '-' << variant;
+		oss << '"';
+		return oss.str();
+	}
 
-			env.push_back("SCRIPT_FILENAME=" + scriptPath);
-			env.push_back("SCRIPT_NAME=" + scriptPath);
+	// Lit tout le fichier (pread : le fd est partagé, pas d'offset commun)
+	static bool readFileContent(const OpenFileCache::Entry &file,
+	                            std::string &out)
+	{
+		std::size_t size = static_cast<std::size_t>(file.size);
+		std::size_t done = 0;
 
-			env.push_back("SERVER_NAME=" + serverCfg.host);
-			{
-				std::ostringstream oss;
-				oss << serverCfg.port;
-				env.push_back("SERVER_PORT=" + oss.str());
-			}
+		out.assign(size, '\0');
+		while (done < size)
+		{
+			ssize_t n = pread(file.fd, &out[done], size - done,
+			                  static_cast<off_t>(done));
+			if (n <= 0)
+				return false;
+			done += static_cast<std::size_t>(n);
+		}
+		return true;
+	}
 
-			// Content-Type
-			std::string contentType = request.getHeader("Content-Type");
-			if (!contentType.empty())
-				env.push_back("CONTENT_TYPE=" + contentType);
+	// Date HTTP (RFC 7231) : "Sun, 06 Nov 1994 08:49:37 GMT"
+	static std::string formatHttpDate(std::time_t t)
+	{
+		struct tm tmv;
+		char buf[64];
 
-			// CONTENT_LENGTH = taille réelle du body envoyé au CGI (POST uniquement)
-			if (request.getMethod() == "POST")
-			{
-				std::ostringstream oss;
-				oss << bodyForCgi.size();
-				env.push_back("CONTENT_LENGTH=" + oss.str());
-			}
+		gmtime_r(&t, &tmv);
+		std::size_t n = strftime(buf, sizeof(buf),
+		                         "%a, %d %b %Y %H:%M:%S GMT", &tmv);
+		return std::string(buf, n);
+	}
 
-			// HTTP_HOST
-			std::string hostHeader = request.getHeader("Host");
-			if (!hostHeader.empty())
-				env.push_back("HTTP_HOST=" + hostHeader);
-
-			// Conversion vector<string> -> char*[]
-			std::vector<char *> envp;
-			for (std::size_t i = 0; i < env.size(); ++i)
-				envp.push_back(const_cast<char *>(env[i].c_str()));
-			envp.push_back(0);
-
-			// argv : [interpreter, scriptName, NULL]
-			std::vector<char *> argv;
-			std::string interpreter;
-			if (loc)
-			{
-				interpreter = loc->cgiPath;
-				argv.push_back(const_cast<char *>(interpreter.c_str()));
-				argv.push_back(const_cast<char *>(scriptName.c_str()));
-			}
-			else
-			{
-				interpreter = "./" + scriptName;
-				argv.push_back(const_cast<char *>(interpreter.c_str()));
-			}
-			argv.push_back(0);
+	// Inverse de formatHttpDate (false si le format n'est pas reconnu)
+	static bool parseHttpDate(const std::string &value, std::time_t &out)
+	{
+		struct tm tmv;
+		std::memset(&tmv, 0, sizeof(tmv));
 
-			const char *execPath = interpreter.c_str();
-			execve(execPath, &argv[0], &envp[0]);
+		const char *end = strptime(value.c_str(),
+		                           "%a, %d %b %Y %H:%M:%S GMT", &tmv);
+		if (!end || *end != '\0')
+			return false;
 
-			// Si on arrive ici, execve a échoué
-			_exit(1);
-		}
+		out = timegm(&tmv);
+		return out != static_cast<std::time_t>(-1);
+	}
 
-		// ===== Parent : communique avec le CGI =====
-		close(inPipe[0]);
-		close(outPipe[1]);
+	/*
+	 * etagListMatches()
+	 *
+	 *  - If-None-Match : "*" ou liste d'ETags séparés par des virgules.
+	 *    Comparaison faible (RFC 7232) : le préfixe W/ est ignoré.
+	 */
+	static bool etagListMatches(const std::string &list, const std::string &etag)
+	{
+		std::size_t pos = 0;
 
-		// 3) Écriture du body dans stdin du CGI
-		if (!bodyForCgi.empty() && request.getMethod() == "POST")
+		while (pos <= list.size())
 		{
-			std::size_t total   = bodyForCgi.size();
-			std::size_t written = 0;
+			std::size_t comma = list.find(',', pos);
+			if (comma == std::string::npos)
+				comma = list.size();
+
+			std::string tag = trimString(list.substr(pos, comma - pos));
+			if (tag.compare(0, 2, "W/") == 0)
+				tag.erase(0, 2);
+			if (tag == "*" || tag == etag)
+				return true;
 
-			while (written < total)
-			{
-				ssize_t n = write(inPipe[1],
-				                  bodyForCgi.c_str() + written,
-				                  total - written);
-				if (n <= 0)
-					break;
-				written += static_cast<std::size_t>(n);
-			}
+			pos = comma + 1;
 		}
-		close(inPipe[1]);
-
-		// 4) Lecture de la sortie du CGI (stdout) avec timeout
-		std::string rawOutput;
-		char buf[1024];
+		return false;
+	}
 
-		std::time_t startTime = std::time(0);
+	/*
+	 * notModified()
+	 *
+	 *  - true si la requête conditionnelle peut recevoir un 304 :
+	 *    If-None-Match prioritaire, sinon If-Modified-Since (mtime pas
+	 *    plus récent que la date envoyée par le client).
+	 */
+	static bool notModified(const HttpRequest &request,
+	                        const std::string &etag, std::time_t mtime)
+	{
+		std::string inm = request.getHeader("If-None-Match");
+		if (!inm.empty())
+			return etagListMatches(inm, etag);
 
-		while (true)
-		{
-			std::time_t now = std::time(0);
-			int elapsed   = static_cast<int>(now - startTime);
-			int remaining = CGI_TIMEOUT_SECONDS - elapsed;
+		std::string ims = request.getHeader("If-Modified-Since");
+		std::time_t since;
+		if (!ims.empty() && parseHttpDate(trimString(ims), since))
+			return mtime <= since;
 
-			if (remaining <= 0)
-			{
-				// Timeout CGI
-				std::cerr << "CGI timeout (" << CGI_TIMEOUT_SECONDS
-				          << "s) for script: " << scriptPath << std::endl;
-				kill(pid, SIGKILL);
-				int statusKill;
-				waitpid(pid, &statusKill, 0);
-				close(outPipe[0]);
-				return false;
-			}
+		return false;
+	}
 
-			struct pollfd pfd;
-			pfd.fd = outPipe[0];
-			pfd.events = POLLIN | POLLHUP | POLLERR;
-			pfd.revents = 0;
+	/*
+	 * acceptsEncoding()
+	 *
+	 *  - Accept-Encoding: "gzip, deflate;q=0.5, br;q=0" : coding accepté
+	 *    s'il est listé (ou "*") sans q=0. Comparaison sans la casse.
+	 */
+	static bool acceptsEncoding(const std::string &header,
+	                            const std::string &coding)
+	{
+		std::string list;
+		for (std::size_t i = 0; i < header.size(); ++i)
+		{
+			char c = header[i];
+			if (c >= 'A' && c <= 'Z')
+				c = static_cast<char>(c - 'A' + 'a');
+			list.push_back(c);
+		}
 
-			int pret = poll(&pfd, 1, remaining * 1000);
-			if (pret < 0)
-			{
-				if (errno == EINTR)
-					continue;
+		bool star = false;
+		std::size_t pos = 0;
 
-				std::cerr << "Error: poll() on CGI pipe failed: "
-				          << std::strerror(errno) << std::endl;
-				int statusErr;
-				waitpid(pid, &statusErr, 0);
-				close(outPipe[0]);
-				return false;
-			}
+		while (pos < list.size())
+		{
+			std::size_t comma = list.find(',', pos);
+			if (comma == std::string::npos)
+				comma = list.size();
 
-			if (pret == 0)
-			{
-				// Sécurité supplémentaire
-				std::cerr << "CGI timeout (" << CGI_TIMEOUT_SECONDS
-				          << "s) for script: " << scriptPath << std::endl;
-				kill(pid, SIGKILL);
-				int statusKill;
-				waitpid(pid, &statusKill, 0);
-				close(outPipe[0]);
-				return false;
-			}
+			std::string item = list.substr(pos, comma - pos);
+			pos = comma + 1;
 
-			if (pfd.revents & POLLIN)
+			std::string name = item;
+			bool refused = false;
+			std::size_t semi = item.find(';');
+			if (semi != std::string::npos)
 			{
-				ssize_t n = read(outPipe[0], buf, sizeof(buf));
-				if (n < 0)
-				{
-					if (errno == EINTR)
-						continue;
-
-					std::cerr << "Error: read() from CGI pipe failed: "
-					          << std::strerror(errno) << std::endl;
-					int statusErr;
-					waitpid(pid, &statusErr, 0);
-					close(outPipe[0]);
-					return false;
-				}
-				if (n == 0)
+				name = item.substr(0, semi);
+				std::string param = trimString(item.substr(semi + 1));
+				if (param.compare(0, 2, "q=") == 0)
 				{
-					// EOF
-					break;
+					std::string q = trimString(param.substr(2));
+					refused = q.find_first_not_of("0.") == std::string::npos;
 				}
-
-				rawOutput.append(buf, static_cast<std::size_t>(n));
-				continue;
 			}
+			name = trimString(name);
 
-			if (pfd.revents & (POLLHUP | POLLERR | POLLNVAL))
-			{
-				// On essaie de vider ce qui reste éventuellement
-				while (true)
-				{
-					ssize_t n = read(outPipe[0], buf, sizeof(buf));
-					if (n <= 0)
-						break;
-					rawOutput.append(buf, static_cast<std::size_t>(n));
-				}
-				break;
-			}
+			if (name == coding)
+				return !refused;
+			if (name == "*")
+				star = !refused;
 		}
+		return star;
+	}
 
-		close(outPipe[0]);
-
-		int status = 0;
-		if (waitpid(pid, &status, 0) < 0)
-		{
-			std::cerr << "Error: waitpid() on CGI failed: "
-			          << std::strerror(errno) << std::endl;
+	/*
+	 * pickCompression()
+	 *
+	 *  - compress on dans la location, type MIME dans compress_types
+	 *    ("*" = tous) et client qui accepte gzip (préféré) ou deflate.
+	 */
+	static bool pickCompression(const std::string &accept,
+	                            const LocationConfig *loc,
+	                            const std::string &contentType,
+	                            Compressor::Format &format)
+	{
+		if (!loc || !loc->compress)
 			return false;
-		}
 
-		// Si le CGI s'est terminé anormalement (signal, ou exit code != 0)
-		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		std::string type = contentType.substr(0, contentType.find(';'));
+		type = trimString(type);
+		for (std::size_t i = 0; i < type.size(); ++i)
 		{
-			std::cerr << "CGI script exited abnormally: " << scriptPath;
-			if (WIFEXITED(status))
-			{
-				std::cerr << " (exit code " << WEXITSTATUS(status) << ")";
-			}
-			else if (WIFSIGNALED(status))
-			{
-				std::cerr << " (signal " << WTERMSIG(status) << ")";
-			}
-			std::cerr << std::endl;
-			return false;
+			if (type[i] >= 'A' && type[i] <= 'Z')
+				type[i] = static_cast<char>(type[i] - 'A' + 'a');
 		}
+		if (!loc->compressTypes.count(type) && !loc->compressTypes.count("*"))
+			return false;
 
-		if (rawOutput.empty())
+		if (acceptsEncoding(accept, "gzip"))
+			format = Compressor::GZIP;
+		else if (acceptsEncoding(accept, "deflate"))
+			format = Compressor::DEFLATE;
+		else
 			return false;
+		return true;
+	}
 
-		// 5) Séparation headers / body
-		std::size_t pos = rawOutput.find("\r\n\r\n");
-		std::size_t sepLen = 4;
-		if (pos == std::string::npos)
-		{
-			pos = rawOutput.find("\n\n");
-			sepLen = 2;
-		}
+	// Nombre max de plages dans un header Range (au-delà : 200 complet)
+	static const std::size_t MAX_RANGES = 32;
 
-		if (pos == std::string::npos)
+	struct ByteRange
+	{
+		off_t first;
+		off_t last;   // inclus
+	};
+
+	// Suite de chiffres -> off_t (false si vide ou trop grand)
+	static bool parseOffset(const std::string &digits, off_t &out)
+	{
+		if (digits.empty())
+			return false;
+
+		unsigned long long n = 0;
+		for (std::size_t i = 0; i < digits.size(); ++i)
 		{
-			// Pas de headers : tout est body
-			outBody = rawOutput;
-			return true;
+			if (n > (0x7fffffffffffffffULL - 9) / 10)
+				return false;
+			n = n * 10 + static_cast<unsigned long long>(digits[i] - '0');
 		}
+		out = static_cast<off_t>(n);
+		return true;
+	}
 
-		std::string headerPart = rawOutput.substr(0, pos);
-		outBody = rawOutput.substr(pos + sepLen);
+	/*
+	 * parseRangeHeader()
+	 *
+	 *  - "bytes=0-99,200-,-500" pour un fichier de size octets.
+	 *  - retourne 1 si au moins une plage est satisfiable (ranges rempli,
+	 *    bornes ramenées dans le fichier), 0 si aucune ne l'est (416),
+	 *    -1 si le header est invalide ou trop long (on l'ignore : 200).
+	 */
+	static int parseRangeHeader(const std::string &value, off_t size,
+	                            std::vector<ByteRange> &ranges)
+	{
+		std::string spec = trimString(value);
+		if (spec.compare(0, 6, "bytes=") != 0)
+			return -1;
 
-		std::istringstream iss(headerPart);
-		std::string line;
+		std::size_t pos = 6;
+		std::size_t count = 0;
 
-		while (std::getline(iss, line))
+		while (pos <= spec.size())
 		{
-			if (!line.empty() && line[line.size() - 1] == '\r')
-				line.erase(line.size() - 1);
-
-			line = trimString(line);
-			if (line.empty())
-				continue;
+			std::size_t comma = spec.find(',', pos);
+			if (comma == std::string::npos)
+				comma = spec.size();
 
-			std::size_t colon = line.find(':');
-			if (colon == std::string::npos)
+			std::string item = trimString(spec.substr(pos, comma - pos));
+			pos = comma + 1;
+			if (item.empty())
 				continue;
+			if (++count > MAX_RANGES)
+				return -1;
 
-			std::string name  = trimString(line.substr(0, colon));
-			std::string value = trimString(line.substr(colon + 1));
+			std::size_t dash = item.find('-');
+			if (dash == std::string::npos)
+				return -1;
 
-			if (name.empty())
-				continue;
+			std::string a = item.substr(0, dash);
+			std::string b = item.substr(dash + 1);
+			if (a.find_first_not_of("0123456789") != std::string::npos ||
+			    b.find_first_not_of("0123456789") != std::string::npos)
+				return -1;
 
-			if (name == "Status")
+			ByteRange range;
+			if (a.empty())
 			{
-				// "Status: 404 Not Found"
-				std::istringstream st(value);
-				int code = 0;
-				std::string reason;
-				if (st >> code)
-				{
-					std::getline(st, reason);
-					reason = trimString(reason);
-					if (code >= 100 && code <= 599)
-					{
-						outStatusCode = code;
-						if (!reason.empty())
-							outReason = reason;
-					}
-				}
+				// Suffixe : les n derniers octets
+				off_t n;
+				if (!parseOffset(b, n))
+					return -1;
+				if (n == 0 || size == 0)
+					continue;
+				range.first = (n >= size) ? 0 : size - n;
+				range.last = size - 1;
 			}
 			else
 			{
-				outHeaders[name] = value;
+				if (!parseOffset(a, range.first))
+					return -1;
+				if (b.empty())
+					range.last = size - 1;
+				else if (!parseOffset(b, range.last) || range.last < range.first)
+					return -1;
+				if (range.first >= size)
+					continue;
+				if (range.last >= size)
+					range.last = size - 1;
 			}
+			ranges.push_back(range);
 		}
 
-		return true;
+		return ranges.empty() ? 0 : 1;
+	}
+
+	/*
+	 * ifRangeMatches()
+	 *
+	 *  - If-Range : ETag (comparaison forte, un W/ ne correspond jamais)
+	 *    ou date qui doit être exactement le Last-Modified.
+	 */
+	static bool ifRangeMatches(const std::string &value,
+	                           const std::string &etag, std::time_t mtime)
+	{
+		std::string v = trimString(value);
+
+		if (!v.empty() && (v[0] == '"' || v.compare(0, 2, "W/") == 0))
+			return v == etag;
+
+		std::time_t date;
+		return parseHttpDate(v, date) && date == mtime;
 	}
 } // namespace
 
 
 /*
- * Implémentation de ClientState
+ * Implémentation de ResponseSlot / ClientState
  */
 
+ResponseSlot::ResponseSlot()
+	: ready(false),
+	  closeAfter(false),
+	  keepAlive(),
+	  cgi(NULL),
+	  out()
+{
+}
+
+CgiJob::CgiJob()
+	: process(),
+	  fastcgi(),
+	  proxy(),
+	  remote(false),
+	  proxied(false),
+	  pool(NULL),
+	  limiter(NULL),
+	  upstream(NULL),
+	  peer(0),
+	  tried(),
+	  uri(),
+	  clientIp(0),
+	  waiting(false),
+	  scriptPath(),
+	  env(),
+	  input(),
+	  clientFd(-1),
+	  slot(NULL),
+	  server(NULL),
+	  loc(NULL),
+	  acceptEncoding(),
+	  chunkedOk(true),
+	  deadline(0),
+	  timer(),
+	  streaming(false),
+	  splice(false),
+	  paused(false),
+	  chunked(false),
+	  discardBody(false),
+	  lengthKnown(false),
+	  bodyLeft(0),
+	  compressor(NULL)
+{
+}
+
+CgiJob::~CgiJob()
+{
+	delete compressor;
+}
+
+CgiOutput &CgiJob::output()
+{
+	if (proxied)
+		return proxy;
+	if (remote)
+		return fastcgi;
+	return process;
+}
+
 ClientState::ClientState()
 	: server(NULL),
-	  request(),
+	  defaultServer(NULL),
+	  lastServer(NULL),
+	  lastActivity(0),
+	  idleTimeout(CLIENT_TIMEOUT_SECONDS),
+	  clientIp(0),
 	  headersComplete(false),
-	  requestHandled(false),
-	  contentLength(0),
-	  readBuffer(),
-	  writeBuffer(),
 	  isChunked(false),
+	  closing(false),
+	  inputPaused(false),
+	  peerClosed(false),
+	  requestsServed(0),
+	  contentLength(0),
 	  currentChunkSize(NO_CHUNK_SIZE),
+	  readBuffer(),
+	  responses(),
 	  chunkDecodedBody(),
-	  lastActivity(0)
+	  request()
+{
+}
+
+void ClientState::clear()
 {
+	server = NULL;
+	defaultServer = NULL;
+	lastServer = NULL;
+	lastActivity = 0;
+	idleTimeout = CLIENT_TIMEOUT_SECONDS;
+	clientIp = 0;
+	headersComplete = false;
+	isChunked = false;
+	closing = false;
+	inputPaused = false;
+	peerClosed = false;
+	requestsServed = 0;
+	contentLength = 0;
+	currentChunkSize = NO_CHUNK_SIZE;
+
+	// swap avec une string vide : libère vraiment la mémoire
+	std::string().swap(readBuffer);
+	std::string().swap(chunkDecodedBody);
+	responses.clear(); // slots détruits, la deque resservira sur ce fd
+
+	request = HttpRequest();
+}
+
+void ClientState::resetForNextRequest()
+{
+	// Le vhost sera re-sélectionné via Host: pour la requête suivante
+	server = defaultServer;
+	headersComplete = false;
+	isChunked = false;
+	contentLength = 0;
+	currentChunkSize = NO_CHUNK_SIZE;
+
+	// clear() garde la capacité : évite de réallouer à chaque requête
+	chunkDecodedBody.clear();
+
+	request = HttpRequest();
+	++requestsServed;
 }
 
 /*
- * Classe WebServer
+ * Implémentation de FdSlot / FdTable
  */
 
-WebServer::WebServer(const std::vector<ServerConfig> &servers)
-	: _servers(servers),
-	  _pollFds(),
-	  _clients(),
-	  _listenFdToServer()
+FdSlot::FdSlot()
+	: kind(FD_FREE),
+	  state(),
+	  cgi(NULL),
+	  fastcgi(NULL),
+	  cgiPool(NULL),
+	  proxy(NULL)
 {
-	initListeningSockets();
 }
 
-WebServer::~WebServer()
+FdTable::FdTable()
+	: _pages()
 {
-	for (std::size_t i = 0; i < _pollFds.size(); ++i)
-	{
-		if (_pollFds[i].fd >= 0)
-			close(_pollFds[i].fd);
-	}
+}
+
+FdTable::~FdTable()
+{
+	for (std::size_t i = 0; i < _pages.size(); ++i)
+		delete [] _pages[i];
+}
+
+FdSlot *FdTable::get(int fd)
+{
+	if (fd < 0)
+		return NULL;
+
+	std::size_t page = static_cast<std::size_t>(fd) / FDTABLE_PAGE_SIZE;
+	if (page >= _pages.size() || !_pages[page])
+		return NULL;
+
+	return &_pages[page][static_cast<std::size_t>(fd) % FDTABLE_PAGE_SIZE];
+}
+
+FdSlot &FdTable::acquire(int fd, unsigned char kind)
+{
+	std::size_t page = static_cast<std::size_t>(fd) / FDTABLE_PAGE_SIZE;
+	if (page >= _pages.size())
+		_pages.resize(page + 1, NULL);
+	if (!_pages[page])
+		_pages[page] = new FdSlot[FDTABLE_PAGE_SIZE];
+
+	FdSlot &slot = _pages[page][static_cast<std::size_t>(fd) % FDTABLE_PAGE_SIZE];
+	slot.kind = kind;
+	return slot;
+}
+
+void FdTable::release(int fd)
+{
+	FdSlot *slot = get(fd);
+	if (!slot)
+		return;
+
+	slot->kind = FdSlot::FD_FREE;
+	slot->state.clear();
+	slot->cgi = NULL;
+	slot->fastcgi = NULL;
+	slot->cgiPool = NULL;
+	slot->proxy = NULL;
+}
+
+int FdTable::limit() const
+{
+	return static_cast<int>(_pages.size() * FDTABLE_PAGE_SIZE);
 }
 
 /*
- * initListeningSockets()
- *
- *  - IMPORTANT pour multi-hostnames:
- *    On crée UN socket d'écoute par port, même s'il y a plusieurs server{}
- *    qui écoutent sur ce port.
- *    Le premier server{} devient le "default server" pour ce port.
+ * Classe WebServer
  */
-void WebServer::initListeningSockets()
+
+/*
+ * Choix du backend d'événements : event_backend (config) ou défaut.
+ */
+static Poller::Backend selectBackend(const GlobalConfig &global)
 {
-	std::map<int, bool> portUsed; // port -> déjà un socket créé ?
+	Poller::Backend backend = Poller::defaultBackend();
+	if (!global.eventBackend.empty())
+		Poller::parseBackend(global.eventBackend, backend);
+	return backend;
+}
 
-	for (std::size_t i = 0; i < _servers.size(); ++i)
+WebServer::WebServer(const std::vector<ServerConfig> &servers,
+                     const GlobalConfig &global,
+                     Role role)
+	: _servers(servers),
+	  _role(role),
+	  _reusePort(global.workerProcesses > 1),
+	  _poller(selectBackend(global)),
+	  _events(),
+	  _ownFileCache(global.openFileCacheMax,
+	                global.openFileCacheInactive * 1000UL,
+	                global.openFileCacheValid * 1000UL,
+	                global.openFileCacheMinUses),
+	  _fileCache(&_ownFileCache),
+	  _ownResponseCache(global.responseCacheSize,
+	                    global.responseCacheMaxEntry),
+	  _responseCache(&_ownResponseCache),
+	  _ownVariantCache(VARIANT_CACHE_SIZE, global.responseCacheMaxEntry),
+	  _variantCache(&_ownVariantCache),
+	  _timers(),
+	  _now(TimerWheel::monotonicMs()),
+	  _expired(),
+	  _expiredFds(),
+	  _fds(),
+	  _listenFds(),
+	  _acceptQueue(),
+	  _acceptBudget(global.acceptBudget),
+	  _sendfileChunk(global.sendfileMaxChunk),
+	  _fastcgi(),
+	  _cgiPools(),
+	  _ownCgiLimiters(),
+	  _cgiLimiters(&_ownCgiLimiters),
+	  _ownCgiCounters(),
+	  _cgiCounters(&_ownCgiCounters),
+	  _cgiQueueTimer(),
+	  _cgiAdmitted(0),
+	  _ownUpstreams(),
+	  _upstreams(&_ownUpstreams),
+	  _reactors(),
+	  _nextReactor(0),
+	  _thread(),
+	  _threadStarted(false),
+	  _handoffMutex(),
+	  _handoffs(),
+	  _activeClients(0),
+	  _stop(0)
+{
+	_wakeupPipe[0] = -1;
+	_wakeupPipe[1] = -1;
+	_cgiQueueTimer.fd = -1;
+
+	if (_role == ROLE_REACTOR)
 	{
-		const ServerConfig &cfg = _servers[i];
+		initWakeupPipe();
+		return;
+	}
 
-		if (portUsed[cfg.port])
+	std::cout << "Event backend: " << _poller.getBackendName() << "\n";
+	initListeningSockets();
+
+	// Compteurs et admission CGI créés avant les reactors : les maps ne
+	// changent plus
+	for (std::size_t i = 0; i < _servers.size(); ++i)
+	{
+		for (std::size_t j = 0; j < _servers[i].locations.size(); ++j)
 		{
-			// Il y a déjà un socket sur ce port, on ne recrée pas un deuxième.
-			continue;
+			const LocationConfig &loc = _servers[i].locations[j];
+			if (!loc.cgiEnabled)
+				continue;
+			CgiCounters *counters = new CgiCounters();
+			_ownCgiCounters[&loc] = counters;
+			_ownCgiLimiters[&loc] = new CgiLimiter(loc.cgiMaxConcurrency,
+			                                       loc.cgiQueueSize,
+			                                       loc.cgiQueueTimeout * 1000UL,
+			                                       counters);
 		}
+	}
+	for (std::size_t i = 0; i < global.upstreams.size(); ++i)
+		_ownUpstreams[global.upstreams[i].name] = new Upstream(global.upstreams[i]);
+
+	if (global.workerThreads > 1)
+		startReactors(global);
+}
+
+WebServer::~WebServer()
+{
+	stopReactors();
+	__sync_lock_test_and_set(&_stop, 1); // plus de worker cgi_pool relancé
+
+	// CGI encore en cours : tués et réapés (leurs fds sont libérés ici)
+	for (int fd = 0; fd < _fds.limit(); ++fd)
+	{
+		FdSlot *slot = _fds.get(fd);
+		if (slot && slot->kind == FdSlot::FD_CLIENT)
+			abortClientCgi(slot->state);
+	}
+
+	// Workers cgi_pool tués et réapés ; les connexions FastCGI sont
+	// fermées par le FastCgiPool
+	for (std::map<const LocationConfig *, CgiPool *>::iterator it = _cgiPools.begin();
+	     it != _cgiPools.end(); ++it)
+		delete it->second;
+
+	_timers.cancel(_cgiQueueTimer);
+	for (std::map<const LocationConfig *, CgiLimiter *>::iterator it = _ownCgiLimiters.begin();
+	     it != _ownCgiLimiters.end(); ++it)
+		delete it->second;
+	for (std::map<const LocationConfig *, CgiCounters *>::iterator it = _ownCgiCounters.begin();
+	     it != _ownCgiCounters.end(); ++it)
+		delete it->second;
+	for (std::map<std::string, Upstream *>::iterator it = _ownUpstreams.begin();
+	     it != _ownUpstreams.end(); ++it)
+		delete it->second;
+
+	for (int fd = 0; fd < _fds.limit(); ++fd)
+	{
+		FdSlot *slot = _fds.get(fd);
+		if (slot && slot->kind != FdSlot::FD_FREE &&
+		    slot->kind != FdSlot::FD_FASTCGI && slot->kind != FdSlot::FD_PROXY)
+			close(fd);
+	}
+
+	// Connexions confiées mais jamais prises en charge
+	for (std::size_t i = 0; i < _handoffs.size(); ++i)
+		close(_handoffs[i].fd);
+
+	if (_wakeupPipe[1] >= 0)
+		close(_wakeupPipe[1]);
+}
+
+/*
+ * initWakeupPipe()
+ *
+ *  - reactor : pipe non bloquant dont le bout lecture est dans le Poller.
+ *    adoptConnection() y écrit un octet pour réveiller la boucle.
+ */
+void WebServer::initWakeupPipe()
+{
+	if (pipe(_wakeupPipe) < 0)
+	{
+		std::cerr << "Error: pipe() for reactor failed: "
+		          << std::strerror(errno) << std::endl;
+		throw std::runtime_error("pipe() failed");
+	}
+
+	for (int i = 0; i < 2; ++i)
+	{
+		// close-on-exec : les CGI et workers cgi_pool n'en héritent pas
+		int flags = fcntl(_wakeupPipe[i], F_GETFL, 0);
+		if (flags < 0 || fcntl(_wakeupPipe[i], F_SETFL, flags | O_NONBLOCK) < 0 ||
+		    fcntl(_wakeupPipe[i], F_SETFD, FD_CLOEXEC) < 0)
+		{
+			close(_wakeupPipe[0]);
+			close(_wakeupPipe[1]);
+			throw std::runtime_error("fcntl() on reactor pipe failed");
+		}
+	}
+
+	_fds.acquire(_wakeupPipe[0], FdSlot::FD_WAKEUP);
+	_poller.add(_wakeupPipe[0], Poller::EV_READ);
+}
+
+/*
+ * startReactors()
+ *
+ *  - acceptor : crée worker_threads reactors et lance leur thread.
+ */
+void WebServer::startReactors(const GlobalConfig &global)
+{
+	for (std::size_t i = 0; i < global.workerThreads; ++i)
+	{
+		WebServer *reactor = new WebServer(_servers, global, ROLE_REACTOR);
+		reactor->_fileCache = _fileCache; // caches partagés par le process
+		reactor->_responseCache = _responseCache;
+		reactor->_variantCache = _variantCache;
+		reactor->_cgiLimiters = _cgiLimiters;
+		reactor->_cgiCounters = _cgiCounters;
+		reactor->_upstreams = _upstreams;
+		_reactors.push_back(reactor);
+
+		if (pthread_create(&reactor->_thread, NULL,
+		                   &WebServer::reactorMain, reactor) != 0)
+		{
+			std::cerr << "Error: pthread_create() failed" << std::endl;
+			throw std::runtime_error("pthread_create() failed");
+		}
+		reactor->_threadStarted = true;
+	}
+
+	std::cout << "Started " << _reactors.size() << " reactor thread(s)\n";
+}
+
+// Tous arrêtés avant la première destruction : un reactor encore actif
+// pourrait réveiller (CgiLimiter) un reactor déjà détruit.
+void WebServer::stopReactors()
+{
+	for (std::size_t i = 0; i < _reactors.size(); ++i)
+	{
+		WebServer *reactor = _reactors[i];
+		if (reactor->_threadStarted)
+		{
+			__sync_lock_test_and_set(&reactor->_stop, 1);
+			ssize_t n = write(reactor->_wakeupPipe[1], "x", 1);
+			(void)n;
+		}
+	}
+	for (std::size_t i = 0; i < _reactors.size(); ++i)
+	{
+		if (_reactors[i]->_threadStarted)
+			pthread_join(_reactors[i]->_thread, NULL);
+	}
+	for (std::size_t i = 0; i < _reactors.size(); ++i)
+		delete _reactors[i];
+	_reactors.clear();
+}
+
+void *WebServer::reactorMain(void *arg)
+{
+	WebServer *reactor = static_cast<WebServer *>(arg);
+	reactor->run();
+	return NULL;
+}
+
+bool WebServer::stopRequested()
+{
+	return __sync_fetch_and_add(&_stop, 0) != 0;
+}
+
+int WebServer::activeClients()
+{
+	return __sync_fetch_and_add(&_activeClients, 0);
+}
+
+/*
+ * adoptConnection()
+ *
+ *  - appelé depuis le thread acceptor.
+ *  - on ne réveille le reactor que si la file était vide : un seul
+ *    octet suffit pour qu'il vide toute la file.
+ */
+void WebServer::adoptConnection(int fd, const ServerConfig *server,
+                                unsigned int clientIp)
+{
+	bool wasEmpty;
+	{
+		ScopedLock lock(_handoffMutex);
+		wasEmpty = _handoffs.empty();
+
+		Handoff h;
+		h.fd = fd;
+		h.server = server;
+		h.clientIp = clientIp;
+		_handoffs.push_back(h);
+	}
+
+	if (wasEmpty)
+	{
+		ssize_t n = write(_wakeupPipe[1], "x", 1);
+		(void)n; // EAGAIN : le pipe contient déjà un réveil
+	}
+}
+
+/*
+ * drainHandoffs()
+ *
+ *  - reactor : vide le pipe de réveil puis enregistre les connexions
+ *    reçues (la file est échangée sous lock, le travail se fait hors lock).
+ *  - puis lance les CGI de cette boucle admis par un autre reactor (place
+ *    libérée dans un CgiLimiter partagé).
+ */
+void WebServer::drainHandoffs()
+{
+	char buf[64];
+	while (read(_wakeupPipe[0], buf, sizeof(buf)) > 0)
+		;
+
+	std::vector<Handoff> batch;
+	{
+		ScopedLock lock(_handoffMutex);
+		batch.swap(_handoffs);
+	}
+
+	for (std::size_t i = 0; i < batch.size(); ++i)
+		registerClient(batch[i].fd, batch[i].server, batch[i].clientIp);
+
+	if (__sync_lock_test_and_set(&_cgiAdmitted, 0))
+	{
+		for (std::map<const LocationConfig *, CgiLimiter *>::iterator it = _cgiLimiters->begin();
+		     it != _cgiLimiters->end(); ++it)
+			admitQueuedCgi(it->second);
+	}
+}
+
+/*
+ * pickReactor()
+ *
+ *  - reactor le moins chargé ; en cas d'égalité, on part du suivant
+ *    en round-robin pour répartir les rafales de connexions.
+ */
+WebServer *WebServer::pickReactor()
+{
+	std::size_t count = _reactors.size();
+	std::size_t start = _nextReactor;
+	_nextReactor = (_nextReactor + 1) % count;
+
+	WebServer *best = _reactors[start];
+	int bestLoad = best->activeClients();
+
+	for (std::size_t k = 1; k < count && bestLoad > 0; ++k)
+	{
+		WebServer *cand = _reactors[(start + k) % count];
+		int load = cand->activeClients();
+		if (load < bestLoad)
+		{
+			best = cand;
+			bestLoad = load;
+		}
+	}
+
+	return best;
+}
 
+/*
+ * initListeningSockets()
+ *
+ *  - IMPORTANT pour multi-hostnames:
+ *    On crée UN socket d'écoute par port, même s'il y a plusieurs server{}
+ *    qui écoutent sur ce port.
+ *    Le premier server{} devient le "default server" pour ce port.
+ *
+ *  - Mode workers (worker_processes > 1) : chaque worker appelle cette
+ *    fonction dans son propre process, avec SO_REUSEPORT. Chaque worker
+ *    a donc sa propre file d'accept par port, répartie par le noyau.
+ */
+void WebServer::initListeningSockets()
+{
+	std::map<int, bool> portUsed; // port -> déjà un socket créé ?
+
+	for (std::size_t i = 0; i < _servers.size(); ++i)
+	{
+		const ServerConfig &cfg = _servers[i];
+
+		if (portUsed[cfg.port])
+		{
+			// Il y a déjà un socket sur ce port, on ne recrée pas un deuxième.
+			continue;
+		}
+
+		// Un CGI (ou un worker cgi_pool, qui survit au serveur quelques
+		// instants) ne doit pas garder le port ouvert : close-on-exec dès
+		// la création, comme les sockets clients d'accept4()
+#ifdef __linux__
+		int listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+#else
 		int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+#endif
 		if (listenFd < 0)
 		{
 			std::cerr << "Error: socket() failed: "
@@ -741,6 +1361,16 @@ void WebServer::initListeningSockets()
 			throw std::runtime_error("socket() failed");
 		}
 
+#ifndef __linux__
+		if (fcntl(listenFd, F_SETFD, FD_CLOEXEC) < 0)
+		{
+			std::cerr << "Error: fcntl(FD_CLOEXEC) failed: "
+			          << std::strerror(errno) << std::endl;
+			close(listenFd);
+			throw std::runtime_error("fcntl() failed");
+		}
+#endif
+
 		int opt = 1;
 		if (setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &opt,
 		               sizeof(opt)) < 0)
@@ -751,6 +1381,18 @@ void WebServer::initListeningSockets()
 			throw std::runtime_error("setsockopt() failed");
 		}
 
+#ifdef SO_REUSEPORT
+		if (_reusePort &&
+		    setsockopt(listenFd, SOL_SOCKET, SO_REUSEPORT, &opt,
+		               sizeof(opt)) < 0)
+		{
+			std::cerr << "Error: setsockopt(SO_REUSEPORT) failed: "
+			          << std::strerror(errno) << std::endl;
+			close(listenFd);
+			throw std::runtime_error("setsockopt() failed");
+		}
+#endif
+
 		struct sockaddr_in addr;
 		std::memset(&addr, 0, sizeof(addr));
 		addr.sin_family = AF_INET;
@@ -775,6 +1417,7 @@ void WebServer::initListeningSockets()
 			throw std::runtime_error("listen() failed");
 		}
 
+#ifndef __linux__
 		int flags = fcntl(listenFd, F_GETFL, 0);
 		if (flags < 0 || fcntl(listenFd, F_SETFL, flags | O_NONBLOCK) < 0)
 		{
@@ -784,16 +1427,15 @@ void WebServer::initListeningSockets()
 			close(listenFd);
 			throw std::runtime_error("fcntl() failed");
 		}
+#endif
 
-		struct pollfd pfd;
-		pfd.fd = listenFd;
-		pfd.events = POLLIN;
-		pfd.revents = 0;
-
-		_pollFds.push_back(pfd);
+		_poller.add(listenFd, Poller::EV_READ);
 
 		// Ce server devient le "default" pour ce port.
-		_listenFdToServer[listenFd] = &(_servers[i]);
+		FdSlot &slot = _fds.acquire(listenFd, FdSlot::FD_LISTENER);
+		slot.state.server = &(_servers[i]);
+		slot.state.timer.fd = listenFd;     // accept() réessayé (EMFILE)
+		_listenFds.push_back(listenFd);
 		portUsed[cfg.port] = true;
 
 		std::cout << "WebServer listening on port " << cfg.port
@@ -803,106 +1445,243 @@ void WebServer::initListeningSockets()
 
 /*
  * handleNewConnection()
+ *
+ *  - accepte UNE connexion sur listenFd.
+ *  - retourne 1 si une connexion a été acceptée, 0 si la file d'accept
+ *    est vide (EAGAIN), -1 en cas d'erreur (EMFILE...).
+ *  - erreur : epoll (edge-triggered) ne re-signalera pas les connexions
+ *    déjà en attente ; le timer du listener le remet dans la file
+ *    d'accept après ACCEPT_RETRY_MS (des fds se seront libérés).
  */
-void WebServer::handleNewConnection(std::size_t index)
+int WebServer::handleNewConnection(int listenFd)
 {
-	if (index >= _pollFds.size())
-		return;
-
-	int listenFd = _pollFds[index].fd;
-	std::map<int, const ServerConfig *>::iterator sit =
-	    _listenFdToServer.find(listenFd);
+	FdSlot *listenSlot = _fds.get(listenFd);
+	if (!listenSlot || listenSlot->kind != FdSlot::FD_LISTENER)
+		return -1;
 
-	if (sit == _listenFdToServer.end())
-		return;
-
-	const ServerConfig *server = sit->second;
+	const ServerConfig *server = listenSlot->state.server;
 
 	while (true)
 	{
 		struct sockaddr_in clientAddr;
 		socklen_t clientLen = sizeof(clientAddr);
 
+#ifdef __linux__
+		// Non bloquant + close-on-exec en un seul appel (pas de fcntl)
+		int clientFd = accept4(listenFd,
+			reinterpret_cast<struct sockaddr *>(&clientAddr),
+			&clientLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
 		int clientFd = accept(listenFd,
 			reinterpret_cast<struct sockaddr *>(&clientAddr),
 			&clientLen);
+#endif
 
 		if (clientFd < 0)
-			break; // plus de client à accepter (ou erreur non bloquante)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0; // file d'accept vide
+
+			std::cerr << "Error: accept() failed: "
+			          << std::strerror(errno) << ", retrying in "
+			          << ACCEPT_RETRY_MS << "ms" << std::endl;
+			_timers.schedule(listenSlot->state.timer, _now + ACCEPT_RETRY_MS);
+			return -1;
+		}
 
+#ifndef __linux__
 		int flags = fcntl(clientFd, F_GETFL, 0);
-		if (flags < 0 || fcntl(clientFd, F_SETFL, flags | O_NONBLOCK) < 0)
+		if (flags < 0 || fcntl(clientFd, F_SETFL, flags | O_NONBLOCK) < 0 ||
+		    fcntl(clientFd, F_SETFD, FD_CLOEXEC) < 0)
 		{
 			std::cerr << "Error: fcntl(O_NONBLOCK) on client failed: "
 			          << std::strerror(errno) << std::endl;
 			close(clientFd);
 			continue;
 		}
+#endif
+
+		unsigned int clientIp = clientAddr.sin_addr.s_addr;
+
+		// worker_threads : la connexion est servie par un reactor
+		if (!_reactors.empty())
+			pickReactor()->adoptConnection(clientFd, server, clientIp);
+		else
+			registerClient(clientFd, server, clientIp);
+		return 1;
+	}
+}
 
-		struct pollfd clientPfd;
-		clientPfd.fd = clientFd;
-		clientPfd.events = POLLIN;
-		clientPfd.revents = 0;
+/*
+ * markListenerReady()
+ *
+ *  - un listener signalé prêt entre dans la file d'accept (une seule
+ *    fois). Il y reste tant qu'accept() ne renvoie pas EAGAIN : en
+ *    edge-triggered, epoll ne le re-signalera pas.
+ */
+void WebServer::markListenerReady(int listenFd)
+{
+	for (std::size_t i = 0; i < _acceptQueue.size(); ++i)
+	{
+		if (_acceptQueue[i] == listenFd)
+			return;
+	}
+	_acceptQueue.push_back(listenFd);
+}
 
-		_pollFds.push_back(clientPfd);
+/*
+ * acceptPendingConnections()
+ *
+ *  - au plus _acceptBudget accept() par tour de boucle, tous ports
+ *    confondus : une rafale de connexions ne bloque pas les I/O des
+ *    clients déjà connectés.
+ *  - round-robin : un accept() par listener à tour de rôle, un port
+ *    très sollicité ne passe pas devant les autres.
+ *  - s'il reste des listeners dans la file, run() repasse tout de suite
+ *    (timeout 0) pour continuer au tour suivant.
+ */
+void WebServer::acceptPendingConnections()
+{
+	std::size_t budget = _acceptBudget;
 
-		ClientState state;
-		state.server = server;              // default server pour ce port
-		state.lastActivity = std::time(0);  // maintenant
-		_clients[clientFd] = state;
+	while (budget > 0 && !_acceptQueue.empty())
+	{
+		int listenFd = _acceptQueue.front();
+		_acceptQueue.pop_front();
 
-		std::cout << "New client on port " << server->port
-		          << ", fd = " << clientFd << std::endl;
+		if (handleNewConnection(listenFd) > 0)
+		{
+			--budget;
+			_acceptQueue.push_back(listenFd); // encore des connexions ?
+		}
 	}
 }
 
+/*
+ * registerClient()
+ *
+ *  - enregistre une connexion acceptée dans CETTE boucle.
+ */
+void WebServer::registerClient(int clientFd, const ServerConfig *server,
+                               unsigned int clientIp)
+{
+	_poller.add(clientFd, Poller::EV_READ);
+
+	// Pas de copie : on réinitialise directement la case du fd
+	FdSlot &slot = _fds.acquire(clientFd, FdSlot::FD_CLIENT);
+	slot.state.server = server;              // default server pour ce port
+	slot.state.defaultServer = server;
+	slot.state.lastActivity = _now;          // maintenant
+	slot.state.timer.fd = clientFd;
+	slot.state.clientIp = clientIp;
+	armClientTimer(slot.state);
+
+	__sync_fetch_and_add(&_activeClients, 1);
+}
+
 /*
  * handleClientRead()
+ *
+ *  - lit jusqu'à EAGAIN (obligatoire en edge-triggered : epoll ne
+ *    re-signalera pas les octets déjà présents dans la socket).
+ *  - EOF (le client a fermé sa moitié, ou tout) : les requêtes déjà
+ *    reçues sont traitées et leurs réponses envoyées, puis la connexion
+ *    est fermée (closeIfDrained()).
  */
-void WebServer::handleClientRead(std::size_t index)
+void WebServer::handleClientRead(int fd)
 {
-	if (index >= _pollFds.size())
+	FdSlot *slot = _fds.get(fd);
+	if (!slot || slot->kind != FdSlot::FD_CLIENT)
 		return;
 
-	int fd = _pollFds[index].fd;
-	char buffer[1024];
-
-	int bytesRead = recv(fd, buffer, sizeof(buffer), 0);
-
-	if (bytesRead < 0)
+	ClientState &state = slot->state;
+	if (!state.server)
 	{
-		std::cerr << "Error: recv() failed on fd " << fd
-		          << ": " << std::strerror(errno) << std::endl;
-		removeClient(index);
+		removeClient(fd);
 		return;
 	}
-	else if (bytesRead == 0)
-	{
-		std::cout << "Client disconnected, fd = " << fd << std::endl;
-		removeClient(index);
+
+	// Trop de réponses en attente : on laisse les octets dans la socket
+	// (backpressure TCP). La lecture reprend quand la file se vide.
+	if (state.inputPaused || state.peerClosed)
 		return;
-	}
 
-	std::map<int, ClientState>::iterator it = _clients.find(fd);
-	if (it == _clients.end())
+	char buffer[4096];
+	bool gotData = false;
+
+	while (true)
 	{
-		removeClient(index);
+		ssize_t bytesRead = recv(fd, buffer, sizeof(buffer), 0);
+
+		if (bytesRead > 0)
+		{
+			state.readBuffer.append(buffer, static_cast<std::size_t>(bytesRead));
+			gotData = true;
+			continue;
+		}
+
+		if (bytesRead == 0)
+		{
+			std::cout << "Client disconnected, fd = " << fd << std::endl;
+			state.peerClosed = true;
+			break;
+		}
+
+		if (errno == EINTR)
+			continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			break;
+
+		std::cerr << "Error: recv() failed on fd " << fd
+		          << ": " << std::strerror(errno) << std::endl;
+		removeClient(fd);
 		return;
 	}
 
-	ClientState &state = it->second;
-	if (!state.server)
-	{
-		removeClient(index);
+	if (!gotData && !state.peerClosed)
 		return;
-	}
 
-	state.lastActivity = std::time(0); // on vient de recevoir des données
-	state.readBuffer.append(buffer, bytesRead);
+	if (gotData)
+		state.lastActivity = _now; // on vient de recevoir des données
 
-	// On boucle tant qu'on n'a pas traité la requête
-	while (!state.requestHandled)
+	processClientInput(fd, state);
+	closeIfDrained(fd, state);
+}
+
+/*
+ * processClientInput()
+ *
+ *  - parse readBuffer (headers puis body) et construit la réponse
+ *    dès que la requête est complète.
+ *  - pipelining : on traite TOUTES les requêtes complètes déjà
+ *    présentes dans readBuffer ; leurs réponses sont mises en file dans
+ *    l'ordre, dans la limite de pipeline_max_requests.
+ *  - appelé après une lecture, et après l'envoi d'une réponse
+ *    (readBuffer peut contenir des requêtes bloquées par la limite).
+ */
+void WebServer::processClientInput(int fd, ClientState &state)
+{
+	while (true)
 	{
+		// Une réponse "Connection: close" est en file : on ignore la suite
+		if (state.closing)
+		{
+			state.readBuffer.clear();
+			break;
+		}
+
+		// Limite de requêtes en vol atteinte : on arrête de lire
+		if (state.responses.size() >= state.server->pipelineMaxRequests)
+		{
+			state.inputPaused = true;
+			break;
+		}
+
+		if (state.readBuffer.empty() && !state.headersComplete)
+			break;
+
 		// 1) On attend d'avoir les headers complets ("\r\n\r\n")
 		if (!state.headersComplete)
 		{
@@ -921,11 +1700,8 @@ void WebServer::handleClientRead(std::size_t index)
 				HttpResponse response;
 				setErrorResponse(*(state.server), response, 400, "Bad Request");
 
-				state.writeBuffer = response.toString();
-				state.requestHandled = true;
-				state.headersComplete = true;
 				state.readBuffer.clear();
-				_pollFds[index].events |= POLLOUT;
+				queueResponse(state, response, false);
 				break;
 			}
 
@@ -961,11 +1737,8 @@ void WebServer::handleClientRead(std::size_t index)
 					HttpResponse response;
 					setErrorResponse(*(state.server), response, 400, "Bad Request");
 
-					state.writeBuffer = response.toString();
-					state.requestHandled = true;
-					state.headersComplete = true;
 					state.readBuffer.clear();
-					_pollFds[index].events |= POLLOUT;
+					queueResponse(state, response, false);
 					break;
 				}
 				state.contentLength = 0; // pas utilisé en chunked
@@ -983,11 +1756,8 @@ void WebServer::handleClientRead(std::size_t index)
 						HttpResponse response;
 						setErrorResponse(*(state.server), response, 400, "Bad Request");
 
-						state.writeBuffer = response.toString();
-						state.requestHandled = true;
-						state.headersComplete = true;
 						state.readBuffer.clear();
-						_pollFds[index].events |= POLLOUT;
+						queueResponse(state, response, false);
 						break;
 					}
 				}
@@ -1000,11 +1770,8 @@ void WebServer::handleClientRead(std::size_t index)
 					HttpResponse response;
 					setErrorResponse(*(state.server), response, 413, "Payload Too Large");
 
-					state.writeBuffer = response.toString();
-					state.requestHandled = true;
-					state.headersComplete = true;
 					state.readBuffer.clear();
-					_pollFds[index].events |= POLLOUT;
+					queueResponse(state, response, false);
 					break;
 				}
 			}
@@ -1036,10 +1803,8 @@ void WebServer::handleClientRead(std::size_t index)
 				else
 					setErrorResponse(*(state.server), response, 400, "Bad Request");
 
-				state.writeBuffer = response.toString();
-				state.requestHandled = true;
 				state.readBuffer.clear();
-				_pollFds[index].events |= POLLOUT;
+				queueResponse(state, response, false);
 				break;
 			}
 
@@ -1075,75 +1840,2086 @@ void WebServer::handleClientRead(std::size_t index)
 
 		// 3) On construit la réponse HTTP en fonction de la requête
 		HttpResponse response;
-		buildHttpResponse(*(state.server), state.request, response);
+		CgiJob *cgi = NULL;
+		buildHttpResponse(*(state.server), state.request, state.clientIp,
+		                  response, cgi);
+
+		if (cgi)
+			queueCgi(fd, state, cgi, wantsKeepAlive(state));
+		else
+			queueResponse(state, response, wantsKeepAlive(state));
+	}
+
+	updateClientEvents(fd, state);
+}
+
+/*
+ * wantsKeepAlive()
+ *
+ *  - HTTP/1.1 : connexion persistante sauf "Connection: close"
+ *  - HTTP/1.0 : seulement si "Connection: keep-alive"
+ *  - limites du server : keepalive_timeout (0 = off), keepalive_requests
+ */
+bool WebServer::wantsKeepAlive(const ClientState &state) const
+{
+	const ServerConfig *server = state.server;
+	if (!server || server->keepaliveTimeout <= 0)
+		return false;
+
+	if (state.requestsServed + 1 >= server->keepaliveRequests)
+		return false;
+
+	std::string conn = state.request.getHeader("Connection");
+	std::string lower;
+	for (std::size_t i = 0; i < conn.size(); ++i)
+	{
+		char c = conn[i];
+		if (c >= 'A' && c <= 'Z')
+			c = static_cast<char>(c - 'A' + 'a');
+		lower.push_back(c);
+	}
+
+	if (state.request.getVersion() == "HTTP/1.0")
+		return lower.find("keep-alive") != std::string::npos;
+
+	return lower.find("close") == std::string::npos;
+}
+
+/*
+ * queueResponse()
+ *
+ *  - met la réponse dans un ResponseSlot en fin de file, prêt à partir.
+ */
+void WebServer::queueResponse(ClientState &state,
+                              HttpResponse &response, bool keepAlive)
+{
+	ResponseSlot &slot = openResponseSlot(state, keepAlive);
+	fillResponseSlot(slot, response);
+
+	// La requête est traitée : on passe à la suivante (pipelining)
+	state.resetForNextRequest();
+}
+
+/*
+ * openResponseSlot()
+ *
+ *  - réserve la place de la réponse de la requête courante, dans l'ordre
+ *    de la file ; la valeur Keep-Alive est calculée maintenant (elle
+ *    dépend du nombre de requêtes déjà servies).
+ */
+ResponseSlot &WebServer::openResponseSlot(ClientState &state, bool keepAlive)
+{
+	state.responses.push_back(ResponseSlot());
+	ResponseSlot &slot = state.responses.back();
+	slot.closeAfter = !keepAlive;
+	state.lastServer = state.server; // délai d'inactivité annoncé
+
+	if (keepAlive)
+	{
+		std::ostringstream ka;
+		ka << "timeout=" << state.server->keepaliveTimeout
+		   << ", max=" << (state.server->keepaliveRequests - state.requestsServed - 1);
+		slot.keepAlive = ka.str();
+	}
+	else
+		state.closing = true;
+
+	return slot;
+}
+
+/*
+ * fillResponseSlot()
+ *
+ *  - ajoute les headers Connection / Keep-Alive
+ *  - un segment pour les headers, puis le body (pris par swap, sans
+ *    copie, ou segments fichier envoyés avec sendfile).
+ *  - réponse du ResponseCache : deux tranches de l'entrée partagée
+ *    encadrant les headers de connexion.
+ */
+void WebServer::fillResponseSlot(ResponseSlot &slot, HttpResponse &response)
+{
+	bool keepAlive = !slot.closeAfter;
+
+	if (response.hasCachedBody())
+	{
+		// Réponse déjà sérialisée : headers de connexion insérés à headLen
+		ResponseCache::Entry *cached = response.releaseCachedBody();
+		std::string conn;
+		if (keepAlive)
+			conn = "Connection: keep-alive\r\nKeep-Alive: " + slot.keepAlive + "\r\n";
+		else
+			conn = "Connection: close\r\n";
+
+		ResponseCache::retain(cached);
+		slot.out.appendCached(cached, 0, cached->headLen);
+		slot.out.append(conn);
+		slot.out.appendCached(cached, cached->headLen, cached->bytes.size());
+	}
+	else
+	{
+		if (keepAlive)
+		{
+			response.setHeader("Connection", "keep-alive");
+			response.setHeader("Keep-Alive", slot.keepAlive);
+		}
+		else
+			response.setHeader("Connection", "close");
+
+		std::string headers = response.serializeHeaders();
+		slot.out.append(headers);
+		response.moveBodyTo(slot.out);
+	}
+
+	slot.ready = true;
+}
+
+/*
+ * updateClientEvents()
+ *
+ *  - EV_READ sauf si la lecture est en pause (trop de réponses en file)
+ *  - EV_WRITE si la réponse de tête est prête
+ *  - timeout : keepalive_timeout si la connexion est au repos entre deux
+ *    requêtes, CLIENT_TIMEOUT_SECONDS sinon (le timer est réarmé). Le
+ *    keepalive_timeout est celui du vhost de la dernière réponse : celui
+ *    annoncé dans son header Keep-Alive.
+ */
+void WebServer::updateClientEvents(int fd, ClientState &state)
+{
+	unsigned events = 0;
+	if (!state.inputPaused && !state.peerClosed)
+		events |= Poller::EV_READ;
+	if (!state.responses.empty() && canSend(state.responses.front()))
+		events |= Poller::EV_WRITE;
+	_poller.modify(fd, events);
+
+	bool idle = state.responses.empty() &&
+	            state.readBuffer.empty() &&
+	            !state.headersComplete &&
+	            state.requestsServed > 0;
+	if (idle && state.lastServer)
+		state.idleTimeout = state.lastServer->keepaliveTimeout;
+	else
+		state.idleTimeout = CLIENT_TIMEOUT_SECONDS;
+
+	armClientTimer(state);
+}
+
+/*
+ * armClientTimer()
+ *
+ *  - échéance = dernière activité + idleTimeout.
+ *  - recv/send ne touchent que lastActivity : si le timer expire alors
+ *    que le client a été actif entre-temps, expireTimers() le réarme.
+ */
+void WebServer::armClientTimer(ClientState &state)
+{
+	_timers.schedule(state.timer, state.lastActivity
+	                 + static_cast<unsigned long>(state.idleTimeout) * 1000UL);
+}
+
+/*
+ * expireTimers()
+ *
+ *  - fait avancer la roue jusqu'à _now : seuls les timers échus sont
+ *    visités (O(expirés), pas O(connexions)).
+ *  - on relève d'abord les fds : traiter un timer peut en détruire
+ *    d'autres (un client fermé emporte ses CGI et leurs TimerNode).
+ *  - un client qui attend la sortie d'un CGI n'est pas "inactif" :
+ *    c'est le timeout du CGI qui s'applique.
+ */
+void WebServer::expireTimers()
+{
+	_timers.advance(_now, _expired);
+
+	bool cgiQueues = false;
+	for (std::size_t i = 0; i < _expired.size(); ++i)
+	{
+		if (_expired[i]->fd < 0)
+			cgiQueues = true; // file d'admission d'un CgiLimiter
+		else
+			_expiredFds.push_back(_expired[i]->fd);
+	}
+	_expired.clear();
+	if (cgiQueues)
+		expireCgiQueues();
+
+	for (std::size_t i = 0; i < _expiredFds.size(); ++i)
+	{
+		int fd = _expiredFds[i];
+		FdSlot *slot = _fds.get(fd);
+		if (!slot)
+			continue;
+
+		if (slot->kind == FdSlot::FD_CGI)
+		{
+			CgiJob *job = slot->cgi;
+			if (_now >= job->deadline)
+			{
+				std::cerr << "CGI timeout (" << CGI_TIMEOUT_SECONDS
+				          << "s) for script: " << job->process.scriptPath()
+				          << std::endl;
+				job->process.kill();
+				finishCgi(job, true);
+			}
+			else
+				progressCgi(job); // sans pidfd : nouvel essai de waitpid()
+			continue;
+		}
+
+		if (slot->kind == FdSlot::FD_FASTCGI)
+		{
+			expireFastCgi(slot->fastcgi);
+			continue;
+		}
+
+		if (slot->kind == FdSlot::FD_PROXY)
+		{
+			expireProxy(slot->proxy);
+			continue;
+		}
+
+		if (slot->kind == FdSlot::FD_LISTENER)
+		{
+			markListenerReady(fd); // accept() en échec : nouvel essai
+			continue;
+		}
+
+		if (slot->kind != FdSlot::FD_CLIENT)
+			continue;
+
+		ClientState &state = slot->state;
+		unsigned long deadline = state.lastActivity
+		                       + static_cast<unsigned long>(state.idleTimeout) * 1000UL;
+		if (_now < deadline)
+		{
+			_timers.schedule(state.timer, deadline); // activité depuis
+			continue;
+		}
+
+		// (un CGI en pause attend le client : le timeout client s'applique)
+		bool waitingCgi = false;
+		for (std::size_t k = 0; k < state.responses.size() && !waitingCgi; ++k)
+			waitingCgi = state.responses[k].cgi && !state.responses[k].cgi->paused;
+		if (waitingCgi)
+		{
+			state.lastActivity = _now;
+			armClientTimer(state);
+			continue;
+		}
+
+		std::cout << "Client fd " << fd << " timed out, closing." << std::endl;
+		removeClient(fd);
+	}
+	_expiredFds.clear();
+}
+
+/*
+ * handleClientWrite()
+ *
+ *  - envoie les réponses prêtes, dans l'ordre, jusqu'à EAGAIN.
+ *  - un seul writev() couvre les segments de toutes les réponses prêtes
+ *    en tête de file (pipelining) ; les offsets avancent, rien n'est
+ *    recopié ni décalé en mémoire.
+ *  - une fois la file vidée, on reprend les requêtes en attente.
+ */
+void WebServer::handleClientWrite(int fd)
+{
+	FdSlot *slot = _fds.get(fd);
+	if (!slot || slot->kind != FdSlot::FD_CLIENT)
+		return;
+
+	ClientState &state = slot->state;
+
+	while (true)
+	{
+		while (!state.responses.empty() && canSend(state.responses.front()))
+		{
+			struct iovec iov[WRITEV_MAX_IOV];
+			int iovCount = 0;
+
+			for (std::size_t i = 0; i < state.responses.size() &&
+			     iovCount < WRITEV_MAX_IOV; ++i)
+			{
+				const ResponseSlot &rs = state.responses[i];
+				if (!rs.ready)
+					break;
+				bool whole = false;
+				iovCount += rs.out.fillIovec(iov + iovCount,
+				                             WRITEV_MAX_IOV - iovCount, whole);
+				if (!whole || rs.closeAfter || rs.cgi)
+					break; // segment fichier (la suite après sendfile), ou
+					       // body CGI pas encore complet
+			}
+
+			ssize_t bytesSent = 0;
+			int         fileFd;
+			off_t       fileOffset;
+			std::size_t fileLeft;
+			const char *op = "writev";
+			const OutputQueue &front = state.responses.front().out;
+
+			if (iovCount > 0)
+				bytesSent = writev(fd, iov, iovCount);
+			else if (front.frontFile(fileFd, fileOffset, fileLeft))
+			{
+				op = "sendfile";
+				bytesSent = sendFileChunk(fd, fileFd, fileOffset,
+				                          std::min(fileLeft, _sendfileChunk));
+			}
+			else if (front.frontPipe(fileFd, fileLeft))
+			{
+				op = "splice";
+				bytesSent = splicePipe(fd, fileFd, fileLeft);
+			}
+
+			if (bytesSent < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+					return; // on attend le prochain EV_WRITE
+
+				std::cerr << "Error: " << op << "() failed on fd " << fd
+				          << ": " << std::strerror(errno) << std::endl;
+				removeClient(fd);
+				return;
+			}
+			if (bytesSent == 0 && iovCount == 0 &&
+			    !state.responses.front().out.empty())
+			{
+				// Fichier tronqué pendant l'envoi : Content-Length faux
+				// (pipe : ne devrait pas arriver, ses octets sont comptés)
+				std::cerr << "Error: " << op << "() sent nothing on fd "
+				          << fd << " (source shrank)" << std::endl;
+				removeClient(fd);
+				return;
+			}
+			if (bytesSent > 0)
+				state.lastActivity = _now; // activité d'écriture
+
+			// Répartit les octets envoyés sur les réponses de tête
+			std::size_t left = static_cast<std::size_t>(bytesSent);
+			while (!state.responses.empty() && state.responses.front().ready)
+			{
+				ResponseSlot &head = state.responses.front();
+				std::size_t n = std::min(left, head.out.pending());
+				head.out.consume(n);
+				left -= n;
+
+				if (!head.out.empty() || head.cgi)
+				{
+					// Streaming : assez de place (et plus d'octets en
+					// attente dans le pipe), le script peut reprendre
+					// (resumeCgi() peut aussi terminer le slot)
+					if (head.cgi && head.cgi->paused &&
+					    head.out.pending() < CGI_BUFFER_SIZE &&
+					    !head.out.hasPipe())
+						resumeCgi(head.cgi);
+					break;
+				}
+
+				bool closeAfter = head.closeAfter;
+				state.responses.pop_front();
+
+				if (closeAfter)
+				{
+					removeClient(fd);
+					return;
+				}
+			}
+		}
+
+		// De la place dans la file : on reprend le parsing des requêtes
+		// déjà bufferisées (bloquées par pipeline_max_requests).
+		bool wasPaused = state.inputPaused;
+		state.inputPaused = false;
+		processClientInput(fd, state);
+
+		// Nouvelles réponses prêtes : on continue d'écrire tout de suite.
+		// (En edge-triggered, la socket est restée writable : aucun nouvel
+		// EV_WRITE n'arriverait.)
+		if (!state.responses.empty() && canSend(state.responses.front()))
+			continue;
+
+		if (closeIfDrained(fd, state))
+			return;
+
+		// Les octets restés dans la socket pendant la pause ne seront pas
+		// re-signalés en edge-triggered : on les lit explicitement.
+		if (wasPaused && !state.inputPaused)
+			handleClientRead(fd);
+		return;
+	}
+}
+
+/*
+ * removeClient()
+ */
+void WebServer::removeClient(int fd)
+{
+	FdSlot *slot = _fds.get(fd);
+	if (!slot || slot->kind != FdSlot::FD_CLIENT)
+		return;
+
+	_timers.cancel(slot->state.timer);
+	abortClientCgi(slot->state);
+	_fds.release(fd);
+	_poller.remove(fd);
+	close(fd);
+
+	__sync_fetch_and_sub(&_activeClients, 1);
+
+	std::cout << "Closed client fd " << fd << std::endl;
+}
+
+// Client qui a fermé sa moitié de connexion : fermé dès que toutes
+// ses réponses sont parties ; true s'il a été fermé.
+bool WebServer::closeIfDrained(int fd, ClientState &state)
+{
+	if (!state.peerClosed || !state.responses.empty() || state.inputPaused)
+		return false;
+
+	removeClient(fd);
+	return true;
+}
+
+/*
+ * startCgi()
+ *
+ *  - prépare l'environnement et le body du script, puis le lance si la
+ *    location a une place libre (cgi_max_concurrency) ; sinon le job
+ *    attend dans la file du CgiLimiter et part depuis admitQueuedCgi().
+ *  - NULL et la réponse d'erreur : file pleine (503 ; rejectCgi() l'a
+ *    vue avant, sauf course avec un autre reactor) ou lancement raté
+ *    (500).
+ */
+CgiJob *WebServer::startCgi(const HttpRequest &request,
+                            const ServerConfig &server,
+                            const LocationConfig *loc,
+                            const std::string &scriptPath,
+                            HttpResponse &response)
+{
+	CgiJob *job = new CgiJob();
+	job->server = &server;
+	job->loc = loc;
+	job->scriptPath = scriptPath;
+
+	job->input = prepareCgiBody(request);
+	job->env = buildCgiEnv(request, server, scriptPath, job->input.size());
+	// Seul un POST envoie son body sur stdin
+	if (request.getMethod() != "POST")
+		job->input.clear();
+
+	CgiLimiter *limiter = loc ? cgiLimiterFor(*loc) : NULL;
+	if (limiter)
+	{
+		job->limiter = limiter;
+		CgiLimiter::Admission admission = limiter->enter(job, this, _now);
+		if (admission == CgiLimiter::FULL)
+		{
+			delete job;
+			setCgiBusyResponse(server, limiter, response);
+			return NULL;
+		}
+		if (admission == CgiLimiter::QUEUED)
+		{
+			job->waiting = true;
+			armCgiQueueTimer();
+			return job;
+		}
+	}
+
+	if (!runCgi(job))
+	{
+		delete job;
+		setErrorResponse(server, response, 500, "Internal Server Error");
+		if (limiter)
+		{
+			WebServer *owner = limiter->finished();
+			if (owner)
+				releaseCgiSlot(owner, limiter);
+		}
+		return NULL;
+	}
+	return job;
+}
+
+/*
+ * runCgi()
+ *
+ *  - job admis : cgi_pool, voir startPooledCgi(). Sinon lance le script
+ *    et inscrit ses fds dans la boucle : stdin en EV_WRITE tant qu'il
+ *    reste du body à écrire, stdout en EV_READ, et le pidfd (fin du
+ *    process) en EV_READ.
+ *  - le timeout passe par la TimerWheel (timer indexé par le fd stdout).
+ *  - false si le lancement échoue.
+ */
+bool WebServer::runCgi(CgiJob *job)
+{
+	const LocationConfig *loc = job->loc;
+	if (loc && loc->cgiPoolSize > 0)
+	{
+		startPooledCgi(job);
+		return true;
+	}
+
+	CgiProcess &p = job->process;
+	if (!p.start(loc ? loc->cgiPath : std::string(), job->scriptPath,
+	             job->env, job->input))
+		return false;
+	std::vector<std::string>().swap(job->env);
+	std::string().swap(job->input);
+
+	job->deadline = _now + static_cast<unsigned long>(CGI_TIMEOUT_SECONDS) * 1000UL;
+
+	// Le pipe absorbe souvent tout le body d'un coup
+	if (p.writeInput())
+		p.closeInput();
+	else
+		watchCgiFd(p.inputFd(), job, Poller::EV_WRITE);
+
+	watchCgiFd(p.outputFd(), job, Poller::EV_READ);
+	if (p.exitFd() >= 0)
+		watchCgiFd(p.exitFd(), job, Poller::EV_READ);
+
+	job->timer.fd = p.outputFd();
+	_timers.schedule(job->timer, job->deadline);
+	return true;
+}
+
+/*
+ * queueCgi()
+ *
+ *  - réserve la réponse du CGI dans la file du client (ready = false) :
+ *    la connexion continue à parser les requêtes suivantes, dont les
+ *    réponses partiront après celle du CGI.
+ */
+void WebServer::queueCgi(int fd, ClientState &state, CgiJob *job,
+                         bool keepAlive)
+{
+	ResponseSlot &slot = openResponseSlot(state, keepAlive);
+	slot.cgi = job;
+
+	job->clientFd = fd;
+	job->slot = &slot; // stable : deque::push_back ne déplace pas les éléments
+	job->acceptEncoding = state.request.getHeader("Accept-Encoding");
+	job->chunkedOk = state.request.getVersion() != "HTTP/1.0";
+
+	state.resetForNextRequest();
+}
+
+void WebServer::watchCgiFd(int fd, CgiJob *job, unsigned events)
+{
+	FdSlot &slot = _fds.acquire(fd, FdSlot::FD_CGI);
+	slot.cgi = job;
+	_poller.add(fd, events);
+}
+
+// Avant close() : le numéro de fd peut être réutilisé aussitôt.
+void WebServer::unwatchCgiFd(int fd)
+{
+	if (fd < 0)
+		return;
+	_poller.remove(fd);
+	_fds.release(fd);
+}
+
+/*
+ * handleCgiEvent()
+ *
+ *  - stdin prêt : on écrit la suite du body, puis on le ferme.
+ *  - stdout prêt (ou raccroché) : voir pumpCgiOutput().
+ *  - pidfd lisible : le script est terminé, on le réape.
+ */
+void WebServer::handleCgiEvent(int fd)
+{
+	FdSlot *slot = _fds.get(fd);
+	CgiJob *job = slot->cgi;
+	CgiProcess &p = job->process;
+
+	if (fd == p.inputFd())
+	{
+		if (p.writeInput())
+		{
+			unwatchCgiFd(fd);
+			p.closeInput();
+		}
+		return;
+	}
+
+	if (fd == p.outputFd())
+		pumpCgiOutput(job);
+	else if (fd == p.exitFd())
+	{
+		if (p.reap())
+			_poller.remove(fd);
+	}
+
+	progressCgi(job);
+}
+
+/*
+ * pumpCgiOutput()
+ *
+ *  - lit stdout par blocs jusqu'à EAGAIN / EOF, ou jusqu'à la pause
+ *    (backpressure). Le fd reste ouvert après l'EOF (clé du timer),
+ *    hors du Poller.
+ *  - les headers partent dès qu'ils sont complets, puis chaque bloc de
+ *    body lu est transmis. Une sortie qui arrive en entier (EOF dans le
+ *    même passage) donne une réponse classique, construite à la fin :
+ *    un script qui échoue obtient encore son 500.
+ *  - le timeout CGI compte l'inactivité du script : chaque lecture le
+ *    repousse.
+ *  - body en splice : les octets restent dans le pipe (spliceCgiOutput()),
+ *    read() ne sert plus qu'à voir l'EOF.
+ */
+void WebServer::pumpCgiOutput(CgiJob *job)
+{
+	CgiProcess &p = job->process;
+
+	while (!job->paused && !p.outputDone())
+	{
+		if (job->splice && spliceCgiOutput(job))
+			break;
+
+		std::size_t before = p.buffered();
+		CgiProcess::ReadResult r = p.readOutput(CGI_BUFFER_SIZE);
+
+		if (r == CgiProcess::READ_EOF)
+			_poller.remove(p.outputFd());
+		else if (p.buffered() > before)
+		{
+			job->deadline = _now + static_cast<unsigned long>(CGI_TIMEOUT_SECONDS) * 1000UL;
+			_timers.schedule(job->timer, job->deadline);
+		}
+
+		deliverCgiOutput(job);
+
+		if (r != CgiProcess::READ_MORE)
+			break;
+	}
+}
+
+// Sortie lue (script local ou FastCGI) : headers dès qu'ils sont
+// complets, puis le body au fil de l'eau.
+void WebServer::deliverCgiOutput(CgiJob *job)
+{
+	if (!job->streaming && !job->output().outputDone())
+		startCgiStream(job);
+	if (job->streaming)
+		forwardCgiOutput(job);
+}
+
+/*
+ * startCgiStream()
+ *
+ *  - bloc de headers complet (ou CGI_BUFFER_SIZE octets sans
+ *    séparateur : tout est body) : la réponse part sans body.
+ *  - body : Content-Length du script s'il en donne un, sinon chunked
+ *    (HTTP/1.1) ou fin de connexion (HTTP/1.0). Compression à la volée
+ *    (compress on) : toujours sans Content-Length.
+ */
+void WebServer::startCgiStream(CgiJob *job)
+{
+	CgiOutput &p = job->output();
+	int status;
+	std::string reason;
+	CgiOutput::HeaderMap headers;
+
+	if (!p.parseHeaders(status, reason, headers))
+	{
+		if (p.buffered() < CGI_BUFFER_SIZE)
+			return; // headers pas encore complets
+		status = 200;
+		reason = "OK";
+	}
+
+	HttpResponse response;
+	response.setStatus(status, reason);
+	for (CgiOutput::HeaderMap::const_iterator it = headers.begin();
+	     it != headers.end(); ++it)
+		response.setHeader(it->first, it->second);
+	if (response.getHeader("Content-Type").empty() && status != 204 &&
+	    status != 304)
+		response.setHeader("Content-Type", "text/html");
+
+	// Content-Length normalisé (le script peut l'écrire dans n'importe
+	// quelle casse) : remis plus bas s'il est gardé
+	std::string length = response.getHeader("Content-Length");
+	response.removeHeader("Content-Length");
+	response.removeHeader("Transfer-Encoding");
+	response.setStreamedBody();
+
+	std::size_t declared = 0;
+	bool hasLength = false;
+	if (!length.empty())
+	{
+		std::istringstream iss(length);
+		hasLength = (iss >> declared) && iss.eof();
+	}
+
+	const LocationConfig *loc = job->loc;
+	Compressor::Format format;
+	job->discardBody = status < 200 || status == 204 || status == 304;
+
+	if (!job->discardBody && status < 300 && status != 206 && loc &&
+	    loc->compress && response.getHeader("Content-Encoding").empty())
+	{
+		response.setHeader("Vary", "Accept-Encoding");
+		if ((!hasLength || declared >= loc->compressMinLength) &&
+		    pickCompression(job->acceptEncoding, loc,
+		                    response.getHeader("Content-Type"), format))
+		{
+			job->compressor = new Compressor(format, loc->compressLevel);
+			response.setHeader("Content-Encoding", Compressor::encodingName(format));
+			hasLength = false;
+		}
+	}
+
+	FdSlot *cs = _fds.get(job->clientFd);
+	ResponseSlot &rs = *job->slot;
+
+	// 1xx, 204, 304 (discardBody) : ni body ni Content-Length
+	if (!job->discardBody)
+	{
+		if (hasLength)
+		{
+			job->lengthKnown = true;
+			job->bodyLeft = declared;
+			response.setHeader("Content-Length", length);
+		}
+		else if (job->chunkedOk)
+		{
+			job->chunked = true;
+			response.setHeader("Transfer-Encoding", "chunked");
+		}
+		else
+		{
+			// HTTP/1.0 : la fin du body est la fermeture de la connexion
+			rs.closeAfter = true;
+			cs->state.closing = true;
+		}
+	}
+
+#ifdef __linux__
+	// Body non transformé d'un script local : splice() pipe -> socket
+	job->splice = !job->remote && !job->proxied && !job->compressor &&
+	              !job->discardBody;
+#endif
+
+	job->streaming = true;
+	fillResponseSlot(rs, response);
+	updateClientEvents(job->clientFd, cs->state);
+}
+
+/*
+ * forwardCgiOutput()
+ *
+ *  - met le body déjà lu dans la réponse (compressé, puis encadré en
+ *    chunk si besoin) et réveille l'écriture côté client.
+ *  - backpressure : trop d'octets en attente d'envoi => on ne lit plus
+ *    le pipe ; handleClientWrite() relance la lecture (resumeCgi()).
+ */
+void WebServer::forwardCgiOutput(CgiJob *job)
+{
+	std::string data;
+	job->output().takeOutput(data);
+	if (data.empty() || job->discardBody)
+		return;
+
+	if (job->lengthKnown)
+	{
+		// Octets au-delà du Content-Length annoncé : ignorés
+		if (data.size() > job->bodyLeft)
+			data.resize(job->bodyLeft);
+		job->bodyLeft -= data.size();
+	}
+
+	if (job->compressor)
+	{
+		std::string packed;
+		if (!job->compressor->update(data.data(), data.size(), packed) ||
+		    !job->compressor->flush(packed))
+			packed.clear();
+		data.swap(packed);
+	}
+
+	ResponseSlot &rs = *job->slot;
+	if (data.empty())
+		return;
+
+	appendBodyChunk(rs.out, data, job->chunked);
+
+	if (rs.out.pending() >= CGI_STREAM_HIGH_WATER && !job->output().outputDone())
+		pauseCgi(job);
+
+	FdSlot *cs = _fds.get(job->clientFd);
+	updateClientEvents(job->clientFd, cs->state);
+}
+
+/*
+ * spliceCgiOutput()
+ *
+ *  - body d'un CGI local, sans compression : au lieu de lire le pipe,
+ *    on met en file un segment pipe des octets déjà présents (FIONREAD),
+ *    encadré en chunk si besoin ; handleClientWrite() les passe à la
+ *    socket avec splice(), sans copie.
+ *  - un segment à la fois : le job est mis en pause (pipe hors du
+ *    Poller) jusqu'à ce que le segment soit parti. Le script bloque sur
+ *    son write quand le pipe est plein : c'est la backpressure.
+ *  - false si le pipe est vide (ou le Content-Length atteint) : read()
+ *    prend le relais (EOF, octets en trop ignorés).
+ */
+bool WebServer::spliceCgiOutput(CgiJob *job)
+{
+	int fd = job->process.outputFd();
+	int avail = 0;
+	if (ioctl(fd, FIONREAD, &avail) < 0 || avail <= 0)
+		return false;
+
+	std::size_t n = std::min(static_cast<std::size_t>(avail), CGI_STREAM_HIGH_WATER);
+	if (job->lengthKnown)
+	{
+		n = std::min(n, job->bodyLeft);
+		if (n == 0)
+			return false;
+		job->bodyLeft -= n;
+	}
+
+	ResponseSlot &rs = *job->slot;
+	if (job->chunked)
+	{
+		std::ostringstream size;
+		size << std::hex << n << "\r\n";
+		std::string head = size.str();
+		rs.out.append(head);
+	}
+	rs.out.appendPipe(fd, n);
+	if (job->chunked)
+	{
+		std::string crlf = "\r\n";
+		rs.out.append(crlf);
+	}
+
+	job->deadline = _now + static_cast<unsigned long>(CGI_TIMEOUT_SECONDS) * 1000UL;
+	pauseCgi(job);
+
+	FdSlot *cs = _fds.get(job->clientFd);
+	updateClientEvents(job->clientFd, cs->state);
+	return true;
+}
+
+// Trop d'octets en attente côté client : on ne lit plus la sortie.
+void WebServer::pauseCgi(CgiJob *job)
+{
+	job->paused = true;
+
+	if (job->proxied)
+	{
+		ProxyConnection *conn = job->proxy.connection();
+		conn->pause();
+		updateProxyEvents(conn);
+		_timers.cancel(conn->timer); // le client décide maintenant
+		return;
+	}
+
+	if (job->remote)
+	{
+		// Flux multiplexé : toute la connexion s'arrête
+		FastCgiConnection *conn = job->fastcgi.connection();
+		conn->pause();
+		updateFastCgiEvents(conn);
+		return;
+	}
+
+	_poller.modify(job->process.outputFd(), 0);
+	_timers.cancel(job->timer); // le client décide maintenant
+}
+
+// Le client a vidé la réponse : on relit le pipe (ou la connexion).
+void WebServer::resumeCgi(CgiJob *job)
+{
+	job->paused = false;
+	job->deadline = _now + static_cast<unsigned long>(CGI_TIMEOUT_SECONDS) * 1000UL;
+
+	if (job->proxied)
+	{
+		ProxyConnection *conn = job->proxy.connection();
+		_timers.schedule(conn->timer, job->deadline);
+		conn->resume();
+		updateProxyEvents(conn);
+		if (!conn->dispatching)
+			readProxy(conn); // (peut terminer le job)
+		return;
+	}
+
+	if (job->remote)
+	{
+		FastCgiConnection *conn = job->fastcgi.connection();
+		armFastCgiTimer(conn, job->deadline);
+		conn->resume();
+		updateFastCgiEvents(conn);
+		// (peut terminer ce job et d'autres de la même connexion)
+		if (!conn->paused() && !conn->dispatching)
+			readFastCgi(conn);
+		return;
+	}
+
+	_poller.modify(job->process.outputFd(), Poller::EV_READ);
+	_timers.schedule(job->timer, job->deadline);
+
+	pumpCgiOutput(job);
+	progressCgi(job);
+}
+
+/*
+ * progressCgi()
+ *
+ *  - la réponse est construite quand stdout est à EOF ET que le process
+ *    est réapé (son exit code décide entre réponse et 500).
+ *  - sans pidfd : waitpid(WNOHANG) réessayé par le timer, toutes les
+ *    CGI_REAP_RETRY_MS (le script a fermé stdout, il sort en général
+ *    aussitôt).
+ */
+void WebServer::progressCgi(CgiJob *job)
+{
+	if (!job->output().outputDone())
+		return;
+
+	CgiProcess &p = job->process;
+	if (!job->remote && !job->proxied && !p.reap())
+	{
+		if (p.exitFd() < 0)
+			_timers.schedule(job->timer,
+			                 std::min(_now + CGI_REAP_RETRY_MS, job->deadline));
+		return;
+	}
+
+	finishCgi(job, false);
+}
+
+/*
+ * finishCgi()
+ *
+ *  - construit la réponse (headers du script, Content-Type par défaut
+ *    sauf 204/304, compression), la met dans le slot réservé et détruit le job.
+ *  - timeout : 504 (le script a été tué). Échec : 500, ou 502 pour
+ *    une application FastCGI ou un backend proxy_pass (connexion
+ *    perdue, refus, réponse invalide) ; un worker cgi_pool reste un CGI
+ *    local (500).
+ *  - réponse déjà streamée : voir endCgiStream().
+ *  - upstream : l'issue est rapportée au serveur choisi (un échec ou
+ *    un timeout peut l'écarter).
+ */
+void WebServer::finishCgi(CgiJob *job, bool timedOut)
+{
+	bool ok = !timedOut && job->output().succeeded();
+	if (job->upstream)
+		job->upstream->report(job->peer, ok, _now);
+
+	if (job->streaming)
+	{
+		endCgiStream(job, ok);
+		return;
+	}
+
+	HttpResponse response;
+	int status;
+	std::string reason;
+	CgiOutput::HeaderMap headers;
+	std::string body;
+
+	if (timedOut)
+		setErrorResponse(*job->server, response, 504, "Gateway Timeout");
+	else if (!ok || !job->output().parseOutput(status, reason, headers, body))
+	{
+		if ((job->remote && !job->pool) || job->proxied)
+			setErrorResponse(*job->server, response, 502, "Bad Gateway");
+		else
+			setErrorResponse(*job->server, response, 500, "Internal Server Error");
+	}
+	else
+	{
+		response.setStatus(status, reason);
+		for (CgiOutput::HeaderMap::const_iterator it = headers.begin();
+		     it != headers.end(); ++it)
+			response.setHeader(it->first, it->second);
+
+		// 204 et 304 : pas de body, donc pas de Content-Type par défaut
+		bool bodyless = status == 204 || status == 304;
+		if (bodyless)
+			body.clear();
+		else if (response.getHeader("Content-Type").empty())
+			response.setHeader("Content-Type", "text/html");
+
+		response.swapBody(body);
+		compressBody(job->acceptEncoding, job->loc, response);
+	}
+
+	respondCgi(job, response);
+}
+
+// Réponse complète du job dans son slot ; le job est détruit.
+void WebServer::respondCgi(CgiJob *job, HttpResponse &response)
+{
+	int fd = job->clientFd;
+	FdSlot *slot = _fds.get(fd);
+	ClientState &state = slot->state; // le client vit : removeClient() tue ses CGI
+
+	ResponseSlot &rs = *job->slot;
+	rs.cgi = NULL;
+	fillResponseSlot(rs, response);
+	destroyCgi(job);
+
+	state.lastActivity = _now;
+	updateClientEvents(fd, state);
+}
+
+/*
+ * endCgiStream()
+ *
+ *  - fin du body streamé : fin du flux compressé, chunk final.
+ *  - échec (exit code != 0, timeout, body plus court que son
+ *    Content-Length) alors que les headers sont partis : pas de chunk
+ *    final et la connexion est fermée après l'envoi, le client voit une
+ *    réponse incomplète.
+ */
+void WebServer::endCgiStream(CgiJob *job, bool ok)
+{
+	int fd = job->clientFd;
+	FdSlot *slot = _fds.get(fd);
+	ClientState &state = slot->state;
+	ResponseSlot &rs = *job->slot;
+
+	if (ok && job->compressor)
+	{
+		std::string tail;
+		ok = job->compressor->finish(tail);
+		if (ok)
+			appendBodyChunk(rs.out, tail, job->chunked);
+	}
+	if (job->lengthKnown && job->bodyLeft > 0)
+		ok = false;
+
+	if (ok && job->chunked)
+	{
+		std::string last = "0\r\n\r\n";
+		rs.out.append(last);
+	}
+	if (!ok)
+	{
+		rs.closeAfter = true;
+		state.closing = true;
+	}
+
+	rs.cgi = NULL;
+	destroyCgi(job);
+	updateClientEvents(fd, state);
+}
+
+/*
+ * destroyCgi()
+ *
+ *  - retire les fds du job de la boucle ; le destructeur de CgiProcess
+ *    tue et réape le script s'il tourne encore, puis ferme les fds.
+ *  - FastCGI : une requête pas encore terminée est abandonnée
+ *    (FCGI_ABORT_REQUEST) ; la connexion reste dans le pool.
+ *  - proxy_pass : une réponse pas encore terminée rend la connexion
+ *    inutilisable, elle est fermée (releaseProxy()).
+ *  - cgi_pool : un job encore en file en sort ; un worker abandonné en
+ *    plein script est recyclé (releaseFastCgi()).
+ *  - admission : un job en attente quitte la file du limiter ; un job
+ *    admis rend sa place, et la requête suivante de la file part.
+ *  - upstream : le serveur choisi n'a plus cette requête en cours.
+ */
+void WebServer::destroyCgi(CgiJob *job)
+{
+	if (job->upstream)
+		job->upstream->release(job->peer);
+
+	CgiLimiter *limiter = job->limiter;
+	WebServer *owner = NULL; // boucle du job admis à la place rendue
+	if (limiter && job->waiting)
+	{
+		owner = limiter->remove(job);
+		armCgiQueueTimer();
+	}
+	else if (limiter)
+		owner = limiter->finished();
+
+	if (job->proxied)
+	{
+		// Réponse pas terminée : la connexion est cassée (détachée)
+		ProxyConnection *conn = job->proxy.connection();
+		delete job;
+		if (conn)
+			releaseProxy(conn);
+	}
+	else if (job->remote)
+	{
+		FastCgiConnection *conn = job->fastcgi.connection();
+		if (conn && job->paused)
+			conn->resume();
+		if (!conn && job->pool)
+			job->pool->remove(job);
+		delete job;
+		if (conn)
+			releaseFastCgi(conn);
+	}
+	else
+	{
+		CgiProcess &p = job->process;
+
+		unwatchCgiFd(p.inputFd());
+		unwatchCgiFd(p.outputFd());
+		unwatchCgiFd(p.exitFd());
+		_timers.cancel(job->timer);
+
+		delete job;
+	}
+
+	if (owner)
+		releaseCgiSlot(owner, limiter);
+}
+
+// Connexion fermée : ses CGI en cours sont abandonnés. Ceux qui
+// attendent une place d'abord : une place rendue ne doit pas lancer un
+// autre script de cette connexion.
+void WebServer::abortClientCgi(ClientState &state)
+{
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (std::size_t i = 0; i < state.responses.size(); ++i)
+		{
+			CgiJob *job = state.responses[i].cgi;
+			if (job && (pass == 1 || job->waiting))
+			{
+				destroyCgi(job);
+				state.responses[i].cgi = NULL;
+			}
+		}
+	}
+}
+
+/*
+ * startFastCgi()
+ *
+ *  - fastcgi_pass : la requête part sur une connexion du pool (la moins
+ *    chargée, sinon une nouvelle), avec le même environnement qu'un CGI
+ *    local. Rien n'est écrit ici : les records partent sur EV_WRITE.
+ *  - upstream : l'application est choisie dans le bloc ; une qui refuse
+ *    la connexion (d'emblée, ou plus tard : retryFastCgi()) compte un
+ *    échec et la suivante est essayée.
+ *  - NULL si aucune connexion ne peut être ouverte (502).
+ */
+CgiJob *WebServer::startFastCgi(const HttpRequest &request,
+                                const ServerConfig &server,
+                                const LocationConfig *loc,
+                                const std::string &scriptPath,
+                                unsigned int clientIp)
+{
+	Upstream *upstream = upstreamFor(*loc);
+	std::size_t peer = 0;
+	std::vector<bool> tried;
+	FastCgiConnection *conn = NULL;
+
+	if (!upstream)
+		conn = connectFastCgi(loc->fastcgiPass);
+	for (std::size_t i = 0; upstream && !conn && i < upstream->size(); ++i)
+	{
+		peer = upstream->select(request.getTarget(), clientIp, _now, tried);
+		conn = connectFastCgi(upstream->address(peer));
+		if (!conn)
+		{
+			upstream->report(peer, false, _now);
+			upstream->release(peer);
+		}
+	}
+	if (!conn)
+		return NULL;
+
+	std::string body = prepareCgiBody(request);
+	std::vector<std::string> env = buildCgiEnv(request, server, scriptPath,
+	                                           body.size());
+	if (request.getMethod() != "POST")
+		body.clear();
+
+	CgiJob *job = new CgiJob();
+	job->remote = true;
+	job->fastcgi.job = job;
+	job->upstream = upstream;
+	job->peer = peer;
+	job->tried = tried;
+	job->uri = request.getTarget();
+	job->clientIp = clientIp;
+	job->server = &server;
+	job->loc = loc;
+	job->deadline = _now + static_cast<unsigned long>(CGI_TIMEOUT_SECONDS) * 1000UL;
+
+	conn->submit(job->fastcgi, scriptPath, env, body);
+	if (upstream)
+	{
+		// Gardés pour un nouvel essai sur l'application suivante
+		job->scriptPath = scriptPath;
+		job->env.swap(env);
+		job->input.swap(body);
+	}
+	updateFastCgiEvents(conn);
+	armFastCgiTimer(conn, job->deadline);
+	return job;
+}
+
+// Connexion du pool vers address (la moins chargée, sinon une nouvelle,
+// enregistrée dans la boucle) ; NULL si elle ne peut pas être ouverte.
+FastCgiConnection *WebServer::connectFastCgi(const std::string &address)
+{
+	FastCgiConnection *conn = _fastcgi.find(address);
+	if (conn)
+		return conn;
+
+	conn = _fastcgi.open(address);
+	if (!conn)
+		return NULL;
+
+	FdSlot &slot = _fds.acquire(conn->fd(), FdSlot::FD_FASTCGI);
+	slot.fastcgi = conn;
+	_poller.add(conn->fd(), Poller::EV_READ | Poller::EV_WRITE);
+	return conn;
+}
+
+/*
+ * handleFastCgiEvent()
+ *
+ *  - lecture d'abord : une application qui ferme la connexion après
+ *    sa réponse a pu envoyer ses derniers records avant le FIN.
+ *  - écriture : fin du connect(), puis records en attente.
+ */
+void WebServer::handleFastCgiEvent(int fd, unsigned events)
+{
+	FastCgiConnection *conn = _fds.get(fd)->fastcgi;
+
+	if ((events & (Poller::EV_READ | Poller::EV_ERROR)) && !readFastCgi(conn))
+		return;
+
+	if ((events & (Poller::EV_WRITE | Poller::EV_ERROR)) && !conn->flush())
+	{
+		closeFastCgi(conn);
+		return;
+	}
+
+	updateFastCgiEvents(conn);
+}
+
+/*
+ * readFastCgi()
+ *
+ *  - lit la connexion par blocs de CGI_BUFFER_SIZE jusqu'à EAGAIN (ou
+ *    la pause) ; chaque requête qui a reçu des données avance comme un
+ *    CGI local : headers, body streamé, fin.
+ *  - false si la connexion a été fermée (perdue, ou en trop au repos).
+ */
+bool WebServer::readFastCgi(FastCgiConnection *conn)
+{
+	std::vector<FastCgiRequest *> touched;
+	FastCgiConnection::ReadResult r = FastCgiConnection::READ_MORE;
+
+	conn->dispatching = true;
+	while (r == FastCgiConnection::READ_MORE && !conn->paused())
+	{
+		touched.clear();
+		r = conn->readRecords(CGI_BUFFER_SIZE, touched);
+
+		for (std::size_t i = 0; i < touched.size(); ++i)
+		{
+			CgiJob *job = touched[i]->job;
+			job->deadline = _now + static_cast<unsigned long>(CGI_TIMEOUT_SECONDS) * 1000UL;
+			deliverCgiOutput(job);
+			progressCgi(job); // peut détruire le job
+		}
+	}
+	conn->dispatching = false;
+
+	if (r == FastCgiConnection::READ_EOF)
+	{
+		closeFastCgi(conn);
+		return false;
+	}
+	return releaseFastCgi(conn);
+}
+
+/*
+ * expireFastCgi()
+ *
+ *  - timer de la connexion : les jobs dont la deadline est passée
+ *    (inactivité de l'application) reçoivent leur 504 et sont
+ *    abandonnés ; le timer est réarmé sur la prochaine deadline.
+ *  - un job en pause attend son client : pas de deadline.
+ */
+void WebServer::expireFastCgi(FastCgiConnection *conn)
+{
+	std::vector<FastCgiRequest *> requests;
+	std::vector<CgiJob *> expired;
+	unsigned long next = 0;
+
+	conn->activeRequests(requests);
+	for (std::size_t i = 0; i < requests.size(); ++i)
+	{
+		CgiJob *job = requests[i]->job;
+		if (job->paused)
+			continue;
+		if (_now >= job->deadline)
+			expired.push_back(job);
+		else if (next == 0 || job->deadline < next)
+			next = job->deadline;
+	}
+	if (next != 0)
+		_timers.schedule(conn->timer, next);
+
+	conn->dispatching = true;
+	for (std::size_t i = 0; i < expired.size(); ++i)
+	{
+		std::cerr << (expired[i]->pool ? "CGI" : "FastCGI")
+		          << " timeout (" << CGI_TIMEOUT_SECONDS
+		          << "s) for script: " << expired[i]->output().scriptPath()
+		          << std::endl;
+		finishCgi(expired[i], true);
+	}
+	conn->dispatching = false;
+
+	if (!expired.empty())
+		releaseFastCgi(conn);
+}
+
+// Les deadlines ne font que reculer : le timer peut sonner en avance,
+// expireFastCgi() le réarme alors.
+void WebServer::armFastCgiTimer(FastCgiConnection *conn, unsigned long deadline)
+{
+	if (!conn->timer.armed || deadline < conn->timer.expires)
+		_timers.schedule(conn->timer, deadline);
+}
+
+void WebServer::updateFastCgiEvents(FastCgiConnection *conn)
+{
+	unsigned events = 0;
+	if (!conn->paused())
+		events |= Poller::EV_READ;
+	if (conn->wantsWrite())
+		events |= Poller::EV_WRITE;
+	_poller.modify(conn->fd(), events);
+}
+
+/*
+ * releaseFastCgi()
+ *
+ *  - après la fin (ou l'abandon) d'une requête : la connexion reste au
+ *    pool, sauf si elle est cassée, si elle ne porte plus que des
+ *    requêtes abandonnées, ou s'il y a déjà FASTCGI_MAX_IDLE connexions
+ *    au repos vers la même application.
+ *  - worker cgi_pool : recyclé après cgi_pool_max_requests, ou abandonné
+ *    en plein script ; libre, il prend la requête suivante de la file.
+ *  - false si elle a été fermée.
+ */
+bool WebServer::releaseFastCgi(FastCgiConnection *conn)
+{
+	if (conn->dispatching)
+		return true; // readFastCgi() / expireFastCgi() rappellent ensuite
+
+	CgiPool *pool = _fds.get(conn->fd())->cgiPool;
+	if (conn->broken() ||
+	    (conn->active() == 0 && !conn->idle()) ||
+	    (pool && conn->idle() && pool->exhausted(conn)) ||
+	    (!pool && conn->idle() &&
+	     _fastcgi.idle(conn->address()) > FASTCGI_MAX_IDLE))
+	{
+		closeFastCgi(conn);
+		return false;
+	}
+
+	updateFastCgiEvents(conn); // ABORT_REQUEST éventuel à envoyer
+	if (pool && conn->idle())
+		dispatchCgiPool(pool);
+	return true;
+}
+
+/*
+ * closeFastCgi()
+ *
+ *  - les requêtes encore en cours échouent (502, ou réponse streamée
+ *    tronquée), puis la connexion quitte la boucle et le pool.
+ */
+void WebServer::closeFastCgi(FastCgiConnection *conn)
+{
+	std::vector<FastCgiRequest *> touched;
+	conn->activeRequests(touched);
+	for (std::size_t i = 0; i < touched.size(); ++i)
+		retryFastCgi(conn, touched[i]->job);
+
+	touched.clear();
+	conn->fail(touched);
+
+	conn->dispatching = true;
+	for (std::size_t i = 0; i < touched.size(); ++i)
+	{
+		CgiJob *job = touched[i]->job;
+		deliverCgiOutput(job);
+		progressCgi(job);
+	}
+	conn->dispatching = false;
+
+	int fd = conn->fd();
+	CgiPool *pool = _fds.get(fd)->cgiPool;
+	_timers.cancel(conn->timer);
+	_poller.remove(fd);
+	_fds.release(fd);
+
+	if (!pool)
+	{
+		_fastcgi.close(conn);
+		return;
+	}
+
+	// Worker cgi_pool : remplacé tout de suite s'il a servi (sinon à la
+	// demande : un runner cassé ne tourne pas en boucle de fork)
+	if (pool->retire(conn) && !stopRequested())
+		spawnCgiWorker(pool);
+	dispatchCgiPool(pool);
+}
+
+/*
+ * retryFastCgi()
+ *
+ *  - upstream : l'application du job a perdu la connexion avant le
+ *    moindre octet de réponse ; l'échec lui est rapporté et la requête
+ *    repart sur la suivante du bloc (chacune essayée au plus une fois),
+ *    puis 502 quand toutes ont échoué.
+ *  - seulement si rien n'a pu être exécuté deux fois : connect() jamais
+ *    abouti, ou requête sans body.
+ *  - true si la requête est partie sur une autre connexion (retirée de
+ *    celle-ci).
+ */
+bool WebServer::retryFastCgi(FastCgiConnection *conn, CgiJob *job)
+{
+	if (!job->upstream || job->streaming || job->output().buffered() > 0 ||
+	    (!conn->connecting() && !job->input.empty()))
+		return false;
+
+	FastCgiConnection *next = NULL;
+	while (!next && nextPeer(job))
+		next = connectFastCgi(job->upstream->address(job->peer));
+	if (!next)
+		return false;
+
+	conn->withdraw(job->fastcgi);
+	next->submit(job->fastcgi, job->scriptPath, job->env, job->input);
+	updateFastCgiEvents(next);
+	armFastCgiTimer(next, job->deadline);
+	return true;
+}
+
+/*
+ * startProxy()
+ *
+ *  - proxy_pass : la requête part sur une connexion keep-alive libre du
+ *    pool, sinon une nouvelle. Cible : l'URI du client, ou le préfixe de
+ *    la location remplacé par l'URI de proxy_pass. Rien n'est écrit
+ *    ici : la requête part sur EV_WRITE.
+ *  - body : celui de la requête, déjà lu en entier (borné par
+ *    client_max_body_size) et déchunké ; il part au rythme où le
+ *    backend le lit.
+ *  - upstream : le backend est choisi dans le bloc ; un qui refuse la
+ *    connexion (d'emblée, ou plus tard : retryProxy()) compte un échec
+ *    et le suivant est essayé.
+ *  - NULL si aucune connexion ne peut être ouverte (502).
+ */
+CgiJob *WebServer::startProxy(const HttpRequest &request,
+                              const ServerConfig &server,
+                              const LocationConfig *loc,
+                              unsigned int clientIp)
+{
+	Upstream *upstream = upstreamFor(*loc);
+	std::size_t peer = 0;
+	std::vector<bool> tried;
+	ProxyConnection *conn = NULL;
+
+	if (!upstream)
+		conn = connectProxy(loc->proxyPass);
+	for (std::size_t i = 0; upstream && !conn && i < upstream->size(); ++i)
+	{
+		peer = upstream->select(request.getTarget(), clientIp, _now, tried);
+		conn = connectProxy(upstream->address(peer));
+		if (!conn)
+		{
+			upstream->report(peer, false, _now);
+			upstream->release(peer);
+		}
+	}
+	if (!conn)
+		return NULL;
+
+	std::string target = request.getTarget();
+	if (!loc->proxyUri.empty())
+	{
+		// (le chemin de la location est gardé sans '/' final)
+		std::string rest = target.substr(loc->path.size());
+		const std::string &uri = loc->proxyUri;
+		if (!rest.empty() && rest[0] == '/' && uri[uri.size() - 1] == '/')
+			rest.erase(0, 1);
+		target = uri + rest;
+	}
+
+	CgiJob *job = new CgiJob();
+	job->proxied = true;
+	job->proxy.job = job;
+	job->upstream = upstream;
+	job->peer = peer;
+	job->tried = tried;
+	job->uri = request.getTarget();
+	job->clientIp = clientIp;
+	job->server = &server;
+	job->loc = loc;
+	job->deadline = _now + static_cast<unsigned long>(CGI_TIMEOUT_SECONDS) * 1000UL;
+
+	conn->submit(job->proxy, request.getMethod(), target,
+	             request.getHeaders(), prepareCgiBody(request));
+	updateProxyEvents(conn);
+	_timers.schedule(conn->timer, job->deadline);
+	return job;
+}
+
+// Connexion keep-alive libre vers address, sinon une nouvelle
+// (enregistrée dans la boucle) ; NULL si elle ne peut pas être ouverte.
+ProxyConnection *WebServer::connectProxy(const std::string &address)
+{
+	ProxyConnection *conn = _proxies.find(address);
+	if (conn)
+		return conn;
+	return openProxy(address);
+}
+
+// Nouvelle connexion vers address, enregistrée dans la boucle.
+ProxyConnection *WebServer::openProxy(const std::string &address)
+{
+	ProxyConnection *conn = _proxies.open(address);
+	if (!conn)
+		return NULL;
+
+	FdSlot &slot = _fds.acquire(conn->fd(), FdSlot::FD_PROXY);
+	slot.proxy = conn;
+	_poller.add(conn->fd(), Poller::EV_READ | Poller::EV_WRITE);
+	return conn;
+}
+
+/*
+ * handleProxyEvent()
+ *
+ *  - lecture d'abord : un backend qui ferme après sa réponse a pu
+ *    l'envoyer avant le FIN ; au repos, EV_READ signale surtout une
+ *    connexion fermée par le backend.
+ *  - écriture : fin du connect(), puis la requête.
+ */
+void WebServer::handleProxyEvent(int fd, unsigned events)
+{
+	ProxyConnection *conn = _fds.get(fd)->proxy;
+
+	if ((events & (Poller::EV_READ | Poller::EV_ERROR)) && !readProxy(conn))
+		return;
+
+	if ((events & (Poller::EV_WRITE | Poller::EV_ERROR)) && !conn->flush())
+	{
+		closeProxy(conn);
+		return;
+	}
+
+	updateProxyEvents(conn);
+}
+
+/*
+ * readProxy()
+ *
+ *  - lit la réponse par blocs de CGI_BUFFER_SIZE jusqu'à EAGAIN, sa fin
+ *    ou la pause ; le job avance comme un CGI : headers, body streamé,
+ *    fin.
+ *  - false si la connexion a été fermée.
+ */
+bool WebServer::readProxy(ProxyConnection *conn)
+{
+	ProxyConnection::ReadResult r = ProxyConnection::READ_MORE;
+
+	conn->dispatching = true;
+	while (r == ProxyConnection::READ_MORE && !conn->paused())
+	{
+		ProxyRequest *touched;
+		r = conn->readResponse(CGI_BUFFER_SIZE, touched);
+		if (!touched)
+			continue;
+
+		CgiJob *job = touched->job;
+		job->deadline = _now + static_cast<unsigned long>(CGI_TIMEOUT_SECONDS) * 1000UL;
+		deliverCgiOutput(job);
+		progressCgi(job); // peut détruire le job
+	}
+	conn->dispatching = false;
+
+	if (r == ProxyConnection::READ_EOF)
+	{
+		closeProxy(conn);
+		return false;
+	}
+	return releaseProxy(conn);
+}
+
+/*
+ * expireProxy()
+ *
+ *  - requête en cours : 504 (ou réponse streamée tronquée) si le
+ *    backend n'a rien envoyé depuis CGI_TIMEOUT_SECONDS ; un job en
+ *    pause attend son client, son timer est coupé.
+ *  - connexion au repos depuis PROXY_IDLE_TIMEOUT_SECONDS : fermée.
+ */
+void WebServer::expireProxy(ProxyConnection *conn)
+{
+	ProxyRequest *req = conn->current();
+	if (!req)
+	{
+		closeProxy(conn);
+		return;
+	}
+
+	CgiJob *job = req->job;
+	if (job->paused)
+		return;
+	if (_now < job->deadline)
+	{
+		_timers.schedule(conn->timer, job->deadline);
+		return;
+	}
+
+	std::cerr << "Proxy timeout (" << CGI_TIMEOUT_SECONDS << "s) for "
+	          << req->scriptPath() << std::endl;
+	conn->dispatching = true;
+	finishCgi(job, true);
+	conn->dispatching = false;
+	releaseProxy(conn);
+}
+
+void WebServer::updateProxyEvents(ProxyConnection *conn)
+{
+	unsigned events = 0;
+	if (!conn->paused())
+		events |= Poller::EV_READ;
+	if (conn->wantsWrite())
+		events |= Poller::EV_WRITE;
+	_poller.modify(conn->fd(), events);
+}
+
+/*
+ * releaseProxy()
+ *
+ *  - après une lecture, ou la fin (ou l'abandon) de la requête : une
+ *    connexion au repos reste au pool si le backend la garde ouverte et
+ *    qu'il n'y en a pas déjà PROXY_MAX_IDLE au repos vers lui ; une
+ *    connexion cassée (réponse abandonnée, invalide) est fermée.
+ *  - false si elle a été fermée.
+ */
+bool WebServer::releaseProxy(ProxyConnection *conn)
+{
+	if (conn->dispatching)
+		return true; // readProxy() / expireProxy() rappellent ensuite
+
+	if (conn->broken() ||
+	    (conn->idle() && (!conn->reusable() ||
+	                      _proxies.idle(conn->address()) > PROXY_MAX_IDLE)))
+	{
+		closeProxy(conn);
+		return false;
+	}
+
+	updateProxyEvents(conn);
+	if (conn->idle())
+		_timers.schedule(conn->timer, _now +
+		    static_cast<unsigned long>(PROXY_IDLE_TIMEOUT_SECONDS) * 1000UL);
+	return true;
+}
+
+/*
+ * closeProxy()
+ *
+ *  - la requête encore en cours échoue (502, ou réponse streamée
+ *    tronquée), sauf si elle peut repartir (retryProxy()), puis la
+ *    connexion quitte la boucle et le pool.
+ */
+void WebServer::closeProxy(ProxyConnection *conn)
+{
+	ProxyRequest *req = retryProxy(conn) ? NULL : conn->fail();
+	if (req)
+	{
+		CgiJob *job = req->job;
+		conn->dispatching = true;
+		deliverCgiOutput(job);
+		progressCgi(job);
+		conn->dispatching = false;
+	}
+
+	int fd = conn->fd();
+	_timers.cancel(conn->timer);
+	_poller.remove(fd);
+	_fds.release(fd);
+	_proxies.close(conn);
+}
+
+/*
+ * retryProxy()
+ *
+ *  - connexion keep-alive reprise au pool, fermée par le backend avant
+ *    le moindre octet de réponse (course avec son propre timeout de
+ *    keep-alive) : la requête n'a pas été traitée, elle repart une fois
+ *    sur une connexion neuve vers la même adresse, sans compter d'échec
+ *    pour l'upstream. Méthode idempotente ou requête sans body
+ *    seulement.
+ *  - upstream : sinon, un backend qui a perdu la connexion avant le
+ *    moindre octet de réponse compte un échec et la requête repart sur
+ *    le suivant du bloc (chacun essayé au plus une fois), puis 502
+ *    quand tous ont échoué. Rejouable, ou connect() jamais abouti.
+ *  - true si la requête est partie sur une autre connexion (retirée
+ *    de celle-ci).
+ */
+bool WebServer::retryProxy(ProxyConnection *conn)
+{
+	ProxyRequest *req = conn->current();
+	if (!req || !conn->untouched())
+		return false;
+
+	CgiJob *job = req->job;
+	ProxyConnection *next = NULL;
+	if (conn->reused() && req->replayable())
+		next = openProxy(conn->address());
+	if (job->upstream && (conn->connecting() || req->replayable()))
+	{
+		while (!next && nextPeer(job))
+			next = connectProxy(job->upstream->address(job->peer));
+	}
+	if (!next)
+		return false;
+
+	conn->withdraw();
+	next->resubmit(*req);
+	updateProxyEvents(next);
+	_timers.schedule(next->timer, job->deadline);
+	return true;
+}
+
+/*
+ * upstreamFor()
+ *
+ *  - bloc upstream de la location (proxy_pass / fastcgi_pass), partagé
+ *    par tout le process ; NULL pour une adresse fixe.
+ */
+Upstream *WebServer::upstreamFor(const LocationConfig &loc)
+{
+	if (loc.upstream.empty())
+		return NULL;
+
+	std::map<std::string, Upstream *>::iterator it = _upstreams->find(loc.upstream);
+	return (it != _upstreams->end()) ? it->second : NULL;
+}
+
+// Le serveur du job a échoué : l'échec lui est rapporté et le suivant
+// est choisi parmi ceux pas encore essayés ; false quand tous ont été essayés (le job garde le
+// dernier, finishCgi() rapporte son échec).
+bool WebServer::nextPeer(CgiJob *job)
+{
+	Upstream *upstream = job->upstream;
+	if (std::find(job->tried.begin(), job->tried.end(), false) == job->tried.end())
+		return false;
+
+	upstream->report(job->peer, false, _now);
+	upstream->release(job->peer);
+	job->peer = upstream->select(job->uri, job->clientIp, _now, job->tried);
+	return true;
+}
+
+/*
+ * cgiPoolFor()
+ *
+ *  - pool de la location, créé (et rempli : cgi_pool workers lancés
+ *    d'avance) au premier appel. Un pool par boucle d'événements.
+ */
+CgiPool *WebServer::cgiPoolFor(const LocationConfig &loc)
+{
+	std::map<const LocationConfig *, CgiPool *>::iterator it = _cgiPools.find(&loc);
+	if (it != _cgiPools.end())
+		return it->second;
+
+	CgiPool *pool = new CgiPool(loc.cgiPath, loc.cgiPoolRunner,
+	                            loc.cgiPoolSize, loc.cgiPoolMaxRequests);
+	_cgiPools[&loc] = pool;
+
+	std::size_t started = 0;
+	while (spawnCgiWorker(pool))
+		++started;
+	std::cout << "CGI pool for location " << loc.path << ": "
+	          << started << " worker(s)" << std::endl;
+	return pool;
+}
+
+// Boucle qui sert des requêtes : les pools sont prêts avant la première.
+void WebServer::startCgiPools()
+{
+	for (std::size_t i = 0; i < _servers.size(); ++i)
+	{
+		for (std::size_t j = 0; j < _servers[i].locations.size(); ++j)
+		{
+			if (_servers[i].locations[j].cgiPoolSize > 0)
+				cgiPoolFor(_servers[i].locations[j]);
+		}
+	}
+}
+
+/*
+ * startPooledCgi()
+ *
+ *  - cgi_pool : même environnement qu'un CGI local, mais le script est
+ *    exécuté par un worker du pool. Le job passe par la file du pool
+ *    (FIFO) : il part tout de suite si un worker est libre (ou peut être
+ *    lancé), sinon quand un worker se libère.
+ */
+void WebServer::startPooledCgi(CgiJob *job)
+{
+	CgiPool *pool = cgiPoolFor(*job->loc);
+
+	job->remote = true;
+	job->pool = pool;
+	job->fastcgi.job = job;
+
+	pool->enqueue(job);
+	dispatchCgiPool(pool);
+}
+
+FastCgiConnection *WebServer::spawnCgiWorker(CgiPool *pool)
+{
+	FastCgiConnection *conn = pool->spawn();
+	if (!conn)
+		return NULL;
+
+	FdSlot &slot = _fds.acquire(conn->fd(), FdSlot::FD_FASTCGI);
+	slot.fastcgi = conn;
+	slot.cgiPool = pool;
+	_poller.add(conn->fd(), Poller::EV_READ);
+	return conn;
+}
+
+/*
+ * dispatchCgiPool()
+ *
+ *  - tant que des jobs attendent : worker libre, sinon nouveau worker si
+ *    le pool n'est pas plein. La deadline (CGI_TIMEOUT_SECONDS) part du
+ *    moment où le script commence.
+ */
+void WebServer::dispatchCgiPool(CgiPool *pool)
+{
+	if (stopRequested())
+		return; // destruction : les jobs restants sont abandonnés
+
+	while (pool->queued() > 0)
+	{
+		FastCgiConnection *conn = pool->acquire();
+		if (!conn)
+			conn = spawnCgiWorker(pool);
+		if (!conn)
+			return;
+
+		CgiJob *job = pool->dequeue();
+		pool->assign(conn);
+		job->deadline = _now + static_cast<unsigned long>(CGI_TIMEOUT_SECONDS) * 1000UL;
+		conn->submit(job->fastcgi, job->scriptPath, job->env, job->input);
+		std::vector<std::string>().swap(job->env);
+		std::string().swap(job->input);
+
+		updateFastCgiEvents(conn);
+		armFastCgiTimer(conn, job->deadline);
+	}
+}
+
+/*
+ * cgiLimiterFor()
+ *
+ *  - admission de la location, une pour tout le process (créée par
+ *    l'acceptor avant les reactors, partagée sous lock).
+ */
+CgiLimiter *WebServer::cgiLimiterFor(const LocationConfig &loc)
+{
+	return _cgiLimiters->find(&loc)->second;
+}
+
+/*
+ * rejectCgi()
+ *
+ *  - toutes les places de la location sont prises et sa file est pleine :
+ *    503 tout de suite, sans lancer ni garder la requête.
+ */
+bool WebServer::rejectCgi(const ServerConfig &server, const LocationConfig *loc,
+                          HttpResponse &response)
+{
+	if (!loc)
+		return false;
+
+	CgiLimiter *limiter = cgiLimiterFor(*loc);
+	if (!limiter->saturated())
+		return false;
+
+	limiter->reject();
+	setCgiBusyResponse(server, limiter, response);
+	return true;
+}
 
-		state.writeBuffer = response.toString();
-		state.requestHandled = true;
-		_pollFds[index].events |= POLLOUT;
+void WebServer::setCgiBusyResponse(const ServerConfig &server, CgiLimiter *limiter,
+                                   HttpResponse &response)
+{
+	setErrorResponse(server, response, 503, "Service Unavailable");
 
-		break;
-	}
+	std::ostringstream retry;
+	retry << limiter->retryAfter();
+	response.setHeader("Retry-After", retry.str());
 }
 
 /*
- * handleClientWrite()
+ * releaseCgiSlot()
+ *
+ *  - une place rendue a admis la tête de file : sa boucle lance le
+ *    script, tout de suite si c'est celle-ci, sinon à son réveil
+ *    (drainHandoffs()).
  */
-void WebServer::handleClientWrite(std::size_t index)
+void WebServer::releaseCgiSlot(WebServer *owner, CgiLimiter *limiter)
 {
-	if (index >= _pollFds.size())
-		return;
-
-	int fd = _pollFds[index].fd;
+	if (stopRequested())
+		return; // destruction : les autres reactors s'arrêtent aussi
 
-	std::map<int, ClientState>::iterator it = _clients.find(fd);
-	if (it == _clients.end())
+	if (owner == this)
+	{
+		admitQueuedCgi(limiter);
 		return;
+	}
 
-	ClientState &state = it->second;
+	__sync_lock_test_and_set(&owner->_cgiAdmitted, 1);
+	ssize_t n = write(owner->_wakeupPipe[1], "x", 1);
+	(void)n; // EAGAIN : le pipe contient déjà un réveil
+}
+
+/*
+ * admitQueuedCgi()
+ *
+ *  - les requêtes de cette boucle admises depuis la file partent (dans
+ *    l'ordre d'arrivée). Un lancement raté donne un 500 et rend sa place
+ *    aussitôt.
+ */
+void WebServer::admitQueuedCgi(CgiLimiter *limiter)
+{
+	if (stopRequested())
+		return; // destruction : les jobs restants sont abandonnés
 
-	if (state.writeBuffer.empty())
+	std::vector<CgiJob *> admitted;
+	limiter->takeAdmitted(this, admitted);
+	for (std::size_t i = 0; i < admitted.size(); ++i)
 	{
-		removeClient(index);
-		return;
+		CgiJob *job = admitted[i];
+		job->waiting = false;
+		if (!runCgi(job))
+		{
+			WebServer *owner = limiter->finished();
+			job->limiter = NULL;
+			finishCgi(job, false);
+			if (owner)
+				releaseCgiSlot(owner, limiter);
+		}
 	}
+	armCgiQueueTimer();
+}
 
-	int bytesSent = send(fd, state.writeBuffer.c_str(),
-	                     state.writeBuffer.size(), 0);
-
-	if (bytesSent < 0)
+// Timer sur la première échéance des jobs de cette boucle en file
+// (désarmé s'il n'y en a pas).
+void WebServer::armCgiQueueTimer()
+{
+	unsigned long deadline = 0;
+	for (std::map<const LocationConfig *, CgiLimiter *>::iterator it = _cgiLimiters->begin();
+	     it != _cgiLimiters->end(); ++it)
 	{
-		std::cerr << "Error: send() failed on fd " << fd
-		          << ": " << std::strerror(errno) << std::endl;
-		removeClient(index);
+		unsigned long next = it->second->nextDeadline(this);
+		if (next != 0 && (deadline == 0 || next < deadline))
+			deadline = next;
 	}
+
+	if (deadline == 0)
+		_timers.cancel(_cgiQueueTimer);
 	else
-	{
-		state.lastActivity = std::time(0); // activité d'écriture
-		state.writeBuffer.erase(0, bytesSent);
+		_timers.schedule(_cgiQueueTimer, deadline);
+}
 
-		if (state.writeBuffer.empty())
-			removeClient(index);
+/*
+ * expireCgiQueues()
+ *
+ *  - requêtes de cette boucle en file depuis plus de cgi_queue_timeout :
+ *    503 avec Retry-After, le script n'est jamais lancé.
+ */
+void WebServer::expireCgiQueues()
+{
+	for (std::map<const LocationConfig *, CgiLimiter *>::iterator it = _cgiLimiters->begin();
+	     it != _cgiLimiters->end(); ++it)
+	{
+		CgiLimiter *limiter = it->second;
+		CgiJob *job;
+		while ((job = limiter->expire(this, _now)) != NULL)
+		{
+			std::cerr << "CGI queue timeout (" << it->first->cgiQueueTimeout
+			          << "s) for script: " << job->scriptPath << std::endl;
+			job->waiting = false;
+			job->limiter = NULL;
+
+			HttpResponse response;
+			setCgiBusyResponse(*job->server, limiter, response);
+			respondCgi(job, response);
+		}
 	}
+	armCgiQueueTimer();
 }
 
 /*
- * removeClient()
+ * serveCgiStatus()
+ *
+ *  - cgi_status on : une ligne par location cgi, avec les compteurs du
+ *    process (tous les reactors ; worker_processes : ceux du process qui
+ *    répond) et les limites configurées.
  */
-void WebServer::removeClient(std::size_t index)
+void WebServer::serveCgiStatus(HttpResponse &response)
 {
-	if (index >= _pollFds.size())
-		return;
+	std::ostringstream body;
 
-	int fd = _pollFds[index].fd;
-
-	_clients.erase(fd);
-	close(fd);
+	for (std::size_t i = 0; i < _servers.size(); ++i)
+	{
+		const ServerConfig &server = _servers[i];
+		for (std::size_t j = 0; j < server.locations.size(); ++j)
+		{
+			const LocationConfig &loc = server.locations[j];
+			std::map<const LocationConfig *, CgiCounters *>::iterator it =
+			    _cgiCounters->find(&loc);
+			if (it == _cgiCounters->end())
+				continue;
 
-	// On remplace ce pollfd par le dernier pour ne pas avoir de "trou"
-	_pollFds[index] = _pollFds.back();
-	_pollFds.pop_back();
+			CgiCounters &c = *it->second;
+			body << server.host << ":" << server.port << " " << loc.path
+			     << " running=" << CgiCounters::get(c.running)
+			     << " queued=" << CgiCounters::get(c.queued)
+			     << " started=" << CgiCounters::get(c.started)
+			     << " rejected=" << CgiCounters::get(c.rejected)
+			     << " queue_timeouts=" << CgiCounters::get(c.timedOut)
+			     << " max_concurrency=" << loc.cgiMaxConcurrency
+			     << " queue_size=" << loc.cgiQueueSize << "\n";
+		}
+	}
 
-	std::cout << "Closed client fd " << fd << std::endl;
+	response.setStatus(200, "OK");
+	response.setHeader("Content-Type", "text/plain");
+	response.setHeader("Cache-Control", "no-cache");
+	response.setBody(body.str());
 }
 
 /*
@@ -1328,7 +4104,9 @@ const ServerConfig *WebServer::selectServerForRequest(const HttpRequest &request
  */
 void WebServer::buildHttpResponse(const ServerConfig &server,
                                   const HttpRequest &request,
-                                  HttpResponse &response)
+                                  unsigned int clientIp,
+                                  HttpResponse &response,
+                                  CgiJob *&cgi)
 {
 	const std::string &method = request.getMethod();
 	const std::string &target = request.getTarget();
@@ -1370,7 +4148,6 @@ void WebServer::buildHttpResponse(const ServerConfig &server,
 
 		response.setStatus(code, reason);
 		response.setHeader("Location", loc->redirectUrl);
-		response.setHeader("Connection", "close");
 		response.setHeader("Content-Type", "text/html");
 
 		std::ostringstream body;
@@ -1389,6 +4166,39 @@ void WebServer::buildHttpResponse(const ServerConfig &server,
 		return;
 	}
 
+	// cgi_status : compteurs d'admission des locations cgi
+	if (loc && loc->cgiStatus)
+	{
+		serveCgiStatus(response);
+		return;
+	}
+
+	// fastcgi_pass : toute la location est servie par l'application
+	// (SCRIPT_FILENAME = chemin sous root, qui n'a pas à exister ici)
+	if (loc && loc->fastcgiEnabled)
+	{
+		std::string path;
+		if (!resolvePathForCgi(server, loc, target, path))
+		{
+			setErrorResponse(server, response, 400, "Bad Request");
+			return;
+		}
+
+		cgi = startFastCgi(request, server, loc, path, clientIp);
+		if (!cgi)
+			setErrorResponse(server, response, 502, "Bad Gateway");
+		return;
+	}
+
+	// proxy_pass : toute la location est relayée au backend HTTP
+	if (loc && loc->proxyEnabled)
+	{
+		cgi = startProxy(request, server, loc, clientIp);
+		if (!cgi)
+			setErrorResponse(server, response, 502, "Bad Gateway");
+		return;
+	}
+
 	// ===================== GET =====================
 	if (method == "GET")
 	{
@@ -1419,9 +4229,14 @@ void WebServer::buildHttpResponse(const ServerConfig &server,
 				aiFlag = loc->autoindex;
 		}
 
+		// Métadonnées du chemin (stat en cache)
+		OpenFileCache::Entry *info = _fileCache->acquire(path, false, _now);
+		bool isDir = info->isDir;
+		bool isFile = info->isFile;
+		OpenFileCache::release(info);
+
 		// --- Cas dossier (on tente index, puis autoindex) ---
-		struct stat st;
-		if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+		if (isDir)
 		{
 			std::string dirPath = path;
 			if (dirPath.empty() || dirPath[dirPath.size() - 1] != '/')
@@ -1429,20 +4244,8 @@ void WebServer::buildHttpResponse(const ServerConfig &server,
 
 			std::string indexPath = dirPath + index;
 
-			std::ifstream indexFile(indexPath.c_str(),
-			                        std::ios::in | std::ios::binary);
-			if (indexFile)
-			{
-				std::ostringstream oss;
-				oss << indexFile.rdbuf();
-				std::string body = oss.str();
-
-				response.setStatus(200, "OK");
-				response.setHeader("Content-Type", getMimeType(indexPath));
-				response.setHeader("Connection", "close");
-				response.setBody(body);
+			if (serveStaticFile(request, loc, indexPath, response))
 				return;
-			}
 
 			if (!aiFlag)
 			{
@@ -1461,8 +4264,8 @@ void WebServer::buildHttpResponse(const ServerConfig &server,
 
 			response.setStatus(200, "OK");
 			response.setHeader("Content-Type", "text/html");
-			response.setHeader("Connection", "close");
-			response.setBody(body);
+			response.swapBody(body);
+			compressBody(request.getHeader("Accept-Encoding"), loc, response);
 			return;
 		}
 
@@ -1470,76 +4273,24 @@ void WebServer::buildHttpResponse(const ServerConfig &server,
 		if (loc && loc->cgiEnabled && hasExtension(path, loc->cgiExtension))
 		{
 			// On vérifie que le script existe
-			std::ifstream scriptTest(path.c_str(),
-			                         std::ios::in | std::ios::binary);
-			if (!scriptTest)
+			if (!isFile)
 			{
 				setErrorResponse(server, response, 404, "Not Found");
 				return;
 			}
-			scriptTest.close();
-
-			std::string cgiBody;
-			std::map<std::string, std::string> cgiHeaders;
-			int cgiStatus;
-			std::string cgiReason;
 
-			if (!executeCgi(request, server, loc, path,
-			                cgiBody, cgiHeaders, cgiStatus, cgiReason))
-			{
-				setErrorResponse(server, response, 500, "Internal Server Error");
+			// Trop de scripts en cours et file pleine : 503
+			if (rejectCgi(server, loc, response))
 				return;
-			}
-
-			response.setStatus(cgiStatus, cgiReason);
-
-			bool hasContentType = false;
-
-			for (std::map<std::string, std::string>::iterator it = cgiHeaders.begin();
-			     it != cgiHeaders.end();
-			     ++it)
-			{
-				const std::string &name  = it->first;
-				const std::string &value = it->second;
-
-				response.setHeader(name, value);
-
-				std::string lower;
-				for (std::size_t i = 0; i < name.size(); ++i)
-				{
-					char c = name[i];
-					if (c >= 'A' && c <= 'Z')
-						c = static_cast<char>(c - 'A' + 'a');
-					lower.push_back(c);
-				}
-				if (lower == "content-type")
-					hasContentType = true;
-			}
 
-			if (!hasContentType)
-				response.setHeader("Content-Type", "text/html");
-
-			response.setHeader("Connection", "close");
-			response.setBody(cgiBody);
+			// Réponse différée : construite quand le script aura fini
+			cgi = startCgi(request, server, loc, path, response);
 			return;
 		}
 
-		// --- Fichier statique ---
-		std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
-		if (!file)
-		{
+		// --- Fichier statique (ResponseCache, sinon sendfile) ---
+		if (!serveStaticFile(request, loc, path, response))
 			setErrorResponse(server, response, 404, "Not Found");
-			return;
-		}
-
-		std::ostringstream oss;
-		oss << file.rdbuf();
-		std::string body = oss.str();
-
-		response.setStatus(200, "OK");
-		response.setHeader("Content-Type", getMimeType(path));
-		response.setHeader("Connection", "close");
-		response.setBody(body);
 		return;
 	}
 
@@ -1560,57 +4311,19 @@ void WebServer::buildHttpResponse(const ServerConfig &server,
 			if (hasExtension(path, loc->cgiExtension))
 			{
 				// Vérifier que le script existe
-				std::ifstream scriptTest(path.c_str(),
-				                         std::ios::in | std::ios::binary);
-				if (!scriptTest)
+				OpenFileCache::Entry *script = _fileCache->acquire(path, false, _now);
+				bool scriptExists = script->isFile;
+				OpenFileCache::release(script);
+				if (!scriptExists)
 				{
 					setErrorResponse(server, response, 404, "Not Found");
 					return;
 				}
-				scriptTest.close();
-
-				std::string                         cgiBody;
-				std::map<std::string, std::string>  cgiHeaders;
-				int                                 cgiStatus;
-				std::string                         cgiReason;
 
-				if (!executeCgi(request, server, loc, path,
-				                cgiBody, cgiHeaders, cgiStatus, cgiReason))
-				{
-					setErrorResponse(server, response, 500, "Internal Server Error");
+				if (rejectCgi(server, loc, response))
 					return;
-				}
-
-				response.setStatus(cgiStatus, cgiReason);
-
-				bool hasContentType = false;
 
-				for (std::map<std::string, std::string>::iterator it = cgiHeaders.begin();
-				     it != cgiHeaders.end();
-				     ++it)
-				{
-					const std::string &name  = it->first;
-					const std::string &value = it->second;
-
-					response.setHeader(name, value);
-
-					std::string lower;
-					for (std::size_t i = 0; i < name.size(); ++i)
-					{
-						char c = name[i];
-						if (c >= 'A' && c <= 'Z')
-							c = static_cast<char>(c - 'A' + 'a');
-						lower.push_back(c);
-					}
-					if (lower == "content-type")
-						hasContentType = true;
-				}
-
-				if (!hasContentType)
-					response.setHeader("Content-Type", "text/html");
-
-				response.setHeader("Connection", "close");
-				response.setBody(cgiBody);
+				cgi = startCgi(request, server, loc, path, response);
 				return;
 			}
 		}
@@ -1673,10 +4386,10 @@ void WebServer::buildHttpResponse(const ServerConfig &server,
 
 			out << request.getBody();
 			out.close();
+			_fileCache->invalidate(path);
 
 			response.setStatus(201, "Created");
 			response.setHeader("Content-Type", "text/plain");
-			response.setHeader("Connection", "close");
 
 			std::ostringstream body;
 			body << "File uploaded as " << fileName << "\r\n";
@@ -1688,7 +4401,6 @@ void WebServer::buildHttpResponse(const ServerConfig &server,
 		// (qui ne sont ni un upload ni un CGI)
 		response.setStatus(200, "OK");
 		response.setHeader("Content-Type", "text/plain");
-		response.setHeader("Connection", "close");
 
 		std::ostringstream oss;
 		oss << "You sent a POST request to " << target << "\r\n";
@@ -1771,10 +4483,10 @@ void WebServer::buildHttpResponse(const ServerConfig &server,
 			setErrorResponse(server, response, 500, "Internal Server Error");
 			return;
 		}
+		_fileCache->invalidate(path);
 
 		response.setStatus(200, "OK");
 		response.setHeader("Content-Type", "text/plain");
-		response.setHeader("Connection", "close");
 		response.setBody("File deleted.\r\n");
 		return;
 	}
@@ -1800,17 +4512,376 @@ std::string WebServer::getMimeType(const std::string &path) const
 		return "text/css";
 	if (ext == "js")
 		return "application/javascript";
+	if (ext == "json")
+		return "application/json";
+	if (ext == "svg")
+		return "image/svg+xml";
+	if (ext == "png")
+		return "image/png";
+	if (ext == "jpg" || ext == "jpeg")
+		return "image/jpeg";
+	if (ext == "gif")
+		return "image/gif";
+	if (ext == "ico")
+		return "image/x-icon";
+	if (ext == "woff2")
+		return "font/woff2";
+	if (ext == "xml")
+		return "application/xml";
+	if (ext == "pdf")
+		return "application/pdf";
 
 	return "application/octet-stream";
 }
 
+/*
+ * openFileBody()
+ *
+ *  - met le fichier en body "fichier" de la réponse (envoyé plus tard
+ *    avec sendfile, sans lecture ici). Le fd vient de l'OpenFileCache
+ *    (ouvert une fois, partagé entre requêtes et threads).
+ *  - retourne false si ce n'est pas un fichier régulier lisible.
+ */
+bool WebServer::openFileBody(const std::string &path, HttpResponse &response)
+{
+	OpenFileCache::Entry *file = _fileCache->acquire(path, true, _now);
+
+	if (!file->isFile || file->fd < 0)
+	{
+		OpenFileCache::release(file);
+		return false;
+	}
+
+	response.setFileBody(file, 0, static_cast<std::size_t>(file->size));
+	return true;
+}
+
+/*
+ * serveStaticFile()
+ *
+ *  - réponse 200 pour un fichier régulier, avec ETag et Last-Modified ;
+ *    304 sans body si If-None-Match / If-Modified-Since correspondent.
+ *  - gzip_static (location) : si le client accepte gzip et que path.gz
+ *    existe, c'est lui qui est servi (Content-Encoding: gzip, même
+ *    Content-Type).
+ *  - compress (location) : sinon, un fichier texte d'au moins
+ *    compress_min_length et d'au plus response_cache_max_entry octets
+ *    est compressé à la volée (ETag propre à la variante).
+ *  - Vary: Accept-Encoding dès que la location fait l'un des deux.
+ *  - ResponseCache actif : une entrée valide (même taille, mtime, inode
+ *    que les métadonnées de l'OpenFileCache) est renvoyée telle quelle,
+ *    sans lecture, compression ni sérialisation. Un petit fichier absent
+ *    du cache est lu (et compressé) une fois, sérialisé et inséré.
+ *  - variantes compressées : toujours dans _variantCache (clé chemin +
+ *    encodage, entrée validée par taille, mtime, inode), que
+ *    response_cache soit actif ou non.
+ *  - sinon (cache off, fichier trop gros) : body fichier (sendfile).
+ *  - header Range : voir serveRanges() (jamais via le ResponseCache,
+ *    jamais compressé).
+ */
+bool WebServer::serveStaticFile(const HttpRequest &request,
+                                const LocationConfig *loc,
+                                const std::string &path,
+                                HttpResponse &response)
+{
+	bool conditional = request.hasHeader("If-None-Match") ||
+	                   request.hasHeader("If-Modified-Since");
+	bool ranged = request.hasHeader("Range");
+	bool vary = loc && (loc->gzipStatic || loc->compress);
+
+	// Fichier réellement envoyé (path ou son sidecar .gz)
+	std::string filePath = path;
+	bool        gzipped = false;
+
+	if (loc && loc->gzipStatic &&
+	    acceptsEncoding(request.getHeader("Accept-Encoding"), "gzip"))
+	{
+		OpenFileCache::Entry *gz = _fileCache->acquire(path + ".gz", false, _now);
+		if (gz->isFile)
+		{
+			filePath = path + ".gz";
+			gzipped = true;
+		}
+		OpenFileCache::release(gz);
+	}
+
+	OpenFileCache::Entry *info = _fileCache->acquire(filePath, false, _now);
+	if (!info->isFile)
+	{
+		OpenFileCache::release(info);
+		return false;
+	}
+
+	std::string mime = getMimeType(path);
+
+	// Compression à la volée : petits fichiers seulement (lus en entier)
+	Compressor::Format format = Compressor::GZIP;
+	bool compress = !gzipped && !ranged &&
+	                pickCompression(request.getHeader("Accept-Encoding"),
+	                                loc, mime, format) &&
+	                static_cast<std::size_t>(info->size) >= loc->compressMinLength &&
+	                static_cast<std::size_t>(info->size) <= _variantCache->maxEntrySize();
+	std::string variant;
+	if (compress)
+		variant = Compressor::encodingName(format);
+	else if (gzipped)
+		variant = "gzip_static"; // pas la réponse d'un GET direct du .gz
+
+	// Les headers dépendent de la variante et de la location (Vary)
+	std::string cacheKey = filePath;
+	if (!variant.empty())
+		cacheKey += "#" + variant;
+	if (vary)
+		cacheKey += "#vary";
+
+	// Le client a déjà cette version : 304 sans body
+	if (conditional)
+	{
+		std::string etag = makeETag(*info, variant);
+		if (notModified(request, etag, info->mtime))
+		{
+			response.setStatus(304, "Not Modified");
+			response.setHeader("ETag", etag);
+			response.setHeader("Last-Modified", formatHttpDate(info->mtime));
+			if (vary)
+				response.setHeader("Vary", "Accept-Encoding");
+			OpenFileCache::release(info);
+			return true;
+		}
+	}
+
+	ResponseCache *cache = compress ? _variantCache : _responseCache;
+	ResponseCache::Entry *hit = NULL;
+	if (cache->enabled() && !ranged)
+		hit = cache->lookup(cacheKey, *info);
+	OpenFileCache::release(info);
+
+	if (hit)
+	{
+		response.setCachedBody(hit);
+		return true;
+	}
+
+	OpenFileCache::Entry *file = _fileCache->acquire(filePath, true, _now);
+	if (!file->isFile || file->fd < 0)
+	{
+		OpenFileCache::release(file);
+		return false;
+	}
+
+	response.setStatus(200, "OK");
+	response.setHeader("Content-Type", mime);
+	response.setHeader("ETag", makeETag(*file, variant));
+	response.setHeader("Last-Modified", formatHttpDate(file->mtime));
+	response.setHeader("Accept-Ranges", "bytes");
+	if (gzipped)
+		response.setHeader("Content-Encoding", "gzip");
+	if (vary)
+		response.setHeader("Vary", "Accept-Encoding");
+
+	if (ranged && serveRanges(request, file, mime, response))
+		return true;
+
+	std::size_t size = static_cast<std::size_t>(file->size);
+	bool inMemory = compress ||
+	                (_responseCache->enabled() && size <= _responseCache->maxEntrySize());
+	std::string body;
+
+	if (inMemory && readFileContent(*file, body))
+	{
+		if (compress)
+		{
+			std::string packed;
+			if (Compressor::compress(format, loc->compressLevel, body, packed))
+			{
+				body.swap(packed);
+				response.setHeader("Content-Encoding", variant);
+			}
+			else
+				response.setHeader("ETag", makeETag(*file));
+		}
+		response.swapBody(body);
+
+		if (cache->enabled())
+			cacheResponse(cache, cacheKey, *file, response);
+		OpenFileCache::release(file);
+		return true;
+	}
+
+	// Lecture impossible : le fichier part tel quel (ETag de l'identité)
+	if (compress)
+		response.setHeader("ETag", makeETag(*file));
+	response.setFileBody(file, 0, size);
+	return true;
+}
+
+/*
+ * cacheResponse()
+ *
+ *  - sérialise la réponse (body mémoire) dans le ResponseCache et la
+ *    remplace par l'entrée : l'envoi part des octets partagés.
+ */
+void WebServer::cacheResponse(ResponseCache *cache, const std::string &key,
+                              const OpenFileCache::Entry &file,
+                              HttpResponse &response)
+{
+	std::string bytes = response.serializeHeaders();
+	std::size_t headLen = bytes.size() - 2; // avant la ligne vide
+	std::string content;
+
+	response.swapBody(content);
+	bytes += content;
+	response.setCachedBody(cache->insert(key, file, bytes, headLen));
+}
+
+/*
+ * compressBody()
+ *
+ *  - body dynamique (CGI, autoindex) : compressé si la location le
+ *    demande (voir pickCompression), pour un 2xx d'au moins
+ *    compress_min_length octets, pas déjà encodé par le script.
+ *  - le body est donné à zlib par blocs (Compressor en flux).
+ */
+void WebServer::compressBody(const std::string &acceptEncoding,
+                             const LocationConfig *loc,
+                             HttpResponse &response)
+{
+	int status = response.getStatusCode();
+	if (status < 200 || status >= 300 || status == 204 || status == 206)
+		return;
+	if (!loc || !loc->compress || !response.getHeader("Content-Encoding").empty())
+		return;
+
+	// La réponse dépend d'Accept-Encoding, compressée ou non
+	response.setHeader("Vary", "Accept-Encoding");
+
+	Compressor::Format format;
+	if (!pickCompression(acceptEncoding, loc, response.getHeader("Content-Type"),
+	                     format))
+		return;
+
+	std::string body;
+	response.swapBody(body);
+	if (body.size() < loc->compressMinLength)
+	{
+		response.swapBody(body);
+		return;
+	}
+
+	static const std::size_t BLOCK = 64 * 1024;
+	Compressor z(format, loc->compressLevel);
+	std::string packed;
+	bool ok = true;
+
+	for (std::size_t off = 0; ok && off < body.size(); off += BLOCK)
+	{
+		std::size_t n = std::min(BLOCK, body.size() - off);
+		ok = z.update(body.data() + off, n, packed);
+	}
+	if (ok)
+		ok = z.finish(packed);
+
+	if (!ok)
+	{
+		response.swapBody(body);
+		return;
+	}
+
+	response.swapBody(packed);
+	response.removeHeader("Content-Length");
+	response.setHeader("Content-Encoding", Compressor::encodingName(format));
+}
+
+/*
+ * serveRanges()
+ *
+ *  - appelée avec une réponse 200 déjà préparée (Content-Type, ETag...)
+ *    et une référence sur file.
+ *  - If-Range qui ne correspond pas, ou Range invalide : false (la
+ *    réponse 200 complète est envoyée).
+ *  - aucune plage satisfiable : 416, Content-Range = "bytes *" suivi
+ *    de "/taille".
+ *  - une plage : 206, body = tranche du fichier (sendfile avec offset).
+ *  - plusieurs : 206 multipart/byteranges, chaque partie = petit bloc de
+ *    headers + tranche du fichier. Rien n'est lu en mémoire.
+ *  - true : la référence sur file a été reprise (body ou release).
+ */
+bool WebServer::serveRanges(const HttpRequest &request,
+                            OpenFileCache::Entry *file,
+                            const std::string &mime,
+                            HttpResponse &response)
+{
+	std::string etag = response.getHeader("ETag"); // (sidecar : sa variante)
+
+	if (request.hasHeader("If-Range") &&
+	    !ifRangeMatches(request.getHeader("If-Range"), etag, file->mtime))
+		return false;
+
+	std::vector<ByteRange> ranges;
+	int rc = parseRangeHeader(request.getHeader("Range"), file->size, ranges);
+	if (rc < 0)
+		return false;
+
+	std::ostringstream total;
+	total << "/" << file->size;
+
+	if (rc == 0)
+	{
+		response.setStatus(416, "Range Not Satisfiable");
+		response.setHeader("Content-Range", "bytes *" + total.str());
+		response.setHeader("Content-Type", "text/plain");
+		response.setBody("416 Range Not Satisfiable\r\n");
+		OpenFileCache::release(file);
+		return true;
+	}
+
+	response.setStatus(206, "Partial Content");
+
+	if (ranges.size() == 1)
+	{
+		std::ostringstream cr;
+		cr << "bytes " << ranges[0].first << "-" << ranges[0].last << total.str();
+		response.setHeader("Content-Range", cr.str());
+		response.setFileBody(file, ranges[0].first,
+		                     static_cast<std::size_t>(ranges[0].last - ranges[0].first + 1));
+		return true;
+	}
+
+	// multipart/byteranges : frontière unique par réponse
+	static volatile unsigned long boundaryCounter = 0;
+	std::ostringstream b;
+	b << "webserv" << std::hex << _now << "x"
+	  << __sync_add_and_fetch(&boundaryCounter, 1);
+	std::string boundary = b.str();
+
+	std::string partType = "Content-Type: " + mime + "\r\n";
+
+	for (std::size_t i = 0; i < ranges.size(); ++i)
+	{
+		std::ostringstream head;
+		head << "\r\n--" << boundary << "\r\n" << partType
+		     << "Content-Range: bytes " << ranges[i].first << "-"
+		     << ranges[i].last << total.str() << "\r\n\r\n";
+		response.appendBodyPart(head.str());
+
+		// Une référence par tranche (rendue quand la tranche est envoyée)
+		if (i > 0)
+			OpenFileCache::retain(file);
+		response.appendFilePart(file, ranges[i].first,
+		                        static_cast<std::size_t>(ranges[i].last - ranges[i].first + 1));
+	}
+	response.appendBodyPart("\r\n--" + boundary + "--\r\n");
+	response.setHeader("Content-Type",
+	                   "multipart/byteranges; boundary=" + boundary);
+	return true;
+}
+
 void WebServer::setErrorResponse(const ServerConfig &server,
                                  HttpResponse &response,
                                  int code,
                                  const std::string &reason)
 {
 	response.setStatus(code, reason);
-	response.setHeader("Connection", "close");
 
 	// On essaie une error_page personnalisée si définie
 	std::map<int, std::string>::const_iterator it =
@@ -1837,16 +4908,9 @@ void WebServer::setErrorResponse(const ServerConfig &server,
 				path = server.root + rel;
 			}
 
-			std::ifstream file(path.c_str(),
-			                   std::ios::in | std::ios::binary);
-			if (file)
+			if (openFileBody(path, response))
 			{
-				std::ostringstream oss;
-				oss << file.rdbuf();
-				std::string body = oss.str();
-
 				response.setHeader("Content-Type", getMimeType(path));
-				response.setBody(body);
 				return;
 			}
 		}
@@ -1862,105 +4926,112 @@ void WebServer::setErrorResponse(const ServerConfig &server,
 /*
  * run()
  *
- *  - poll() avec un timeout (1s)
- *  - à chaque tour, on ferme les clients inactifs depuis plus de
- *    CLIENT_TIMEOUT_SECONDS.
+ *  - attend les événements via le Poller (poll ou epoll) : seuls les fds
+ *    prêts sont traités.
+ *  - le timeout du wait est la prochaine échéance de la TimerWheel
+ *    (infini s'il n'y a aucun timer) : pas de réveil inutile.
+ *  - à chaque tour : horloge mise à jour une fois, puis on ferme les
+ *    clients inactifs depuis plus de CLIENT_TIMEOUT_SECONDS (ou
+ *    keepalive_timeout entre deux requêtes).
+ *  - les listeners prêts sont seulement notés : l'accept se fait en fin
+ *    de tour, borné par accept_budget (voir acceptPendingConnections).
  */
 void WebServer::run()
 {
-	while (true)
-	{
-		if (_pollFds.empty())
-			continue;
+	if (_reactors.empty())
+		startCgiPools();
 
-		int timeoutMs = 1000; // 1 seconde
-		int ret = poll(&_pollFds[0], _pollFds.size(), timeoutMs);
+	while (!stopRequested())
+	{
+		int timeoutMs = _timers.nextTimeout(TimerWheel::monotonicMs());
+		if (!_acceptQueue.empty())
+			timeoutMs = 0; // connexions en attente : on ne dort pas
+		int ret = _poller.wait(_events, timeoutMs);
 
 		if (ret < 0)
 		{
-			std::cerr << "Error: poll() failed: "
-			          << std::strerror(errno) << std::endl;
+			std::cerr << "Error: " << _poller.getBackendName()
+			          << " wait failed: " << std::strerror(errno) << std::endl;
 			break;
 		}
 
-		std::size_t nfds = _pollFds.size();
+		_now = TimerWheel::monotonicMs();
 
 		// 1) Timeout clients inactifs
-		std::time_t now = std::time(0);
-		for (std::size_t i = 0; i < nfds; ++i)
+		expireTimers();
+
+		// 2) Gestion des événements I/O (fds prêts uniquement)
+		for (std::size_t i = 0; i < _events.size(); ++i)
 		{
-			int fd = _pollFds[i].fd;
+			int      fd = _events[i].fd;
+			unsigned ev = _events[i].events;
+
+			// Un seul lookup O(1) pour savoir ce qu'est ce fd
+			FdSlot *slot = _fds.get(fd);
+			if (!slot)
+				continue;
+
+			// Socket d'écoute ?
+			if (slot->kind == FdSlot::FD_LISTENER)
+			{
+				if (ev & Poller::EV_READ)
+					markListenerReady(fd);
+				continue;
+			}
 
-			// On ne timeoute pas les sockets d'écoute
-			if (_listenFdToServer.find(fd) != _listenFdToServer.end())
+			// Reactor : nouvelles connexions confiées par l'acceptor
+			if (slot->kind == FdSlot::FD_WAKEUP)
+			{
+				drainHandoffs();
 				continue;
+			}
 
-			std::map<int, ClientState>::iterator it = _clients.find(fd);
-			if (it == _clients.end())
+			// Pipe / pidfd d'un CGI en cours
+			if (slot->kind == FdSlot::FD_CGI)
+			{
+				handleCgiEvent(fd);
 				continue;
+			}
 
-			ClientState &state = it->second;
-			if (state.lastActivity != 0 &&
-			    now - state.lastActivity > CLIENT_TIMEOUT_SECONDS)
+			// Connexion vers une application FastCGI
+			if (slot->kind == FdSlot::FD_FASTCGI)
 			{
-				std::cout << "Client fd " << fd
-				          << " timed out, closing." << std::endl;
-				removeClient(i);
-				--i;
-				nfds = _pollFds.size();
+				handleFastCgiEvent(fd, ev);
+				continue;
 			}
-		}
 
-		// 2) Gestion des événements I/O
-		nfds = _pollFds.size();
+			// Connexion vers un backend proxy_pass
+			if (slot->kind == FdSlot::FD_PROXY)
+			{
+				handleProxyEvent(fd, ev);
+				continue;
+			}
 
-		for (std::size_t i = 0; i < nfds; ++i)
-		{
-			if (_pollFds[i].revents == 0)
+			// Le client a pu être fermé plus haut (timeout) dans ce tour
+			if (slot->kind != FdSlot::FD_CLIENT)
 				continue;
 
-			// Socket d'écoute ?
-			if (_listenFdToServer.find(_pollFds[i].fd) != _listenFdToServer.end())
+			// Erreurs / fermeture
+			if (ev & Poller::EV_ERROR)
 			{
-				if (_pollFds[i].revents & POLLIN)
-					handleNewConnection(i);
+				removeClient(fd);
+				continue;
 			}
-			else
+
+			// Lecture
+			if (ev & Poller::EV_READ)
 			{
-				// Erreurs / fermeture
-				if (_pollFds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
-				{
-					removeClient(i);
-					--i;
-					nfds = _pollFds.size();
+				handleClientRead(fd);
+				if (slot->kind != FdSlot::FD_CLIENT)
 					continue;
-				}
-
-				// Lecture
-				if (i < _pollFds.size() && (_pollFds[i].revents & POLLIN))
-				{
-					handleClientRead(i);
-					if (i >= _pollFds.size())
-					{
-						--i;
-						nfds = _pollFds.size();
-						continue;
-					}
-				}
-
-				// Écriture
-				if (i < _pollFds.size() && (_pollFds[i].revents & POLLOUT))
-				{
-					handleClientWrite(i);
-					if (i >= _pollFds.size())
-					{
-						--i;
-						nfds = _pollFds.size();
-						continue;
-					}
-				}
 			}
+
+			// Écriture
+			if (ev & Poller::EV_WRITE)
+				handleClientWrite(fd);
 		}
+
+		// 3) Nouvelles connexions, après les I/O des clients existants
+		acceptPendingConnections();
 	}
 }
-
@@ -12,9 +12,11 @@
 
 #include "Config.hpp"
 #include "WebServer.hpp"
+#include "MasterProcess.hpp"
 
 #include <iostream>
 #include <stdexcept>
+#include <csignal>
 
 int main(int argc, char **argv)
 {
@@ -22,6 +24,10 @@ int main(int argc, char **argv)
 	if (argc > 1)
 		configPath = argv[1];
 
+	// Un client qui ferme pendant qu'on lui écrit ne doit pas tuer le
+	// serveur (send() renverra EPIPE, géré comme une erreur normale).
+	std::signal(SIGPIPE, SIG_IGN);
+
 	try
 	{
 		Config config;
@@ -34,7 +40,14 @@ int main(int argc, char **argv)
 			return 1;
 		}
 
-		WebServer server(servers);
+		// worker_processes > 1 : master + N workers (SO_REUSEPORT)
+		if (config.getGlobal().workerProcesses > 1)
+		{
+			MasterProcess master(servers, config.getGlobal());
+			return master.run();
+		}
+
+		WebServer server(servers, config.getGlobal());
 		server.run();
 	}
 	catch (const std::exception &e)
@@ -0,0 +1,222 @@
+#!/usr/bin/env python3
+"""Runner des workers cgi_pool (interpréteur Python préforké).
+
+    location /cgi-pool/ {
+        cgi .py /usr/bin/python3;
+        cgi_pool 4;
+        cgi_pool_runner ./tests_webserv/cgi_pool/runner.py;
+        cgi_pool_max_requests 500;
+    }
+
+Le serveur lance "python3 runner.py" avec une socketpair en fd 0 et y
+envoie des records FastCGI, une requête à la fois (BEGIN_REQUEST,
+PARAMS, STDIN). Le script demandé (SCRIPT_FILENAME) est exécuté dans ce
+process, comme un CGI lancé à part :
+
+    - os.environ = les params de la requête, cwd = dossier du script ;
+    - sys.stdin = le body, sys.stdout envoyé en records FCGI_STDOUT à
+      chaque flush (ou tous les 8 Ko) ;
+    - sys.exit(n) / exception : app status n / 1 (traceback en STDERR).
+
+Le code compilé des scripts et les modules importés restent en mémoire
+d'une requête à l'autre : c'est ce qu'on gagne sur fork + execve. Le
+runner sort quand le serveur ferme la socket.
+"""
+
+import builtins
+import io
+import os
+import socket
+import struct
+import sys
+import traceback
+
+# Modules courants chargés d'avance (le "pré-chauffage")
+import html  # noqa: F401
+import json  # noqa: F401
+import time  # noqa: F401
+import urllib.parse  # noqa: F401
+
+FCGI_BEGIN_REQUEST = 1
+FCGI_ABORT_REQUEST = 2
+FCGI_END_REQUEST = 3
+FCGI_PARAMS = 4
+FCGI_STDIN = 5
+FCGI_STDOUT = 6
+FCGI_STDERR = 7
+FCGI_GET_VALUES = 9
+FCGI_GET_VALUES_RESULT = 10
+FCGI_UNKNOWN_TYPE = 11
+
+MAX_CONTENT = 65535
+
+
+class Channel:
+    def __init__(self, sock):
+        self.sock = sock
+        self.buf = b""
+
+    def read_record(self):
+        while True:
+            if len(self.buf) >= 8:
+                _, rtype, rid, clen, plen = struct.unpack(">BBHHBx", self.buf[:8])
+                if len(self.buf) >= 8 + clen + plen:
+                    content = self.buf[8:8 + clen]
+                    self.buf = self.buf[8 + clen + plen:]
+                    return rtype, rid, content
+            data = self.sock.recv(65536)
+            if not data:
+                return None
+            self.buf += data
+
+    def send(self, rtype, rid, content=b""):
+        out = []
+        while True:
+            chunk, content = content[:MAX_CONTENT], content[MAX_CONTENT:]
+            out.append(struct.pack(">BBHHBx", 1, rtype, rid, len(chunk), 0) + chunk)
+            if not content:
+                break
+        self.sock.sendall(b"".join(out))
+
+
+class RecordWriter(io.RawIOBase):
+    """stdout du script : chaque écriture part en FCGI_STDOUT."""
+
+    def __init__(self, channel, rid):
+        super().__init__()
+        self.channel = channel
+        self.rid = rid
+
+    def writable(self):
+        return True
+
+    def write(self, data):
+        data = bytes(data)
+        if data:
+            self.channel.send(FCGI_STDOUT, self.rid, data)
+        return len(data)
+
+
+def encode_pairs(pairs):
+    out = b""
+    for name, value in pairs:
+        for item in (name, value):
+            n = len(item)
+            out += bytes([n]) if n < 128 else struct.pack(">I", n | 0x80000000)
+        out += name + value
+    return out
+
+
+def decode_pairs(data):
+    pairs = {}
+    pos = 0
+    while pos < len(data):
+        lens = []
+        for _ in range(2):
+            if data[pos] < 128:
+                lens.append(data[pos])
+                pos += 1
+            else:
+                lens.append(struct.unpack(">I", data[pos:pos + 4])[0] & 0x7FFFFFFF)
+                pos += 4
+        name = data[pos:pos + lens[0]]
+        value = data[pos + lens[0]:pos + lens[0] + lens[1]]
+        pos += lens[0] + lens[1]
+        pairs[name.decode("latin-1")] = value.decode("latin-1")
+    return pairs
+
+
+code_cache = {}
+
+
+def load(path):
+    st = os.stat(path)
+    key = (st.st_mtime_ns, st.st_size)
+    cached = code_cache.get(path)
+    if cached and cached[0] == key:
+        return cached[1]
+    with open(path, "rb") as f:
+        code = compile(f.read(), path, "exec")
+    code_cache[path] = (key, code)
+    return code
+
+
+def run_script(channel, rid, env, body):
+    script = os.path.abspath(env.get("SCRIPT_FILENAME", ""))
+    saved = (dict(os.environ), os.getcwd(), sys.argv, sys.stdin, sys.stdout,
+             sys.path[0])
+    stdout = io.TextIOWrapper(io.BufferedWriter(RecordWriter(channel, rid), 8192),
+                              encoding="utf-8", errors="surrogateescape")
+    status = 0
+    try:
+        os.environ.clear()
+        os.environ.update(env)
+        os.chdir(os.path.dirname(script))
+        sys.argv = [os.path.basename(script)]
+        sys.path[0] = os.path.dirname(script)
+        sys.stdin = io.TextIOWrapper(io.BytesIO(body), encoding="utf-8",
+                                     errors="surrogateescape")
+        sys.stdout = stdout
+        exec(load(script), {"__name__": "__main__", "__file__": script,
+                            "__builtins__": builtins})
+    except SystemExit as e:
+        if isinstance(e.code, int):
+            status = e.code
+        elif e.code is not None:
+            channel.send(FCGI_STDERR, rid, (str(e.code) + "\n").encode())
+            status = 1
+    except BaseException as e:
+        # (sans la frame du runner)
+        tb = traceback.format_exception(type(e), e, e.__traceback__.tb_next)
+        channel.send(FCGI_STDERR, rid, "".join(tb).encode())
+        status = 1
+    finally:
+        try:
+            stdout.flush()
+        except (OSError, ValueError):
+            pass
+        environ, cwd, sys.argv, sys.stdin, sys.stdout, sys.path[0] = saved
+        os.environ.clear()
+        os.environ.update(environ)
+        os.chdir(cwd)
+    return status & 0xFFFFFFFF
+
+
+def main():
+    channel = Channel(socket.socket(fileno=0))
+    requests = {}
+
+    while True:
+        rec = channel.read_record()
+        if rec is None:
+            return
+        rtype, rid, content = rec
+
+        if rtype == FCGI_GET_VALUES:
+            values = {"FCGI_MPXS_CONNS": b"0", "FCGI_MAX_REQS": b"1",
+                      "FCGI_MAX_CONNS": b"1"}
+            asked = decode_pairs(content)
+            channel.send(FCGI_GET_VALUES_RESULT, 0, encode_pairs(
+                [(k.encode(), values[k]) for k in asked if k in values]))
+        elif rtype == FCGI_BEGIN_REQUEST:
+            requests[rid] = {"params": b"", "stdin": b""}
+        elif rtype == FCGI_ABORT_REQUEST:
+            # Le serveur tue le worker s'il abandonne un script en cours
+            pass
+        elif rtype == FCGI_PARAMS and rid in requests:
+            requests[rid]["params"] += content
+        elif rtype == FCGI_STDIN and rid in requests:
+            if content:
+                requests[rid]["stdin"] += content
+                continue
+            req = requests.pop(rid)
+            status = run_script(channel, rid, decode_pairs(req["params"]),
+                                req["stdin"])
+            channel.send(FCGI_STDOUT, rid)
+            channel.send(FCGI_END_REQUEST, rid, struct.pack(">IB3x", status, 0))
+        elif rtype not in (FCGI_PARAMS, FCGI_STDIN):
+            channel.send(FCGI_UNKNOWN_TYPE, 0, bytes([rtype]) + b"\0" * 7)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+"""Petit responder FastCGI pour tester fastcgi_pass.
+
+    ./responder.py unix:/tmp/webserv-fcgi.sock
+    ./responder.py 127.0.0.1:9000
+
+Multiplexe (FCGI_MPXS_CONNS=1) : chaque requête est servie dans son
+propre thread, les records de plusieurs requêtes s'entrelacent sur la
+même connexion. Selon SCRIPT_FILENAME (dernier composant) :
+
+    echo     : renvoie la méthode, la query, le body et quelques params
+    stream   : ?count=N&size=S&delay=D, blocs progressifs (comme stream.py)
+    sleep    : ?s=SECONDES avant de répondre (timeouts, multiplexage)
+    status   : ?code=NNN (Status: NNN)
+    fail     : app status 1 après un début de réponse
+    *        : page "hello" avec le nombre de connexions vues
+"""
+
+import os
+import socket
+import struct
+import sys
+import threading
+import time
+
+FCGI_BEGIN_REQUEST = 1
+FCGI_ABORT_REQUEST = 2
+FCGI_END_REQUEST = 3
+FCGI_PARAMS = 4
+FCGI_STDIN = 5
+FCGI_STDOUT = 6
+FCGI_STDERR = 7
+FCGI_GET_VALUES = 9
+FCGI_GET_VALUES_RESULT = 10
+FCGI_UNKNOWN_TYPE = 11
+
+connections = 0
+connections_lock = threading.Lock()
+
+
+def record(rtype, rid, content=b""):
+    out = b""
+    while True:
+        chunk, content = content[:65535], content[65535:]
+        out += struct.pack(">BBHHBx", 1, rtype, rid, len(chunk), 0) + chunk
+        if not content:
+            return out
+
+
+def encode_pairs(pairs):
+    out = b""
+    for name, value in pairs:
+        for item in (name, value):
+            n = len(item)
+            out += bytes([n]) if n < 128 else struct.pack(">I", n | 0x80000000)
+        out += name + value
+    return out
+
+
+def decode_pairs(data):
+    pairs = {}
+    pos = 0
+    while pos < len(data):
+        lens = []
+        for _ in range(2):
+            if data[pos] < 128:
+                lens.append(data[pos])
+                pos += 1
+            else:
+                lens.append(struct.unpack(">I", data[pos:pos + 4])[0] & 0x7FFFFFFF)
+                pos += 4
+        name = data[pos:pos + lens[0]]
+        value = data[pos + lens[0]:pos + lens[0] + lens[1]]
+        pos += lens[0] + lens[1]
+        pairs[name.decode()] = value.decode("latin-1")
+    return pairs
+
+
+class Connection:
+    def __init__(self, sock):
+        self.sock = sock
+        self.lock = threading.Lock()
+        self.requests = {}
+        self.aborted = set()
+
+    def send(self, data):
+        with self.lock:
+            self.sock.sendall(data)
+
+    def run(self):
+        buf = b""
+        try:
+            while True:
+                data = self.sock.recv(65536)
+                if not data:
+                    break
+                buf += data
+                while len(buf) >= 8:
+                    _, rtype, rid, clen, plen = struct.unpack(">BBHHBx", buf[:8])
+                    if len(buf) < 8 + clen + plen:
+                        break
+                    content = buf[8:8 + clen]
+                    buf = buf[8 + clen + plen:]
+                    self.handle(rtype, rid, content)
+        except OSError:
+            pass
+        self.sock.close()
+
+    def handle(self, rtype, rid, content):
+        if rtype == FCGI_GET_VALUES:
+            values = {"FCGI_MPXS_CONNS": b"1", "FCGI_MAX_REQS": b"8",
+                      "FCGI_MAX_CONNS": b"8"}
+            asked = decode_pairs(content)
+            pairs = [(k.encode(), values[k]) for k in asked if k in values]
+            self.send(record(FCGI_GET_VALUES_RESULT, 0, encode_pairs(pairs)))
+        elif rtype == FCGI_BEGIN_REQUEST:
+            self.requests[rid] = {"params": b"", "stdin": b""}
+        elif rtype == FCGI_ABORT_REQUEST:
+            self.aborted.add(rid)
+        elif rtype == FCGI_PARAMS and rid in self.requests:
+            self.requests[rid]["params"] += content
+        elif rtype == FCGI_STDIN and rid in self.requests:
+            if content:
+                self.requests[rid]["stdin"] += content
+            else:
+                req = self.requests.pop(rid)
+                threading.Thread(target=self.respond, args=(rid, req),
+                                 daemon=True).start()
+        elif rtype not in (FCGI_PARAMS, FCGI_STDIN):
+            self.send(record(FCGI_UNKNOWN_TYPE, 0, bytes([rtype]) + b"\0" * 7))
+
+    def out(self, rid, text):
+        if isinstance(text, str):
+            text = text.encode()
+        self.send(record(FCGI_STDOUT, rid, text))
+
+    def end(self, rid, app_status=0):
+        self.send(record(FCGI_STDOUT, rid) +
+                  record(FCGI_END_REQUEST, rid,
+                         struct.pack(">IB3x", app_status, 0)))
+        self.aborted.discard(rid)
+
+    def respond(self, rid, req):
+        try:
+            self.respond_to(rid, req)
+        except OSError:
+            pass
+
+    def respond_to(self, rid, req):
+        env = decode_pairs(req["params"])
+        script = os.path.basename(env.get("SCRIPT_FILENAME", ""))
+        query = dict(p.split("=", 1) for p in env.get("QUERY_STRING", "").split("&") if "=" in p)
+
+        if script == "echo":
+            body = ("method=%s\nquery=%s\nlength=%s\nscript=%s\nhost=%s\nbody=" % (
+                env.get("REQUEST_METHOD"), env.get("QUERY_STRING"),
+                env.get("CONTENT_LENGTH", ""), env.get("SCRIPT_FILENAME"),
+                env.get("HTTP_HOST", ""))).encode() + req["stdin"]
+            self.out(rid, b"Content-Type: text/plain\r\nContent-Length: %d\r\n\r\n"
+                     % len(body) + body)
+        elif script == "stream":
+            count = int(query.get("count", "5"))
+            size = int(query.get("size", "32"))
+            delay = float(query.get("delay", "0.2"))
+            self.out(rid, "Content-Type: text/plain\r\n\r\n")
+            for i in range(count):
+                if rid in self.aborted:
+                    break
+                line = "block %d " % i
+                self.out(rid, line + "x" * max(0, size - len(line) - 1) + "\n")
+                if delay > 0:
+                    time.sleep(delay)
+        elif script == "sleep":
+            time.sleep(float(query.get("s", "1")))
+            self.out(rid, "Content-Type: text/plain\r\n\r\nslept %s\n" % query.get("s", "1"))
+        elif script == "status":
+            code = query.get("code", "418")
+            self.out(rid, "Status: %s Custom\r\nContent-Type: text/plain\r\n\r\nstatus %s\n"
+                     % (code, code))
+        elif script == "fail":
+            self.send(record(FCGI_STDERR, rid, b"fail: something went wrong\n"))
+            self.end(rid, 1)
+            return
+        else:
+            self.out(rid, "Content-Type: text/html\r\n\r\n"
+                     "<html><body><h1>Hello from FastCGI</h1>"
+                     "<p>connections: %d</p></body></html>\n" % connections)
+        self.end(rid)
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: responder.py unix:/path | host:port")
+    address = sys.argv[1]
+
+    if address.startswith("unix:"):
+        path = address[5:]
+        if os.path.exists(path):
+            os.unlink(path)
+        server = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        server.bind(path)
+    else:
+        host, port = address.rsplit(":", 1)
+        server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        server.bind((host, int(port)))
+    server.listen(64)
+
+    global connections
+    while True:
+        sock, _ = server.accept()
+        with connections_lock:
+            connections += 1
+        threading.Thread(target=Connection(sock).run, daemon=True).start()
+
+
+if __name__ == "__main__":
+    main()
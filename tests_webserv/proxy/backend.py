@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+"""Petit backend HTTP/1.1 pour tester proxy_pass.
+
+    ./backend.py 127.0.0.1:9100
+    ./backend.py unix:/tmp/webserv-proxy.sock
+
+Keep-alive, un thread par connexion. Selon le dernier composant du
+chemin :
+
+    echo     : renvoie la méthode, le chemin, les headers reçus et la
+               taille du body
+    stream   : ?count=N&size=S&delay=D, blocs progressifs en chunked
+    big      : ?size=N, N octets avec Content-Length
+    close    : body sans longueur, terminé par la fermeture
+    sleep    : ?s=SECONDES avant de répondre (timeouts)
+    status   : ?code=NNN
+    *        : page "hello" : adresse du backend, numéro de la connexion
+               et requêtes servies dessus (réutilisation, répartition
+               entre les serveurs d'un upstream)
+"""
+
+import http.server
+import os
+import socketserver
+import sys
+import threading
+import time
+import urllib.parse
+
+ADDRESS = "127.0.0.1:9100"
+connections = 0
+connections_lock = threading.Lock()
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def setup(self):
+        global connections
+        super().setup()
+        with connections_lock:
+            connections += 1
+            self.conn_id = connections
+        self.served = 0
+
+    def log_message(self, fmt, *args):
+        pass
+
+    def address_string(self):
+        return "backend"
+
+    def send_body(self, code, body, ctype="text/plain"):
+        self.send_response(code)
+        self.send_header("Content-Type", ctype)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def handle_any(self):
+        self.served += 1
+        url = urllib.parse.urlsplit(self.path)
+        query = dict(urllib.parse.parse_qsl(url.query))
+        name = os.path.basename(url.path.rstrip("/"))
+        length = int(self.headers.get("Content-Length") or 0)
+        body = self.rfile.read(length) if length else b""
+
+        if name == "echo":
+            lines = ["method=%s" % self.command, "path=%s" % self.path,
+                     "body=%d" % len(body)]
+            lines += ["%s: %s" % (k.lower(), v) for k, v in self.headers.items()]
+            self.send_body(200, ("\n".join(lines) + "\n").encode())
+        elif name == "stream":
+            count = int(query.get("count", 10))
+            size = int(query.get("size", 1024))
+            delay = float(query.get("delay", 0))
+            self.send_response(200)
+            self.send_header("Content-Type", "text/plain")
+            self.send_header("Transfer-Encoding", "chunked")
+            self.end_headers()
+            for i in range(count):
+                block = (b"%06d " % i).ljust(size - 1, b".") + b"\n"
+                self.wfile.write(b"%x\r\n%s\r\n" % (len(block), block))
+                self.wfile.flush()
+                if delay:
+                    time.sleep(delay)
+            self.wfile.write(b"0\r\n\r\n")
+        elif name == "big":
+            size = int(query.get("size", 1 << 20))
+            self.send_response(200)
+            self.send_header("Content-Type", "application/octet-stream")
+            self.send_header("Content-Length", str(size))
+            self.end_headers()
+            block = b"x" * 65536
+            left = size
+            while left > 0:
+                n = min(left, len(block))
+                self.wfile.write(block[:n])
+                left -= n
+        elif name == "close":
+            self.send_response(200)
+            self.send_header("Content-Type", "text/plain")
+            self.send_header("Connection", "close")
+            self.end_headers()
+            self.wfile.write(b"until close\n")
+            self.close_connection = True
+        elif name == "sleep":
+            time.sleep(float(query.get("s", 1)))
+            self.send_body(200, b"slept\n")
+        elif name == "status":
+            code = int(query.get("code", 200))
+            if code in (204, 304):
+                self.send_response(code)
+                self.end_headers()
+            else:
+                self.send_body(code, b"status %d\n" % code)
+        else:
+            self.send_body(200, b"hello from backend %s: connection %d, request %d\n"
+                           % (ADDRESS.encode(), self.conn_id, self.served),
+                           "text/html")
+
+    do_GET = handle_any
+    do_POST = handle_any
+    do_DELETE = handle_any
+
+
+class TcpServer(socketserver.ThreadingMixIn, http.server.HTTPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+
+class UnixServer(socketserver.ThreadingMixIn, socketserver.UnixStreamServer):
+    daemon_threads = True
+
+
+def main():
+    global ADDRESS
+    address = sys.argv[1] if len(sys.argv) > 1 else ADDRESS
+    ADDRESS = address
+    if address.startswith("unix:"):
+        path = address[5:]
+        if os.path.exists(path):
+            os.unlink(path)
+        server = UnixServer(path, Handler)
+    else:
+        host, port = address.rsplit(":", 1)
+        server = TcpServer((host, int(port)), Handler)
+    print("proxy backend listening on %s" % address, flush=True)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,22 @@
+#!/usr/bin/env python3
+import os
+import sys
+import time
+
+# Sortie progressive : le serveur doit transmettre chaque bloc dès qu'il
+# arrive (chunked), sans attendre la fin du script.
+#   ?count=N&size=S&delay=D : N blocs de S octets, D secondes entre deux
+params = dict(p.split("=", 1) for p in os.environ.get("QUERY_STRING", "").split("&") if "=" in p)
+count = int(params.get("count", "5"))
+size = int(params.get("size", "32"))
+delay = float(params.get("delay", "0.2"))
+
+sys.stdout.write("Content-Type: text/plain\r\n\r\n")
+sys.stdout.flush()
+
+for i in range(count):
+    line = "block %d " % i
+    sys.stdout.write(line + "x" * max(0, size - len(line) - 1) + "\n")
+    sys.stdout.flush()
+    if delay > 0:
+        time.sleep(delay)